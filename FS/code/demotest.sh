@@ -23,3 +23,9 @@ cat file1.test
 echo ""
 echo "***************************************"
 ../build.linux/nachos -e fileIO_test2
+
+echo "***************************************"
+#test multiprocessor
+../build.linux/nachos -f -cp consoleIO_test1 /cio1
+../build.linux/nachos -cp consoleIO_test2 /cio2
+../build.linux/nachos -cpus 2 -e /cio1 -e /cio2
@@ -0,0 +1,218 @@
+// diskreplay.cc
+//	Routines to replay a recorded disk trace through the SynchDisk.
+//	See diskreplay.h for the overall design.
+//
+//	The driver is an interrupt handler (CallBack) scheduled for the
+//	time each recorded request should arrive.  It forks a thread to
+//	make the request, since SynchDisk requests block, and schedules
+//	itself again for the next record.
+
+#include "copyright.h"
+#include "diskreplay.h"
+#include "synchdisk.h"
+#include "sysdep.h"
+#include "main.h"
+
+const int ReplayPriority = 149;		// same as the main thread
+
+// The following class carries one record to the thread replaying it.
+
+class ReplayRequest {
+  public:
+    DiskReplay *replay;			// Who to tell when we are done
+    DiskTraceRecord record;		// The request to make
+};
+
+//----------------------------------------------------------------------
+// ServeRequest
+// 	Body of a replay thread: make one request, and wait for it.
+//----------------------------------------------------------------------
+
+static void
+ServeRequest(ReplayRequest *request)
+{
+    char data[SectorSize];
+    int sector = request->record.sector & ~DiskTraceWrite;
+
+    if (request->record.sector & DiskTraceWrite) {
+        bzero(data, SectorSize);
+        kernel->synchDisk->WriteSector(sector, data);
+    } else {
+        kernel->synchDisk->ReadSector(sector, data);
+    }
+    request->replay->Finished();
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::DiskReplay
+// 	Open a trace for replay, and check that it is one.
+//
+//	"traceName" -- UNIX file written by "nachos -dt"
+//	"speedup" -- divide the gaps between arrivals by this
+//----------------------------------------------------------------------
+
+DiskReplay::DiskReplay(char *traceName, int speedup)
+{
+    int magic;
+
+    ASSERT(speedup >= 1);
+    name = traceName;
+    this->speedup = speedup;
+    fileno = OpenForReadWrite(traceName, TRUE);
+    if (ReadPartial(fileno, (char *) &magic, sizeof(int)) != sizeof(int)
+            || magic != DiskTraceMagic) {
+        cerr << "Disk replay: " << traceName << " is not a disk trace\n";
+        Abort();
+    }
+
+    buffer = new DiskTraceRecord[DiskTraceBuffer];
+    numBuffered = position = 0;
+    next = NULL;
+    firstTick = startTick = 0;
+    numIssued = numDone = numWrites = 0;
+    recordedTicks = recordedSeek = lastTrack = 0;
+    allDone = new Semaphore("disk replay", 0);
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::~DiskReplay
+//----------------------------------------------------------------------
+
+DiskReplay::~DiskReplay()
+{
+    Close(fileno);
+    delete [] buffer;
+    delete allDone;
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::ReadRecord
+// 	Return the next record of the trace, or NULL at the end.  The
+//	record stays valid until the next call.
+//----------------------------------------------------------------------
+
+DiskTraceRecord *
+DiskReplay::ReadRecord()
+{
+    DiskTraceRecord *rec;
+
+    if (position == numBuffered) {
+        numBuffered = ReadPartial(fileno, (char *) buffer,
+                          DiskTraceBuffer * sizeof(DiskTraceRecord))
+                      / sizeof(DiskTraceRecord);
+        position = 0;
+        if (numBuffered <= 0) {
+            numBuffered = 0;
+            return NULL;
+        }
+    }
+    rec = &buffer[position++];
+    ASSERT((int) (rec->sector & ~DiskTraceWrite) < NumSectors);
+    return rec;
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::ScheduleNext
+// 	Arrange to be called back when the next record is due.  The
+//	recorded issue times are taken as the arrival times, relative
+//	to the first record and compressed by "speedup".
+//----------------------------------------------------------------------
+
+void
+DiskReplay::ScheduleNext()
+{
+    int due, fromNow;
+
+    if (next == NULL)
+        return;
+    due = startTick + (next->when - firstTick) / speedup;
+    fromNow = due - kernel->stats->totalTicks;
+    if (fromNow < 1)
+        fromNow = 1;
+    kernel->interrupt->Schedule(this, fromNow, DiskInt);
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::CallBack
+// 	Interrupt handler: start a thread for every record that is now
+//	due, then wait for the next one.
+//----------------------------------------------------------------------
+
+void
+DiskReplay::CallBack()
+{
+    while (next != NULL && startTick + (next->when - firstTick) / speedup
+                                <= kernel->stats->totalTicks) {
+        ReplayRequest *request = new ReplayRequest;
+        int track = (next->sector & ~DiskTraceWrite) / SectorsPerTrack;
+        Thread *t = new Thread("disk replay", numIssued);
+
+        request->replay = this;
+        request->record = *next;
+        if (next->sector & DiskTraceWrite)
+            numWrites++;
+        recordedTicks += next->latency;
+        recordedSeek += abs(track - lastTrack);
+        lastTrack = track;
+        numIssued++;
+
+        t->setPriority(ReplayPriority);
+        t->Fork((VoidFunctionPtr) ServeRequest, (void *) request);
+        next = ReadRecord();
+    }
+    ScheduleNext();
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::Finished
+// 	Called by a replay thread once its request is done.  Wake up
+//	Run when the last one finishes.
+//----------------------------------------------------------------------
+
+void
+DiskReplay::Finished()
+{
+    numDone++;
+    if (next == NULL && numDone == numIssued)
+        allDone->V();
+}
+
+//----------------------------------------------------------------------
+// DiskReplay::Run
+// 	Replay the trace, wait for every request to finish, and print
+//	what it cost: the recorded figures first, then the ones for the
+//	current SynchDisk configuration.
+//----------------------------------------------------------------------
+
+void
+DiskReplay::Run()
+{
+    Statistics *stats = kernel->stats;
+    int seek = stats->numDiskSeekTracks;
+    int busy = stats->diskBusyTicks;
+    int queued = stats->diskQueueTicks;
+    int hits = stats->numDiskCacheHits;
+
+    next = ReadRecord();
+    if (next != NULL) {
+        firstTick = next->when;
+        startTick = stats->totalTicks;
+        ScheduleNext();
+        allDone->P();
+    }
+    seek = stats->numDiskSeekTracks - seek;
+    busy = stats->diskBusyTicks - busy;
+    queued = stats->diskQueueTicks - queued;
+    hits = stats->numDiskCacheHits - hits;
+
+    cout << "Disk replay of " << name << ": " << numIssued << " requests ("
+         << numIssued - numWrites << " reads, " << numWrites << " writes)\n";
+    cout << "Recorded: seek tracks " << recordedSeek
+         << ", disk ticks " << recordedTicks << "\n";
+    cout << "Replayed: seek tracks " << seek << ", disk ticks " << busy
+         << ", queueing delay " << queued << " (average "
+         << (numIssued > 0 ? queued / numIssued : 0) << ")"
+         << ", cache hits " << hits
+         << ", elapsed " << stats->totalTicks - startTick << "\n";
+}
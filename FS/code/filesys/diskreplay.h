@@ -0,0 +1,64 @@
+// diskreplay.h
+//	Data structures for replaying a recorded disk trace.
+//
+//	A trace ("nachos -dt traceFile", see Disk::Trace) records
+//	every request the disk saw: when it was issued, the sector, and
+//	whether it was a read or a write.  The replay driver sends the
+//	same requests, at the same (simulated) times, through the
+//	SynchDisk -- so the scheduling policy ("-ds") and the sector
+//	cache ("-dc") can be compared on identical input.
+//
+//	Each request is made by its own kernel thread, the way a busy
+//	system would make them, so requests that arrive while the disk
+//	is busy queue up in the SynchDisk.  "speedup" compresses the
+//	gaps between arrivals, to put the scheduler under more load.
+//
+//	Only the request stream is replayed, not the data: writes store
+//	zeros, so run a replay against a scratch disk ("-m").
+
+#ifndef DISKREPLAY_H
+#define DISKREPLAY_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "synch.h"
+#include "callback.h"
+
+class DiskReplay : public CallBackObj {
+  public:
+    DiskReplay(char *traceName, int speedup);
+					// Open a trace for replay
+    ~DiskReplay();
+
+    void Run();				// Replay the whole trace, then print
+					// how the disk did
+    void CallBack();			// Time to issue the next request(s)
+    void Finished();			// Called by each request's thread
+					// once its request is done
+
+  private:
+    char *name;				// Trace file name
+    int fileno;				// UNIX file number of the trace
+    int speedup;			// Divide inter-arrival gaps by this
+
+    DiskTraceRecord *buffer;		// Records read from the trace
+    int numBuffered;			// # of records in "buffer"
+    int position;			// Next record in "buffer"
+    DiskTraceRecord *next;		// Next record to replay, NULL at end
+
+    int firstTick;			// Issue time of the first record
+    int startTick;			// When the replay started
+    int numIssued;			// # of requests sent to the SynchDisk
+    int numDone;			// # of them that have finished
+    int numWrites;			// # of them that are writes
+    int recordedTicks;			// Sum of the recorded latencies
+    int recordedSeek;			// Tracks moved in the recording
+    int lastTrack;			// For computing "recordedSeek"
+    Semaphore *allDone;			// Signalled when every request is done
+
+    DiskTraceRecord *ReadRecord();	// Fetch the next record from the trace
+    void ScheduleNext();		// Arrange for CallBack at the time
+					// "next" should be issued
+};
+
+#endif // DISKREPLAY_H
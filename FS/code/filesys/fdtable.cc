@@ -0,0 +1,297 @@
+// fdtable.cc
+//	Routines to manage the system-wide open file table and the
+//	per-process file descriptor tables.  See fdtable.h for the
+//	overall design.
+//
+//	Note that, like the rest of the baseline file system, these
+//	routines assume there is no concurrent access: they are only
+//	called from system call handlers, with one user thread in the
+//	kernel at a time.
+
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "debug.h"
+#include "bitmap.h"
+#include "fdtable.h"
+
+//----------------------------------------------------------------------
+// OpenFileTable::OpenFileTable
+// 	Initialize an empty system-wide open file table, with every
+//	entry on the free list.
+//----------------------------------------------------------------------
+
+OpenFileTable::OpenFileTable()
+{
+    tableSize = 0;
+    numOpen = 0;
+    freeHead = -1;
+    files = NULL;
+    refCount = NULL;
+    nextFree = NULL;
+    Grow();
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::~OpenFileTable
+// 	Close any file that is still open, and de-allocate the table.
+//----------------------------------------------------------------------
+
+OpenFileTable::~OpenFileTable()
+{
+    for (int i = 0; i < tableSize; i++) {
+        if (files[i] != NULL)
+            delete files[i];
+    }
+    delete [] files;
+    delete [] refCount;
+    delete [] nextFree;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Grow
+// 	Double the number of entries, putting the new ones on the
+//	free list.  Existing entry numbers stay valid.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Grow()
+{
+    int newSize = (tableSize == 0) ? InitialOpenFiles : tableSize * 2;
+    OpenFile **newFiles = new OpenFile*[newSize];
+    int *newRefCount = new int[newSize];
+    int *newNextFree = new int[newSize];
+
+    for (int i = 0; i < tableSize; i++) {
+        newFiles[i] = files[i];
+        newRefCount[i] = refCount[i];
+        newNextFree[i] = nextFree[i];
+    }
+    // chain the new entries in increasing order in front of the
+    // (empty) free list
+    for (int i = tableSize; i < newSize; i++) {
+        newFiles[i] = NULL;
+        newRefCount[i] = 0;
+        newNextFree[i] = (i + 1 < newSize) ? i + 1 : freeHead;
+    }
+    freeHead = tableSize;
+
+    delete [] files;
+    delete [] refCount;
+    delete [] nextFree;
+    files = newFiles;
+    refCount = newRefCount;
+    nextFree = newNextFree;
+
+    DEBUG(dbgFile, "Open file table grown to " << newSize << " entries");
+    tableSize = newSize;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Add
+// 	Store an open file in a free entry, with a reference count of one.
+//	Return the entry number.
+//
+//	"file" -- the file just opened; the table now owns it
+//----------------------------------------------------------------------
+
+int
+OpenFileTable::Add(OpenFile *file)
+{
+    int entry;
+
+    ASSERT(file != NULL);
+    if (freeHead == -1)
+        Grow();
+    entry = freeHead;
+    freeHead = nextFree[entry];
+
+    files[entry] = file;
+    refCount[entry] = 1;
+    numOpen++;
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Get
+// 	Return the file stored in "entry".
+//----------------------------------------------------------------------
+
+OpenFile *
+OpenFileTable::Get(int entry)
+{
+    ASSERT(entry >= 0 && entry < tableSize);
+    return files[entry];
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Ref
+// 	Record that one more descriptor refers to "entry".
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Ref(int entry)
+{
+    ASSERT(entry >= 0 && entry < tableSize && files[entry] != NULL);
+    refCount[entry]++;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Release
+// 	Record that one less descriptor refers to "entry".  When the
+//	last one goes away, close the file and free the entry.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Release(int entry)
+{
+    ASSERT(entry >= 0 && entry < tableSize && files[entry] != NULL);
+    if (--refCount[entry] > 0)
+        return;
+
+    delete files[entry];		// close the file
+    files[entry] = NULL;
+    nextFree[entry] = freeHead;
+    freeHead = entry;
+    numOpen--;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::FileDescriptorTable
+// 	Initialize an empty descriptor table.
+//
+//	"table" -- the system-wide table that descriptors refer to
+//----------------------------------------------------------------------
+
+FileDescriptorTable::FileDescriptorTable(OpenFileTable *table)
+{
+    openFileTable = table;
+    tableSize = 0;
+    numOpen = 0;
+    lowestFree = 0;
+    entries = NULL;
+    inUse = NULL;
+    Grow();
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::~FileDescriptorTable
+// 	Close any descriptor the program left open, and de-allocate
+//	the table.
+//----------------------------------------------------------------------
+
+FileDescriptorTable::~FileDescriptorTable()
+{
+    CloseAll();
+    delete [] entries;
+    delete [] inUse;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Grow
+// 	Double the number of descriptors.
+//----------------------------------------------------------------------
+
+void
+FileDescriptorTable::Grow()
+{
+    int newSize = (tableSize == 0) ? InitialOpenFiles : tableSize * 2;
+    int *newEntries;
+    unsigned int *newInUse;
+
+    newSize = divRoundUp(newSize, BitsInWord) * BitsInWord;
+    newEntries = new int[newSize];
+    newInUse = new unsigned int[newSize / BitsInWord];
+
+    for (int i = 0; i < newSize; i++)
+        newEntries[i] = (i < tableSize) ? entries[i] : -1;
+    for (int i = 0; i < newSize / BitsInWord; i++)
+        newInUse[i] = (i < tableSize / BitsInWord) ? inUse[i] : 0;
+
+    delete [] entries;
+    delete [] inUse;
+    entries = newEntries;
+    inUse = newInUse;
+    tableSize = newSize;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Install
+// 	Allocate the lowest numbered free descriptor and point it at
+//	"entry" of the system-wide table.  The caller's reference to
+//	"entry" is handed over to the descriptor.
+//
+//	Everything below "lowestFree" is known to be in use, so the
+//	search starts there and skips whole words of busy descriptors.
+//----------------------------------------------------------------------
+
+OpenFileId
+FileDescriptorTable::Install(int entry)
+{
+    int word, bit, fd;
+
+    if (numOpen == tableSize)
+        Grow();
+
+    for (word = lowestFree / BitsInWord; inUse[word] == ~0U; word++)
+        ;
+    for (bit = 0; inUse[word] & (1U << bit); bit++)
+        ;
+    fd = word * BitsInWord + bit;
+    ASSERT(fd < tableSize);
+
+    inUse[word] |= (1U << bit);
+    entries[fd] = entry;
+    numOpen++;
+    lowestFree = fd + 1;
+    return fd;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Lookup
+// 	Return the open file behind descriptor "fd", or NULL if the
+//	program passed us a bad descriptor.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileDescriptorTable::Lookup(OpenFileId fd)
+{
+    if (fd < 0 || fd >= tableSize || entries[fd] == -1)
+        return NULL;
+    return openFileTable->Get(entries[fd]);
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Close
+// 	Free descriptor "fd", dropping its reference to the system-wide
+//	entry.  Return FALSE if "fd" was not open.
+//----------------------------------------------------------------------
+
+bool
+FileDescriptorTable::Close(OpenFileId fd)
+{
+    if (fd < 0 || fd >= tableSize || entries[fd] == -1)
+        return FALSE;
+
+    openFileTable->Release(entries[fd]);
+    entries[fd] = -1;
+    inUse[fd / BitsInWord] &= ~(1U << (fd % BitsInWord));
+    numOpen--;
+    if (fd < lowestFree)
+        lowestFree = fd;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::CloseAll
+// 	Free every descriptor; called when the address space goes away.
+//----------------------------------------------------------------------
+
+void
+FileDescriptorTable::CloseAll()
+{
+    for (int fd = 0; numOpen > 0 && fd < tableSize; fd++)
+        Close(fd);
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,97 @@
+// fdtable.h
+//	Data structures for the open file tables used by user programs.
+//
+//	As in UNIX, there are two levels:
+//
+//	   OpenFileTable -- one system-wide table, kept by the FileSystem.
+//		There is an entry for every successful Open, holding the
+//		shared OpenFile object (file header + seek position) and
+//		the number of descriptors that refer to it.
+//
+//	   FileDescriptorTable -- one per address space.  It maps the
+//		small integers handed back to user programs (OpenFileId)
+//		to entries of the system-wide table.
+//
+//	Both tables start small and double in size when they fill up,
+//	so the number of files a program can keep open is limited only
+//	by host memory.  Descriptors are allocated lowest-free first
+//	(UNIX semantics); a "lowestFree" hint plus one bit per descriptor
+//	makes that amortized O(1) instead of a scan over the whole table.
+
+#ifndef FDTABLE_H
+#define FDTABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "openfile.h"
+
+#ifndef FILESYS_STUB
+
+typedef int OpenFileId;
+
+#define InitialOpenFiles	16	// initial size of both kinds of table
+
+// The following class defines the system-wide open file table.
+// Free entries are kept on a singly linked free list (threaded
+// through "nextFree"), so Add and Release are O(1).
+
+class OpenFileTable {
+  public:
+    OpenFileTable();			// Initialize an empty table
+    ~OpenFileTable();			// Close every file still open
+
+    int Add(OpenFile *file);		// Put "file" in a free entry with
+					// a reference count of one;
+					// return the entry number
+    OpenFile *Get(int entry);		// Return the file in "entry"
+    void Ref(int entry);		// One more descriptor refers to "entry"
+    void Release(int entry);		// One less; close the file when the
+					// last reference goes away
+
+    int NumOpen() { return numOpen; }	// Number of entries in use
+
+  private:
+    OpenFile **files;			// The shared file objects, NULL if free
+    int *refCount;			// # of descriptors using each entry
+    int *nextFree;			// Free list links
+    int freeHead;			// First free entry, -1 if table is full
+    int tableSize;			// Number of entries allocated
+    int numOpen;			// Number of entries in use
+
+    void Grow();			// Double the size of the table
+};
+
+// The following class defines a per-process descriptor table.
+
+class FileDescriptorTable {
+  public:
+    FileDescriptorTable(OpenFileTable *table);
+					// Initialize an empty descriptor table
+					// whose entries refer to "table"
+    ~FileDescriptorTable();		// Close every descriptor still open
+
+    OpenFileId Install(int entry);	// Allocate the lowest free descriptor,
+					// pointing at system-wide "entry"
+    OpenFile *Lookup(OpenFileId fd);	// Return the file behind "fd",
+					// NULL if "fd" is not open
+    bool Close(OpenFileId fd);		// Free "fd"; FALSE if it was not open
+    void CloseAll();			// Free every descriptor
+
+    int NumOpen() { return numOpen; }	// Number of descriptors in use
+
+  private:
+    OpenFileTable *openFileTable;	// System-wide table we refer to
+    int *entries;			// System-wide entry for each
+					// descriptor, -1 if free
+    unsigned int *inUse;		// One bit per descriptor
+    int tableSize;			// Number of descriptors allocated
+					// (always a multiple of BitsInWord)
+    int numOpen;			// Number of descriptors in use
+    int lowestFree;			// Every descriptor below this is in use
+
+    void Grow();			// Double the size of the table
+};
+
+#endif // FILESYS_STUB
+
+#endif // FDTABLE_H
@@ -33,7 +33,7 @@ int WhichLevel(int sectors){
     int k2 = 32*32;
     int k1 = 32;
 
-    if(sectors >0 && sectors <= 9){     // 1152 Bytes
+    if(sectors <= 9){     // 1152 Bytes (an empty file is direct too)
         return 1;
     }
     else if(sectors >9 && sectors <= k1){  // 4096 Bytes
@@ -42,7 +42,8 @@ int WhichLevel(int sectors){
     else if(sectors >k1 && sectors <= k2){  // 128 KB
         return 3;
     }
-    else if(sectors >k2 && sectors <= (16*k3)){  // 64 MB
+    else {  // 64 MB
+        ASSERT(sectors <= (16*k3));
         return 4;
     }
 }
@@ -510,7 +511,7 @@ int FileHeader::GetIndexTable(int logic){
             int i2 = logic % k1;
             return dTable[i1][i2];
         }
-        case 4:{    // 3-Lv indirect x 16
+        default:{    // 3-Lv indirect x 16
             int i0 = logic / k3;
             int i1 = (logic % k3) / k2;
             int i2 = (logic % k2) / k1;
@@ -50,6 +50,8 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "remotefs.h"
+#include "main.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -200,9 +202,7 @@ FileSystem::FileSystem(bool format)
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
     }
-    // 23-0507[j]: MP4 為了自行新增的 OpenFileTable 初始化
-    for(int i=0;i<NumOFTEntries;i++) openFileTable[i] = NULL;
-    openFileCount = 0;
+    openFileTable = new OpenFileTable();
 
     cout << "Format done!" << endl;
 }
@@ -484,50 +484,53 @@ FileSystem::Print()
 // 23-0507[j]: MP4
 //             對接 System Call Interface in ksyscall.h
 
-int FileSystem::FindFreeEntry(){
-    if(openFileCount >= NumOFTEntries) return -1;
-    for(int i=0;i<NumOFTEntries;i++){
-        // cout << "openFileTable[i]=" <<openFileTable[i] << endl;
-        if(openFileTable[i] == NULL) return i;
-    }
-    return -1;
-}
+//----------------------------------------------------------------------
+// FileSystem::OpenReturnId
+// 	Open a file on behalf of a user program.  The OpenFile goes into
+//	the system-wide table; the program gets back the lowest free
+//	descriptor in its own table.  Return -1 if the file doesn't exist.
+//	A path under RemotePrefix names a file on another machine, which
+//	is opened through the remote file client (see remotefs.h).
+//
+//	"name" -- the absolute path of the file
+//	"fdTable" -- the calling program's descriptor table
+//----------------------------------------------------------------------
 
-OpenFileId FileSystem::OpenReturnId(char *name){
-    if(openFileCount >= NumOFTEntries){
-        return -1;
+OpenFileId FileSystem::OpenReturnId(char *name, FileDescriptorTable *fdTable){
+    OpenFile *openFile;
+    if(strncmp(name, RemotePrefix, strlen(RemotePrefix)) == 0){
+        openFile = (kernel->remoteFiles != NULL) ?
+                        kernel->remoteFiles->Open(name) : NULL;
+    } else {
+        openFile = Open(name);
     }
-
-    int index = -1;
-    OpenFile *openFile = Open(name);
     if(openFile == NULL){
         return -1;
     }
-    else{
-        openFileCount++;
-        index = FindFreeEntry();
-        openFileTable[index] = openFile;
-    }
-    // cout << "index=" << index << endl;
-    return index;
+    return fdTable->Install(openFileTable->Add(openFile));
 }
 
-int FileSystem::Close(OpenFileId fileId){
-    if(!openFileCount) return -1;
-    if(openFileTable[fileId] == NULL) return -1;
-    else{
-        openFileCount--;
-        openFileTable[fileId] = NULL;
-    }
-    return 1;
+int FileSystem::Close(OpenFileId fileId, FileDescriptorTable *fdTable){
+    return fdTable->Close(fileId) ? 1 : -1;
 }
 
-int FileSystem::Write(OpenFileId fd,char *buffer, int nBytes){
-    return openFileTable[fd]->Write(buffer,nBytes);
+int FileSystem::Write(OpenFileId fd,char *buffer, int nBytes, FileDescriptorTable *fdTable){
+    OpenFile *openFile = fdTable->Lookup(fd);
+    if(openFile == NULL) return -1;
+    return openFile->Write(buffer,nBytes);
 }
     
-int FileSystem::Read(OpenFileId fd,char *buffer, int nBytes){
-    return openFileTable[fd]->Read(buffer,nBytes);
+int FileSystem::Read(OpenFileId fd,char *buffer, int nBytes, FileDescriptorTable *fdTable){
+    OpenFile *openFile = fdTable->Lookup(fd);
+    if(openFile == NULL) return -1;
+    return openFile->Read(buffer,nBytes);
+}
+
+int FileSystem::Seek(int position, OpenFileId fd, FileDescriptorTable *fdTable){
+    OpenFile *openFile = fdTable->Lookup(fd);
+    if(openFile == NULL || position < 0 || position > openFile->Length()) return -1;
+    openFile->Seek(position);
+    return 1;
 }
 
 // 23-0510[j]: MP4 Subdirectory
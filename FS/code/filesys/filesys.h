@@ -32,6 +32,7 @@
 #include "copyright.h"
 #include "sysdep.h"
 #include "openfile.h"
+#include "fdtable.h"
 #include "debug.h" 		//just for test!!!
 
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
@@ -47,7 +48,7 @@ class FileSystem {
       int fileDescriptor = OpenForWrite(name);
 
       if (fileDescriptor == -1) return FALSE;
-      Close(fileDescriptor); 
+      ::Close(fileDescriptor); 
       return TRUE; 
     }
 
@@ -62,7 +63,7 @@ class FileSystem {
     }
 
     int Close(OpenFileId fileId) {
-      int ret = Close(fileId);
+      int ret = ::Close(fileId);	// the host's, not this one
       return ret==0?1:(-1);
     }
 
@@ -96,9 +97,7 @@ class FileSystem {
 
 #else // FILESYS
 
-#define NumOFTEntries 10    // 23-0507[j]: MP4
 #define pathNameMaxLen 256  // 23-0510[j]: MP4
-typedef int OpenFileId; 
 
 class FileSystem {
   public:
@@ -124,14 +123,21 @@ class FileSystem {
     //             對接 System Call Interface in ksyscall.h
 
     
-    OpenFileId OpenReturnId(char *name);
+    // Descriptors live in the calling program's "fdTable"; the
+    // OpenFile objects themselves live in our system-wide table.
+    OpenFileId OpenReturnId(char *name, FileDescriptorTable *fdTable);
 
     // 23-0507[j]: 只有透過 OpenReturnId(..) 開啟的 NachOS File 才需要 Close()
-    int Close(OpenFileId fileId);  
+    int Close(OpenFileId fileId, FileDescriptorTable *fdTable);
 
-    int Write(OpenFileId fd,char *buffer, int nBytes);
+    int Write(OpenFileId fd,char *buffer, int nBytes, FileDescriptorTable *fdTable);
 
-    int Read(OpenFileId fd,char *buffer, int nBytes);
+    int Read(OpenFileId fd,char *buffer, int nBytes, FileDescriptorTable *fdTable);
+
+    int Seek(int position, OpenFileId fd, FileDescriptorTable *fdTable);
+
+    OpenFileTable *GetOpenFileTable() { return openFileTable; }
+					// For creating per-process tables
 
     // 23-0507[j]: MP4 Subdirectory
     int PathParse(char *path, char *filename);
@@ -152,10 +158,8 @@ class FileSystem {
     OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
           
-    // 23-0507[j]: 自行新增的 Open File Table，最多開啟 10 File (for User Program)
-    OpenFile* openFileTable[NumOFTEntries];
-    int openFileCount;
-    int FindFreeEntry();
+    OpenFileTable *openFileTable;	// System-wide table of files opened
+					// by user programs (see fdtable.h)
 };
 
 #endif // FILESYS
@@ -32,6 +32,18 @@ OpenFile::OpenFile(int sector)
     seekPosition = 0;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::OpenFile
+// 	Initialize the part of an open file that is not on our disk (see
+//	RemoteFile): just the seek position.
+//----------------------------------------------------------------------
+
+OpenFile::OpenFile()
+{
+    hdr = NULL;
+    seekPosition = 0;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
@@ -69,7 +69,7 @@ class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
 					// at "sector" on the disk
-    ~OpenFile();			// Close the file
+    virtual ~OpenFile();		// Close the file
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
@@ -80,16 +80,21 @@ class OpenFile {
 					// and increment position in file.
     int Write(char *from, int numBytes);
 
-    int ReadAt(char *into, int numBytes, int position);
+    virtual int ReadAt(char *into, int numBytes, int position);
     					// Read/write bytes from the file,
 					// bypassing the implicit position.
-    int WriteAt(char *from, int numBytes, int position);
+					// (A RemoteFile reads and writes a
+					// file on another machine instead.)
+    virtual int WriteAt(char *from, int numBytes, int position);
 
-    int Length(); 			// Return the number of bytes in the
+    virtual int Length(); 		// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
     
+  protected:
+    OpenFile();				// For a file not on our disk
+
   private:
     FileHeader *hdr;			// Header for this file 
     int seekPosition;			// Current position within the file
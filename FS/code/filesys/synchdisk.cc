@@ -5,10 +5,12 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries a semaphore to synchronize the interrupt
+//	handler with the waiting thread.  And, because the physical disk
+//	can only handle one operation at a time, requests that arrive
+//	while it is busy are queued; the interrupt handler sends the
+//	next one, chosen by the scheduling policy, as soon as the disk
+//	is free.  The queue is protected by turning interrupts off.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,25 +18,56 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "main.h"
 
+// The following class describes one request waiting for (or being
+// served by) the disk.  It lives on the stack of the requesting thread.
+
+class DiskRequest {
+  public:
+    int sector;				// Sector to read/write
+    char *data;				// Buffer to read into/write from
+    bool writing;			// Write request?
+    int arrival;			// When the request was made
+    Semaphore *done;			// Signalled when the disk is finished
+};
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	"traceName" -- if not NULL, record every disk request there
+//	"policy" -- how to pick the next request when several are waiting
+//	"cacheSectors" -- number of sectors to cache, 0 to disable the cache
 //----------------------------------------------------------------------
 /*
 // 23-0502[j]: SynchDisk()
     -	new Disk(this);		// 建立 模擬硬碟，並設定 中斷發生要呼叫 這裡的 CallBack()
-    -	new Semaphore(0);	// Semaphore = 0，wait()=Sleep() & signal()=WakeUp()
-    -	new Lock;			// 作為 Mutex 使用 Acquire() & Release()
 */
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(char *traceName, DiskPolicy policy, int cacheSectors)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    this->policy = policy;
+    queue = new List<DiskRequest *>;
+    current = NULL;
+    headTrack = 0;
+    scanUp = TRUE;
+
+    cacheSize = cacheSectors;
+    cacheSector = NULL;
+    cacheUsed = NULL;
+    cacheData = NULL;
+    cacheClock = 0;
+    if (cacheSize > 0) {
+        cacheSector = new int[cacheSize];
+        cacheUsed = new int[cacheSize];
+        cacheData = new char[cacheSize * SectorSize];
+        for (int i = 0; i < cacheSize; i++) {
+            cacheSector[i] = -1;
+            cacheUsed[i] = 0;
+        }
+    }
+    disk = new Disk(this, traceName);
 }
 
 //----------------------------------------------------------------------
@@ -46,8 +79,32 @@ SynchDisk::SynchDisk()
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete queue;
+    if (cacheSize > 0) {
+        delete [] cacheSector;
+        delete [] cacheUsed;
+        delete [] cacheData;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ParsePolicy
+// 	Translate the name of a scheduling policy, as given on the
+//	command line.  Return FALSE if the name is not known.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::ParsePolicy(char *name, DiskPolicy *policy)
+{
+    if (strcmp(name, "fifo") == 0)
+        *policy = DiskFIFO;
+    else if (strcmp(name, "sstf") == 0)
+        *policy = DiskSSTF;
+    else if (strcmp(name, "scan") == 0)
+        *policy = DiskSCAN;
+    else
+        return FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -61,20 +118,29 @@ SynchDisk::~SynchDisk()
 /*
 // 23-0502[j]: ReadSector(..)/WriteSector(..)
 -   主要功能：送出 I/O Request 給 Disk，並呼叫 Disk::ReadRequest/WriteRequest 來「實際存取」
-    1.	送出 I/O Request 前，先「請求鑰匙/上鎖 = lock->Acquire()」
+    1.	若 Disk 忙碌中，先將 Request 放入 queue 排隊
     2.	送出 I/O Request = 呼叫 disk->ReadRequest(..)
-    3.	等待 Disk 工作完成 = semaphore->P() = Wait()
-        若 Disk 完成 會呼叫 ISR = CallBack() = semaphore->V() = Signal()
+    3.	等待 Disk 工作完成 = done->P() = Wait()
+        若 Disk 完成 會呼叫 ISR = CallBack() = done->V() = Signal()
         並喚醒 Thread 執行到一半的 ReadSector(..)/WriteSector(..)
-    4.	完成 I/O Request 後，則「釋放鑰匙/解鎖 = lock->Release()」
 */
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    if (cacheSize > 0) {
+        IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+        int slot = CacheFind(sectorNumber);
+
+        if (slot >= 0) {
+            bcopy(&cacheData[slot * SectorSize], data, SectorSize);
+            kernel->stats->numDiskCacheHits++;
+        }
+        (void) kernel->interrupt->SetLevel(oldLevel);
+        if (slot >= 0)
+            return;
+    }
+    Request(sectorNumber, data, FALSE);
+    CacheStore(sectorNumber, data);
 }
 
 //----------------------------------------------------------------------
@@ -89,20 +155,163 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    CacheStore(sectorNumber, data);	// write-through
+    Request(sectorNumber, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Request
+// 	Send a request to the disk if it is idle, otherwise queue it.
+//	Either way, wait until the disk has finished with it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Request(int sectorNumber, char *data, bool writing)
+{
+    Semaphore done("synch disk request", 0);
+    DiskRequest request;
+    IntStatus oldLevel;
+
+    request.sector = sectorNumber;
+    request.data = data;
+    request.writing = writing;
+    request.arrival = kernel->stats->totalTicks;
+    request.done = &done;
+
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    if (current == NULL)
+        Issue(&request);
+    else
+        queue->Append(&request);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+
+    done.P();				// wait for interrupt
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Issue
+// 	Send a request to the idle disk.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Issue(DiskRequest *request)
+{
+    ASSERT(current == NULL);
+    current = request;
+    headTrack = request->sector / SectorsPerTrack;
+    kernel->stats->diskQueueTicks += kernel->stats->totalTicks - request->arrival;
+
+    if (request->writing)
+        disk->WriteRequest(request->sector, request->data);
+    else
+        disk->ReadRequest(request->sector, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PickNext
+// 	Remove from the queue the request to send next, according to
+//	the scheduling policy.  Ties go to the request that has waited
+//	longest.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::PickNext()
+{
+    DiskRequest *best = NULL;
+    int bestDistance = 0;
+
+    if (policy == DiskFIFO)
+        return queue->RemoveFront();
+
+    for (int pass = 0; best == NULL && pass < 2; pass++) {
+        ListIterator<DiskRequest *> iter(queue);
+
+        for (; !iter.IsDone(); iter.Next()) {
+            int distance = iter.Item()->sector / SectorsPerTrack - headTrack;
+
+            if (policy == DiskSCAN) {	// only look ahead of the head
+                if (!scanUp)
+                    distance = -distance;
+                if (distance < 0)
+                    continue;
+            } else {
+                distance = abs(distance);
+            }
+            if (best == NULL || distance < bestDistance) {
+                best = iter.Item();
+                bestDistance = distance;
+            }
+        }
+        if (best == NULL)		// nothing ahead, turn around
+            scanUp = !scanUp;
+    }
+    ASSERT(best != NULL);
+    queue->Remove(best);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::CacheFind
+// 	Return the cache slot holding "sectorNumber", or -1 if it is
+//	not cached.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::CacheFind(int sectorNumber)
+{
+    for (int i = 0; i < cacheSize; i++) {
+        if (cacheSector[i] == sectorNumber) {
+            cacheUsed[i] = ++cacheClock;
+            return i;
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::CacheStore
+// 	Put a copy of sector "sectorNumber" in the cache, replacing the
+//	least recently used sector if it is not already there.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::CacheStore(int sectorNumber, char *data)
+{
+    IntStatus oldLevel;
+    int slot;
+
+    if (cacheSize == 0)
+        return;
+
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    slot = CacheFind(sectorNumber);
+    if (slot < 0) {
+        slot = 0;
+        for (int i = 1; i < cacheSize; i++) {
+            if (cacheUsed[i] < cacheUsed[slot])
+                slot = i;
+        }
+        cacheSector[slot] = sectorNumber;
+        cacheUsed[slot] = ++cacheClock;
+    }
+    bcopy(data, &cacheData[slot * SectorSize], SectorSize);
+    (void) kernel->interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Send the next queued request, if any,
+//	and wake up the thread waiting for the one that just finished.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::CallBack()
 { 
-    semaphore->V();
+    DiskRequest *finished = current;
+
+    ASSERT(finished != NULL);
+    current = NULL;
+    if (!queue->IsEmpty())
+        Issue(PickNext());
+    finished->done->V();
 }
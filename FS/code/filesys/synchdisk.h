@@ -14,6 +14,7 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "list.h"
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -34,10 +35,28 @@
     = 確保 Disk 完成上個操作，才處理下一個請求
 */
 
+// Requests that arrive while the disk is busy wait in a queue; when the
+// disk finishes, the next one to send is picked by the scheduling
+// policy (DiskPolicy, in disk.h).  With one thread doing I/O at a time
+// (the normal case) the queue never holds more than one request and
+// every policy behaves like the original lock-protected SynchDisk;
+// the replay driver (diskreplay.h) is what makes the choice matter.
+//
+// Optionally, the SynchDisk keeps an LRU cache of recently used sectors.
+// The cache is write-through, so the disk contents are always up to
+// date; reads that hit the cache never reach the disk.
+
+class DiskRequest;
+
 class SynchDisk : public CallBackObj {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
+    SynchDisk(char *traceName = NULL, DiskPolicy policy = DiskFIFO,
+              int cacheSectors = 0);
+    					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
+					// Record requests in "traceName"
+					// if given; keep "cacheSectors"
+					// sectors in the cache (0 = none).
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -52,12 +71,34 @@ class SynchDisk : public CallBackObj {
 					// handler, to signal that the
 					// current disk operation is complete.
 
+    static bool ParsePolicy(char *name, DiskPolicy *policy);
+					// Translate "fifo", "sstf" or "scan";
+					// FALSE if "name" is none of them
+
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// How to pick the next request
+    List<DiskRequest *> *queue;		// Requests waiting for the disk
+    DiskRequest *current;		// Request the disk is working on,
+					// NULL if the disk is idle
+    int headTrack;			// Track of the last request sent
+    bool scanUp;			// SCAN: moving towards higher tracks?
+
+    int cacheSize;			// # of sectors in the cache
+    int *cacheSector;			// Sector held in each slot, -1 if none
+    int *cacheUsed;			// When each slot was last used
+    char *cacheData;			// Contents of the cached sectors
+    int cacheClock;			// Advances on every cache access
+
+    void Request(int sectorNumber, char *data, bool writing);
+					// Send a request to the disk, or queue
+					// it, and wait until it is done
+    void Issue(DiskRequest *request);	// Send "request" to the disk
+    DiskRequest *PickNext();		// Remove the next request to send
+					// from the queue
+    int CacheFind(int sectorNumber);	// Slot holding "sectorNumber", or -1
+    void CacheStore(int sectorNumber, char *data);
+					// Put a copy of "data" in the cache
 };
 
 #endif // SYNCHDISK_H
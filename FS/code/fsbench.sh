@@ -0,0 +1,134 @@
+#!/bin/sh
+# fsbench.sh
+#	Run the file system microbenchmarks (test/fsb_*.c) and print the
+#	results as a JSON array on stdout, one object per benchmark:
+#
+#	    benchmark, params, ok, ops, host_seconds, ops_per_sec,
+#	    total_ticks, idle_ticks, system_ticks, user_ticks, ticks_per_op,
+#	    disk_reads, disk_writes, disk_seek_tracks, disk_busy_ticks
+#
+#	"ops_per_sec" is measured against host wall time; the tick and
+#	disk counts are the ones Statistics::Print reports at Halt.
+#
+#	Every benchmark runs in a scratch directory against a freshly
+#	formatted DISK_0: the program ("/bprog") and its parameter file
+#	("/bparam", see test/fsbench.h) are copied in first, and only the
+#	final run is measured.  Nachos names are at most 9 characters.
+#
+# Usage: ./fsbench.sh [benchmark ...]
+#	Build first:  (cd build.linux; make) && (cd test; make fsbench)
+#	With no arguments every benchmark is run; "./fsbench.sh -l" lists
+#	them.  NACHOS and TESTDIR override where the binaries are found.
+
+CODEDIR=`cd \`dirname $0\` && pwd`
+NACHOS=${NACHOS:-$CODEDIR/build.linux/nachos}
+TESTDIR=${TESTDIR:-$CODEDIR/test}
+
+#	name		program		parameters (see each fsb_*.c)
+BENCHMARKS="
+create_storm	fsb_create	50 4 0 128
+seq_rw_16	fsb_seq		16 16384 1
+seq_rw_128	fsb_seq		128 65536 1
+seq_rw_1024	fsb_seq		1024 262144 1
+rand_rw_16	fsb_rand	16 65536 2000 1 50
+rand_rw_128	fsb_rand	128 65536 2000 1 50
+rand_rw_1024	fsb_rand	1024 262144 2000 1 50
+deep_lookup	fsb_lookup	200
+dir_list	fsb_create	60 1 1 128
+"
+
+if [ "$1" = "-l" ]; then
+    echo "$BENCHMARKS" | awk 'NF { print $1 }'
+    exit 0
+fi
+
+if [ ! -x "$NACHOS" ]; then
+    echo "fsbench: $NACHOS not found -- build nachos first" 1>&2
+    exit 1
+fi
+
+WORKDIR=`mktemp -d ${TMPDIR:-/tmp}/fsbench.XXXXXX` || exit 1
+trap 'rm -rf "$WORKDIR"' 0 1 2 15
+cd "$WORKDIR"
+
+# Start over from an empty disk holding just program $1, as "/bprog".
+fresh() {
+    rm -f DISK_0
+    "$NACHOS" -f -cp "$TESTDIR/$1" /bprog > setup.log 2>&1
+}
+
+# Store the benchmark parameters $* as "/bparam".
+params() {
+    echo "$*" > bparam
+    "$NACHOS" -cp bparam /bparam >> setup.log 2>&1
+}
+
+# Run "$@" and turn its output into one JSON object.
+# $BENCH, $PARAMS and $OPS (if the ops count isn't printed) describe it.
+measure() {
+    start=`date +%s%N`
+    "$@" > run.log 2>&1
+    end=`date +%s%N`
+    awk -v bench="$BENCH" -v params="$PARAMS" -v ops="$OPS" \
+        -v ns=`expr $end - $start` '
+	/^[0-9]+$/ && !halted	{ ops = $1 }
+	/^Machine halting!/	{ halted = 1 }
+	/^Ticks: total/		{ gsub(",", ""); total = $3; idle = $5;
+				  sys = $7; user = $9 }
+	/^Disk I\/O: reads/	{ gsub(",", ""); reads = $4; writes = $6 }
+	/^Disk scheduling:/	{ gsub(",", ""); seek = $5; busy = $8 }
+	END {
+	    secs = ns / 1e9;
+	    ok = (halted && ops > 0) ? "true" : "false";
+	    printf("  {\"benchmark\": \"%s\", \"params\": \"%s\", \"ok\": %s, ",
+		   bench, params, ok);
+	    printf("\"ops\": %d, \"host_seconds\": %.6f, \"ops_per_sec\": %.1f, ",
+		   ops, secs, secs > 0 ? ops / secs : 0);
+	    printf("\"total_ticks\": %d, \"idle_ticks\": %d, ", total, idle);
+	    printf("\"system_ticks\": %d, \"user_ticks\": %d, ", sys, user);
+	    printf("\"ticks_per_op\": %.1f, ", ops > 0 ? total / ops : 0);
+	    printf("\"disk_reads\": %d, \"disk_writes\": %d, ", reads, writes);
+	    printf("\"disk_seek_tracks\": %d, \"disk_busy_ticks\": %d}",
+		   seek, busy);
+	}' run.log
+}
+
+run() {
+    BENCH=$1; PROG=$2; shift 2; PARAMS="$*"; OPS=0
+    fresh $PROG
+    params "$@"
+    case $BENCH in
+    deep_lookup)
+	dir=""
+	for d in d1 d2 d3 d4 d5 d6 d7 d8; do
+	    dir="$dir/$d"
+	    "$NACHOS" -mkdir $dir >> setup.log 2>&1
+	done
+	measure "$NACHOS" -e /bprog
+	;;
+    dir_list)
+	# populate the root directory, then time listing it
+	"$NACHOS" -e /bprog >> setup.log 2>&1
+	OPS=$1
+	measure "$NACHOS" -l /
+	;;
+    *)
+	measure "$NACHOS" -e /bprog
+	;;
+    esac
+}
+
+sep=""
+echo "["
+echo "$BENCHMARKS" | while read name prog args; do
+    [ -z "$name" ] && continue
+    if [ $# -gt 0 ]; then
+	case " $* " in *" $name "*) ;; *) continue ;; esac
+    fi
+    printf "%s" "$sep"
+    run $name $prog $args < /dev/null	# nachos would read the list
+    sep=",
+"
+done
+echo ""
+echo "]"
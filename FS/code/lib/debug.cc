@@ -20,25 +20,14 @@
 
 Debug::Debug(char *flagList)
 {
-    enableFlags = flagList;
-}
-
-
-//----------------------------------------------------------------------
-// Debug::IsEnabled
-//      Return TRUE if DEBUG messages with "flag" are to be printed.
-//
-// 22-1223[j]: char* strchr(const char* str, char c) 搜尋 str中 第一個 = c 的字元，並 return 位址
-//----------------------------------------------------------------------
-// 22-1223[j]: bool IsEnabled(char flag): 檢查 debug 的 "flag"代表之功能是否開啟，若開啟 則回傳 True       
-
-bool
-Debug::IsEnabled(char flag)
-{
-    if (enableFlags != NULL) {
-	return ((strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0));
-    } else {
-    	return FALSE;
+    for (int i = 0; i < 4; i++)
+        enabled[i] = 0;
+    for (char *f = flagList; f != NULL && *f != '\0'; f++) {
+        if (*f == dbgAll) {
+            for (int i = 0; i < 4; i++)
+                enabled[i] = ~0U;
+        } else {
+            enabled[(*f >> 5) & 3] |= 1U << (*f & 31);
+        }
     }
 }
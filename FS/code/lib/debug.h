@@ -5,6 +5,11 @@
 //	debugging messages, controllable from the command line arguments
 //	passed to Nachos (-d).  You are encouraged to add your own
 //	debugging flags.  Please.... 
+//
+//	The flags are turned into a bitmask when Nachos starts, so a
+//	DEBUG whose flag is off costs one test of a bit.  Defining
+//	NO_DEBUG (see DEFINES in the Makefile) compiles the messages out
+//	altogether, for timing runs; -d then has no effect.
 
 #ifndef DEBUG_H
 #define DEBUG_H
@@ -34,10 +39,17 @@ class Debug {
   public:
     Debug(char *flagList);
 
-    bool IsEnabled(char flag);
+    bool IsEnabled(char flag) {	// Are "flag" messages printed?
+#ifdef NO_DEBUG
+	return FALSE;
+#else
+	return (enabled[(flag >> 5) & 3] >> (flag & 31)) & 1;
+#endif
+    }
 
   private:
-    char *enableFlags;		// controls which DEBUG messages are printed
+    unsigned int enabled[4];	// one bit for each flag character:
+				// which DEBUG messages are printed
 };
 
 extern Debug *debug;
@@ -52,10 +64,17 @@ extern Debug *debug;
 // 22-1223[j]: DEBUG(flag,expr) 
 //             即 IsEnabled(flag) 的延伸 -> 檢查 debug 的 "flag"代表之功能是否開啟，若開啟 則印出
 
+#ifdef NO_DEBUG
+#define DEBUG(flag,expr)                                                     \
+    if (TRUE) {} else { 						\
+        cerr << expr << "\n";   				        \
+    }
+#else
 #define DEBUG(flag,expr)                                                     \
     if (!debug->IsEnabled(flag)) {} else { 				\
         cerr << expr << "\n";   				        \
     }
+#endif
 
 
 //----------------------------------------------------------------------
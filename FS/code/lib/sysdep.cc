@@ -34,6 +34,9 @@
 #include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <cerrno>
 
 #ifdef SOLARIS
@@ -151,6 +154,21 @@ UDelay(unsigned int useconds)
 
 }
 
+//----------------------------------------------------------------------
+// HostSeconds
+// 	Return the host's wall-clock time, in seconds.  Only differences
+//	between two calls mean anything; used to time benchmarks.
+//----------------------------------------------------------------------
+
+double
+HostSeconds()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -298,6 +316,39 @@ PollFile(int fd)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// WaitForFiles
+// 	Block until at least one of the open files or sockets has
+//	characters that can be read (or a signal arrives), or until
+//	"msec" milliseconds have passed.  Unlike PollFile, nothing is
+//	read, and the caller does not spin.  Return FALSE if the time
+//	ran out first.
+//
+//	"fds" -- the file descriptors to wait on
+//	"numFds" -- how many there are
+//	"msec" -- the longest to wait, or -1 for as long as it takes
+//----------------------------------------------------------------------
+
+bool
+WaitForFiles(int *fds, int numFds, int msec)
+{
+    fd_set rfd;
+    int maxFd = -1;
+    struct timeval limit;
+
+    FD_ZERO(&rfd);
+    for (int i = 0; i < numFds; i++) {
+        FD_SET(fds[i], &rfd);
+        if (fds[i] > maxFd)
+            maxFd = fds[i];
+    }
+    limit.tv_sec = msec / 1000;
+    limit.tv_usec = (msec % 1000) * 1000;
+    // EINTR just means the wait is over
+    return select(maxFd + 1, &rfd, NULL, NULL,
+                  (msec < 0) ? NULL : &limit) != 0;
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -307,7 +358,7 @@ PollFile(int fd)
 //----------------------------------------------------------------------
 
 int
-OpenForWrite(char *name)
+OpenForWrite(const char *name)
 {
     int fd = open(name, O_RDWR|O_CREAT|O_TRUNC, 0666);
 
@@ -324,7 +375,7 @@ OpenForWrite(char *name)
 //----------------------------------------------------------------------
 
 int
-OpenForReadWrite(char *name, bool crashOnError)
+OpenForReadWrite(const char *name, bool crashOnError)
 {
     int fd = open(name, O_RDWR, 0);
 
@@ -364,7 +415,7 @@ ReadPartial(int fd, char *buffer, int nBytes)
 //----------------------------------------------------------------------
 
 void 
-WriteFile(int fd, char *buffer, int nBytes)
+WriteFile(int fd, const char *buffer, int nBytes)
 {
     //printf("In sysdep.cc, nBytes: %d\n", nBytes);
 	int retVal = write(fd, buffer, nBytes);
@@ -573,3 +624,88 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
     // This may mask other kinds of failures, but it is the
     // right thing to do in the common case.
 }
+
+//----------------------------------------------------------------------
+// RingDoorbell
+// 	Send a one byte datagram to another Nachos' IPC port, to wake it
+//	if it is waiting (see WaitForFiles).  Unlike SendToSocket, never
+//	wait: if the port is gone, or already has bytes queued, the
+//	ring is not needed.
+//----------------------------------------------------------------------
+void
+RingDoorbell(int sockID, char *toName)
+{
+    struct sockaddr_un uName;
+    char ch = 0;
+
+    InitSocketName(&uName, toName);
+    (void) sendto(sockID, &ch, 1, MSG_DONTWAIT,
+                  (struct sockaddr *) &uName, sizeof(uName));
+}
+
+//----------------------------------------------------------------------
+// DrainSocket
+// 	Throw away whatever is waiting on an IPC port, without waiting.
+//----------------------------------------------------------------------
+void
+DrainSocket(int sockID)
+{
+    char buffer[64];
+
+    while (recv(sockID, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+        ;
+}
+
+//----------------------------------------------------------------------
+// MapSharedFile
+// 	Map a file into memory, so that other Nachos mapping it see what
+//	is written to it.  Return NULL if that cannot be done.
+//
+//	"name" -- file name
+//	"size" -- bytes to map
+//	"create" -- TRUE to create the file afresh, filled with zeroes;
+//		FALSE to map one another Nachos has created
+//----------------------------------------------------------------------
+char *
+MapSharedFile(char *name, int size, bool create)
+{
+    struct stat info;
+    void *addr;
+    int fd;
+
+    if (create) {
+        (void) unlink(name);	// in case it's still around from last time
+        fd = open(name, O_RDWR | O_CREAT, 0666);
+        if (fd < 0)
+            return NULL;
+        if (ftruncate(fd, size) < 0) {
+            (void) close(fd);
+            return NULL;
+        }
+    } else {
+        fd = open(name, O_RDWR);
+        if (fd < 0)
+            return NULL;
+        // it may not have been given its size yet
+        if (fstat(fd, &info) < 0 || info.st_size < size) {
+            (void) close(fd);
+            return NULL;
+        }
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    (void) close(fd);		// the mapping stays
+    if (addr == MAP_FAILED)
+        return NULL;
+    DEBUG(dbgNet, "Mapped shared file " << name);
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// UnmapSharedFile
+// 	Undo MapSharedFile.
+//----------------------------------------------------------------------
+void
+UnmapSharedFile(char *addr, int size)
+{
+    (void) munmap(addr, size);
+}
@@ -26,6 +26,7 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
+extern double HostSeconds();		// host wall-clock time, for timing
 
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(void (*cleanup)(int));
@@ -43,14 +44,18 @@ extern void DeallocBoundedArray(char *p, int size);
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Wait, without spinning, until one of the files has characters to read,
+// or "msec" milliseconds have passed (-1 for no limit)
+extern bool WaitForFiles(int *fds, int numFds, int msec);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 // 23-0104[j]: 實作見 sysdep.cc
-extern int OpenForWrite(char *name);
-extern int OpenForReadWrite(char *name, bool crashOnError);
+extern int OpenForWrite(const char *name);
+extern int OpenForReadWrite(const char *name, bool crashOnError);
 extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
-extern void WriteFile(int fd, char *buffer, int nBytes);
+extern void WriteFile(int fd, const char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern int Close(int fd);   // 23-0103[j]: 0(Success)/ -1(Failed)
@@ -74,5 +79,11 @@ extern void DeAssignNameToSocket(char *socketName);
 extern bool PollSocket(int sockID);
 extern void ReadFromSocket(int sockID, char *buffer, int packetSize);
 extern void SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
+extern void RingDoorbell(int sockID, char *toName);
+extern void DrainSocket(int sockID);
+
+// Shared memory, for simulating the network between Nachos on one host
+extern char *MapSharedFile(char *name, int size, bool create);
+extern void UnmapSharedFile(char *addr, int size);
 
 #endif // SYSDEP_H
@@ -0,0 +1,175 @@
+// cache.cc
+//	Routines to simulate the first level caches of the user CPU.
+//	See cache.h for the model.
+
+#include "copyright.h"
+#include "cache.h"
+#include "debug.h"
+
+//----------------------------------------------------------------------
+// IsPowerOf2
+// 	Is "n" a (positive) power of 2?
+//----------------------------------------------------------------------
+
+static bool
+IsPowerOf2(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+//----------------------------------------------------------------------
+// Cache::Cache
+// 	Create an empty cache.  The shape must be one ParseGeometry
+//	accepts.
+//
+//	"size" -- bytes the cache holds
+//	"lineSize" -- bytes per line
+//	"ways" -- lines per set
+//	"writeBack" -- write-back (TRUE) or write-through (FALSE)
+//	"missTicks" -- time to fill a line, or write one to memory
+//	"totals" -- where to count every access
+//----------------------------------------------------------------------
+
+Cache::Cache(int size, int lineSize, int ways, bool writeBack,
+             int missTicks, CacheStats *totals)
+{
+    ASSERT(IsPowerOf2(lineSize) && size % (lineSize * ways) == 0);
+    for (lineShift = 0; (1 << lineShift) < lineSize; lineShift++)
+        ;
+    numSets = size / (lineSize * ways);
+    this->ways = ways;
+    this->writeBack = writeBack;
+    this->missTicks = missTicks;
+    this->totals = totals;
+    lines = new CacheLine[numSets * ways];
+    for (int i = 0; i < numSets * ways; i++) {
+        lines[i].valid = FALSE;
+        lines[i].dirty = FALSE;
+        lines[i].lastUse = 0;
+    }
+    clock = 0;
+}
+
+//----------------------------------------------------------------------
+// Cache::~Cache
+//----------------------------------------------------------------------
+
+Cache::~Cache()
+{
+    delete [] lines;
+}
+
+//----------------------------------------------------------------------
+// Cache::ParseGeometry
+// 	Translate a cache shape, as given on the command line:
+//	"size,line,ways", optionally followed by ",wb" (write-back, the
+//	default) or ",wt" (write-through).  Return FALSE if the shape
+//	is malformed or impossible: the size and line size must be
+//	powers of 2, a line at least a word, and the size a whole
+//	number of sets.
+//----------------------------------------------------------------------
+
+bool
+Cache::ParseGeometry(char *spec, int *size, int *lineSize, int *ways,
+                     bool *writeBack)
+{
+    char policy[3];
+    int n;
+
+    n = sscanf(spec, "%d,%d,%d,%2s", size, lineSize, ways, policy);
+    if (n < 3)
+        return FALSE;
+    if (n == 3 || strcmp(policy, "wb") == 0)
+        *writeBack = TRUE;
+    else if (strcmp(policy, "wt") == 0)
+        *writeBack = FALSE;
+    else
+        return FALSE;
+    return IsPowerOf2(*size) && IsPowerOf2(*lineSize) && *lineSize >= 4
+           && *ways > 0 && *size % (*lineSize * *ways) == 0;
+}
+
+//----------------------------------------------------------------------
+// Tally
+// 	Count one access in "stats", if there is one.
+//----------------------------------------------------------------------
+
+static void
+Tally(CacheStats *stats, bool writing, bool miss, bool wroteBack)
+{
+    if (stats == NULL)
+        return;
+    if (writing) {
+        stats->writes++;
+        if (miss)
+            stats->writeMisses++;
+    } else {
+        stats->reads++;
+        if (miss)
+            stats->readMisses++;
+    }
+    if (wroteBack)
+        stats->writeBacks++;
+}
+
+//----------------------------------------------------------------------
+// Cache::Access
+// 	Simulate a read or write of the word at "physAddr": find its
+//	line, filling it from memory (and first writing back the line
+//	it replaces) if need be.  Return the time spent waiting for
+//	memory, 0 on a hit.
+//
+//	"physAddr" -- offset of the access in mainMemory
+//	"writing" -- is it a store?
+//	"process" -- the running program's counts, or NULL
+//----------------------------------------------------------------------
+
+int
+Cache::Access(int physAddr, bool writing, CacheStats *process)
+{
+    unsigned int line = (unsigned) physAddr >> lineShift;
+    unsigned int tag = line / numSets;
+    CacheLine *set = &lines[(line % numSets) * ways];
+    CacheLine *victim = &set[0];
+    bool wroteBack = FALSE;
+    int ticks = 0;
+
+    clock++;
+    for (int i = 0; i < ways; i++) {
+        if (set[i].valid && set[i].tag == tag) {	// hit
+            set[i].lastUse = clock;
+            if (writing) {
+                if (writeBack)
+                    set[i].dirty = TRUE;
+                else
+                    ticks = missTicks;		// write through to memory
+            }
+            Tally(totals, writing, FALSE, FALSE);
+            Tally(process, writing, FALSE, FALSE);
+            return ticks;
+        }
+        if (!victim->valid)
+            continue;				// already found an empty line
+        if (!set[i].valid || set[i].lastUse < victim->lastUse)
+            victim = &set[i];
+    }
+
+    if (writing && !writeBack) {		// no write allocate
+        ticks = missTicks;
+    } else {
+        if (victim->valid && victim->dirty) {
+            wroteBack = TRUE;
+            ticks += missTicks;
+        }
+        DEBUG(dbgMach, "Cache miss at " << physAddr << ", filling line "
+                            << (victim - lines));
+        victim->tag = tag;
+        victim->valid = TRUE;
+        victim->dirty = writing;
+        victim->lastUse = clock;
+        ticks += missTicks;
+    }
+    Tally(totals, writing, TRUE, wroteBack);
+    Tally(process, writing, TRUE, wroteBack);
+    return ticks;
+}
@@ -0,0 +1,71 @@
+// cache.h
+//	Data structures to simulate the first level instruction and data
+//	caches of the user CPU.
+//
+//	The caches are optional ("nachos -icache ... -dcache ...").  Each
+//	is set associative, with LRU replacement, and is indexed and
+//	tagged with physical addresses, so nothing needs to be flushed
+//	on a context switch.  Only the tags are simulated: the data is
+//	always read from and written to mainMemory.
+//
+//	A miss costs "missTicks" (in UserTicks) to fill the line from
+//	memory.  Two write policies are modelled:
+//		write-back -- a store that misses fills the line first
+//			  (write allocate); a dirty line costs another
+//			  "missTicks" to write back when it is replaced
+//		write-through -- every store waits "missTicks" for memory
+//			  (there is no write buffer); a store that misses
+//			  does not fill the line
+//
+//	Hits and misses are counted for the whole machine (in
+//	Statistics) and for the program now running (see AddrSpace).
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "stats.h"
+
+// The following class is the tag of one line of the cache.
+
+class CacheLine {
+  public:
+    unsigned int tag;			// Which memory line is held here
+    bool valid;				// Does the line hold anything?
+    bool dirty;				// Modified since it was filled?
+    unsigned long long lastUse;		// When it was last used, for LRU
+};
+
+class Cache {
+  public:
+    Cache(int size, int lineSize, int ways, bool writeBack, int missTicks,
+          CacheStats *totals);
+					// Create an empty cache of "size"
+					// bytes; count into "totals"
+    ~Cache();
+
+    int Access(int physAddr, bool writing, CacheStats *process);
+					// Look up "physAddr"; return the
+					// UserTicks spent waiting for memory.
+					// Also count into "process", if
+					// not NULL
+
+    static bool ParseGeometry(char *spec, int *size, int *lineSize,
+                              int *ways, bool *writeBack);
+					// Cache shape from its command line
+					// form, "size,line,ways[,wb|wt]"
+
+  private:
+    int lineShift;			// log2 of the line size
+    int numSets;
+    int ways;				// Lines in each set
+    bool writeBack;			// Write-back (else write-through)?
+    int missTicks;			// Time to go to memory
+    CacheLine *lines;			// Set "s" is lines[s*ways .. s*ways+ways-1]
+    unsigned long long clock;		// # of accesses so far, for LRU;
+					// 64 bits, so that it cannot wrap
+    CacheStats *totals;			// Counts for the whole machine
+};
+
+#endif // CACHE_H
@@ -34,10 +34,11 @@ ConsoleInput::ConsoleInput(char *readFile, CallBackObj *toCall)
 
     // set up the stuff to emulate asynchronous interrupts
     callWhenAvail = toCall;
-    incoming = EOF;
+    numIncoming = nextIncoming = 0;
 
     // start polling for incoming keystrokes
-    kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+    kernel->interrupt->SchedulePoll(this, ConsoleTime, ConsoleReadInt,
+                                    readFileNo);
 }
 
 //----------------------------------------------------------------------
@@ -64,29 +65,32 @@ ConsoleInput::~ConsoleInput()
 void
 ConsoleInput::CallBack()
 {
-  char c;
   int readCount;
 
-    ASSERT(incoming == EOF);
+    if (nextIncoming < numIncoming) {	// the rest of the last batch
+	callWhenAvail->CallBack();
+	return;
+    }
     if (!PollFile(readFileNo)) { // nothing to be read
         // schedule the next time to poll for a packet
-        kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+        kernel->interrupt->SchedulePoll(this, ConsoleTime, ConsoleReadInt,
+                                        readFileNo);
     } else { 
-    	// otherwise, try to read a character
-    	readCount = ReadPartial(readFileNo, &c, sizeof(char));
-	if (readCount == 0) {
+    	// otherwise, take everything that has been typed
+    	readCount = ReadPartial(readFileNo, incoming, ConsoleBufferSize);
+	nextIncoming = 0;
+	if (readCount <= 0) {
 	   // this seems to happen at end of file, when the
 	   // console input is a regular file
 	   // don't schedule an interrupt, since there will never
 	   // be any more input
-	   // just do nothing....
+	   numIncoming = 0;
 	}
 	else {
-	  // save the character and notify the OS that
-	  // it is available
-	  ASSERT(readCount == sizeof(char));
-	  incoming = c;
-	  kernel->stats->numConsoleCharsRead++;
+	  // save the characters and notify the OS that
+	  // they are available
+	  numIncoming = readCount;
+	  kernel->stats->numConsoleCharsRead += readCount;
 	}
 	callWhenAvail->CallBack();
     }
@@ -101,15 +105,42 @@ ConsoleInput::CallBack()
 char
 ConsoleInput::GetChar()
 {
-   char ch = incoming;
+   char ch;
 
-   if (incoming != EOF) {	// schedule when next char will arrive
-       kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
-   }
-   incoming = EOF;
+   if (GetBuffer(&ch, 1) == 0)
+       return EOF;
    return ch;
 }
 
+//----------------------------------------------------------------------
+// ConsoleInput::GetBuffer()
+// 	Read up to "length" characters from the input buffer into
+//	"into".  Return how many were read: 0 if none are buffered,
+//	which after an interrupt means the end of the input.
+//
+//	Any left over are announced again by the next interrupt, so
+//	that there is one interrupt for every GetBuffer or GetChar.
+//----------------------------------------------------------------------
+
+int
+ConsoleInput::GetBuffer(char *into, int length)
+{
+   int count = numIncoming - nextIncoming;
+
+   if (count <= 0)
+       return 0;
+   if (count > length)
+       count = length;
+   bcopy(&incoming[nextIncoming], into, count);
+   nextIncoming += count;
+   if (nextIncoming < numIncoming)	// announce the rest
+       kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+   else				// schedule when next char will arrive
+       kernel->interrupt->SchedulePoll(this, ConsoleTime, ConsoleReadInt,
+                                       readFileNo);
+   return count;
+}
+
 
 
 //----------------------------------------------------------------------
@@ -136,6 +167,7 @@ ConsoleOutput::ConsoleOutput(char *writeFile, CallBackObj *toCall)
 
     callWhenDone = toCall;
     putBusy = FALSE;
+    putLength = 0;
 }
 
 //----------------------------------------------------------------------
@@ -151,8 +183,8 @@ ConsoleOutput::~ConsoleOutput()
 
 //----------------------------------------------------------------------
 // ConsoleOutput::CallBack()
-// 	Simulator calls this when the next character can be output to the
-//	display.
+// 	Simulator calls this when the last PutChar or PutBuffer is done,
+//	and the next can be output to the display.
 //----------------------------------------------------------------------
 // 23-0103[j]: 硬體工作完成後，會呼叫「中斷服務程式 ISR」(由Timer每個Tick，去檢查有沒有「待執行中斷」)
 // 23-0103[j]: 而「某個硬體的ISR」在 NachOS 稱為 class 硬體 中的 CallBack()方法
@@ -161,7 +193,7 @@ ConsoleOutput::CallBack()
 {
 	DEBUG(dbgTraCode, "In ConsoleOutput::CallBack(), " << kernel->stats->totalTicks);
     putBusy = FALSE;
-    kernel->stats->numConsoleCharsWritten++; // 23-0101[j]: 在 stats 紀錄 寫入的Bytes數+1
+    kernel->stats->numConsoleCharsWritten += putLength; // 23-0101[j]: 在 stats 紀錄 寫入的Bytes數
     callWhenDone->CallBack();   
     // 23-0102[j]: callWhenDone = tocall = this = SynchConsoleOutput物件的位址
     // 23-0102[j]: 呼叫 SynchConsoleOutput物件的CallBack()方法，是為了 waitFor->V() 即宣布 目前自己 已不佔用 ConsoleOutput
@@ -179,8 +211,22 @@ ConsoleOutput::CallBack()
 void
 ConsoleOutput::PutChar(char ch)
 {
-    ASSERT(putBusy == FALSE);
-    WriteFile(writeFileNo, &ch, sizeof(char));
+    PutBuffer(&ch, 1);
+}
+
+//----------------------------------------------------------------------
+// ConsoleOutput::PutBuffer()
+// 	Write "length" characters to the simulated display at once, and
+//	schedule a single interrupt for when the last of them would
+//	have gone out, ConsoleTime ticks per character.
+//----------------------------------------------------------------------
+
+void
+ConsoleOutput::PutBuffer(char *data, int length)
+{
+    ASSERT(putBusy == FALSE && length > 0);
+    WriteFile(writeFileNo, data, length);
     putBusy = TRUE;
-    kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
+    putLength = length;
+    kernel->interrupt->Schedule(this, length * ConsoleTime, ConsoleWriteInt);
 }
@@ -13,6 +13,13 @@
 //	to the console has limited bandwidth (like a modem!), and so
 //	each character takes measurable time.
 //
+//	Like a DMA controller, the device moves a whole buffer per
+//	request: PutBuffer writes "length" characters and interrupts
+//	once, ConsoleTime ticks per character later, and each interrupt
+//	from the keyboard hands over everything typed so far (up to
+//	ConsoleBufferSize characters), for GetBuffer to take.  PutChar
+//	and GetChar are the one-character cases.
+//
 //	The user of the device registers itself to be called "back" when 
 //	the read/write interrupts occur.  There is a separate interrupt
 //	for read and write, and the device is "duplex" -- a character
@@ -31,6 +38,8 @@
 #include "utility.h"
 #include "callback.h"
 
+const int ConsoleBufferSize = 128;	// most characters read per interrupt
+
 // The following two classes define the input (and output) side of a 
 // hardware console device.  Input (and output) to the device is simulated 
 // by reading (and writing) to the UNIX file "readFile" (and "writeFile").
@@ -57,6 +66,9 @@ class ConsoleInput : public CallBackObj {
 				// available, return it.  Otherwise, return EOF.
     				// "callWhenAvail" is called whenever there is 
 				// a char to be gotten
+    int GetBuffer(char *into, int length);
+				// Take up to "length" of the chars that
+				// have arrived; 0 at end of file
 
     void CallBack();		// Invoked when a character arrives
 				// from the keyboard.
@@ -65,9 +77,10 @@ class ConsoleInput : public CallBackObj {
     int readFileNo;			// UNIX file emulating the keyboard 
     CallBackObj *callWhenAvail;		// Interrupt handler to call when 
 					// there is a char to be read
-    char incoming;    			// Contains the character to be read,
-					// if there is one available. 
-					// Otherwise contains EOF.
+    char incoming[ConsoleBufferSize];	// Characters that have arrived
+    int numIncoming;			// # of them; 0 at end of file
+    int nextIncoming;			// The next one to be read; if it is
+					// numIncoming, none is available
 };
 
 class ConsoleOutput : public CallBackObj {
@@ -79,6 +92,9 @@ class ConsoleOutput : public CallBackObj {
     void PutChar(char ch);	// Write "ch" to the console display, 
 				// and return immediately.   
 				// "callWhenDone" will called when the I/O completes. 
+    void PutBuffer(char *data, int length);
+				// Write "length" chars at once; one
+				// interrupt when they have all gone out
     void CallBack();		// Invoked when next character can be put
 				// out to the display.
     void PutInt(int n);         // Write n to the console display 
@@ -89,6 +105,7 @@ class ConsoleOutput : public CallBackObj {
 					// the next char can be put 
     bool putBusy;    			// Is a PutChar operation in progress?
 					// If so, you can't do another one!
+    int putLength;			// # of chars it is writing
 };
 
 #endif // CONSOLE_H
@@ -18,6 +18,7 @@
 #include "debug.h"
 #include "sysdep.h"
 #include "main.h"
+#include "tracer.h"
 
 // We put a magic number at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file 
@@ -35,6 +36,7 @@ const int DiskSize = (MagicSize + (NumSectors * SectorSize));
 // 	ok to treat it as Nachos disk storage.
 //
 //	"toCall" -- object to call when disk read/write request completes
+//	"traceName" -- if not NULL, the UNIX file to record requests in
 //----------------------------------------------------------------------
 /*
 // 23-0428[j]: Disk(..)
@@ -56,7 +58,7 @@ const int DiskSize = (MagicSize + (NumSectors * SectorSize));
     -> 當 I/O 完成時呼叫 toCall->CallBack() 等同呼叫 模擬硬體物件的 CallBack()
 
 */
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(CallBackObj *toCall, char *traceName)
 {
     int magicNum;
     int tmp = 0;
@@ -84,19 +86,76 @@ Disk::Disk(CallBackObj *toCall)
 	    WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
     active = FALSE;
+
+    traceFile = -1;
+    trace = NULL;
+    numTraced = 0;
+    if (traceName != NULL) {
+        int magic = DiskTraceMagic;
+
+        DEBUG(dbgDisk, "Tracing disk requests to " << traceName);
+        traceFile = OpenForWrite(traceName);
+        WriteFile(traceFile, (char *) &magic, sizeof(int));
+        trace = new DiskTraceRecord[DiskTraceBuffer];
+    }
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk, and the trace file if there is one.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (traceFile >= 0) {
+        FlushTrace();
+        Close(traceFile);
+        delete [] trace;
+    }
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// Disk::Trace
+// 	Record a request in the trace, if we are keeping one.  Records
+//	are buffered, so tracing adds no host I/O to most requests.
+//
+//	"sectorNumber" -- the sector being read/written
+//	"writing" -- TRUE for a write request
+//	"latency" -- how long the request will take, from ComputeLatency
+//----------------------------------------------------------------------
+
+void
+Disk::Trace(int sectorNumber, bool writing, int latency)
+{
+    DiskTraceRecord *rec;
+
+    if (traceFile < 0)
+        return;
+    if (numTraced == DiskTraceBuffer)
+        FlushTrace();
+    rec = &trace[numTraced++];
+    rec->when = kernel->stats->totalTicks;
+    rec->sector = sectorNumber | (writing ? DiskTraceWrite : 0);
+    rec->latency = latency;
+}
+
+//----------------------------------------------------------------------
+// Disk::FlushTrace
+// 	Write out the buffered trace records.
+//----------------------------------------------------------------------
+
+void
+Disk::FlushTrace()
+{
+    if (numTraced > 0) {
+        WriteFile(traceFile, (char *) trace,
+                  numTraced * sizeof(DiskTraceRecord));
+        numTraced = 0;
+    }
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -161,8 +220,11 @@ Disk::ReadRequest(int sectorNumber, char* data)
     // 23-0501[j]: 開始讀取，設定 Disk 忙碌中 (active = TRUE)
     //             並更新 lastSector = 本次 sectorNumber
     active = TRUE;
+    Trace(sectorNumber, FALSE, ticks);
+    TRACE(TraceDiskRead, sectorNumber, ticks);
     UpdateLast(sectorNumber);
     kernel->stats->numDiskReads++;  // 23-0501[j]: 統計一下 Disk 讀取的資料數
+    kernel->stats->diskBusyTicks += ticks;
     // 23-0501[j]: 安排一個「模擬中斷」在過了「ticks 時刻之後引發」(類型是 DiskInt)
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
@@ -182,8 +244,11 @@ Disk::WriteRequest(int sectorNumber, char* data)
 	PrintSector(TRUE, sectorNumber, data);
     
     active = TRUE;
+    Trace(sectorNumber, TRUE, ticks);
+    TRACE(TraceDiskWrite, sectorNumber, ticks);
     UpdateLast(sectorNumber);
     kernel->stats->numDiskWrites++;
+    kernel->stats->diskBusyTicks += ticks;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
@@ -366,6 +431,7 @@ Disk::UpdateLast(int newSector)
     if (seek != 0)
 	    bufferInit = kernel->stats->totalTicks + seek + rotate;
 
+    kernel->stats->numDiskSeekTracks += seek / SeekTime;
     lastSector = newSector;
     DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
 }
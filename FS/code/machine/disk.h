@@ -55,6 +55,30 @@ const int SectorsPerTrack  = 32;	// number of sectors per disk track
 const int NumTracks = 16384;		// number of tracks per disk
 const int NumSectors = (SectorsPerTrack * NumTracks);
 					// total # of sectors per disk
+
+// A disk trace (see Disk::Trace) is a host file holding
+// DiskTraceMagic followed by one DiskTraceRecord per request, in the
+// order the requests were sent to the disk.  The replay driver in
+// filesys/diskreplay.cc feeds it back through the SynchDisk.
+
+const int DiskTraceMagic = 0x44545243;	// "DTRC"
+const unsigned int DiskTraceWrite = 0x80000000;
+					// set in "sector" for write requests
+
+typedef struct {
+    int when;				// totalTicks when the request was issued
+    unsigned int sector;		// sector number | DiskTraceWrite
+    int latency;			// ticks from ComputeLatency
+} DiskTraceRecord;
+
+const int DiskTraceBuffer = 512;	// # of records buffered before
+					// they are written out
+
+// How the SynchDisk picks the next request when several are waiting.
+
+enum DiskPolicy { DiskFIFO, DiskSSTF, DiskSCAN };
+					// first come first served, shortest
+					// seek first, elevator
 /*
 // 23-0502[j]: class Disk (繼承於 CallBackObj 自然繼承 CallBack() 方法 )
 	-	主要功能：
@@ -75,9 +99,12 @@ const int NumSectors = (SectorsPerTrack * NumTracks);
 */
 class Disk : public CallBackObj {
   public:
-    Disk(CallBackObj *toCall);          // Create a simulated disk.  
+    Disk(CallBackObj *toCall, char *traceName = NULL);
+					// Create a simulated disk.  
 					// Invoke toCall->CallBack() 
 					// when each request completes.
+					// If "traceName" is given, record
+					// every request there.
     ~Disk();				// Deallocate the disk.
     
     void ReadRequest(int sectorNumber, char* data);
@@ -106,6 +133,14 @@ class Disk : public CallBackObj {
     int bufferInit;			// When the track buffer started 
 					// being loaded
 
+    int traceFile;			// UNIX file number for the trace, -1 if none
+    DiskTraceRecord *trace;		// Records not yet written to traceFile
+    int numTraced;			// # of records in "trace"
+
+    void Trace(int sectorNumber, bool writing, int latency);
+					// Record a request in the trace
+    void FlushTrace();			// Write the buffered records out
+
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
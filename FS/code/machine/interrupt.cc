@@ -19,6 +19,20 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "main.h"
+#include "sysdep.h"
+#include "profile.h"
+#include "tracer.h"
+
+// "nextDue" when no interrupt is pending
+const int NeverDue = 0x7fffffff;
+
+// initial size of the pending interrupt heap; it grows as needed
+const int InitialPending = 32;
+
+// how long, in milliseconds of host time, an idle machine waits for
+// input that a timeout is pending on, before it lets the clock run on
+// to the timeout
+const int TimeoutHostWait = 10;
 
 // String definitions for debugging messages
 
@@ -43,11 +57,18 @@ PendingInterrupt::PendingInterrupt(CallBackObj *callOnInt,
     callOnInterrupt = callOnInt;
     when = time;
     type = kind;
+    order = 0;
+    poll = FALSE;
+    pollFile = -1;
+    timeout = FALSE;
+    nextFree = NULL;
 }
 
 //----------------------------------------------------------------------
 // PendingCompare
 //	Compare to interrupts based on which should occur first.
+//	Interrupts due at the same time go in the order they were
+//	scheduled.
 //----------------------------------------------------------------------
 
 static int
@@ -55,6 +76,8 @@ PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
 {
     if (x->when < y->when) { return -1; }
     else if (x->when > y->when) { return 1; }
+    else if (x->order < y->order) { return -1; }
+    else if (x->order > y->order) { return 1; }
     else { return 0; }
 }
 
@@ -68,10 +91,19 @@ PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new SortedList<PendingInterrupt *>(PendingCompare);
+    pending = NULL;
+    numPending = pendingSize = 0;
+    numScheduled = 0;
+    freeList = NULL;
+    GrowPending();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    nextDue = NeverDue;
+    sliceEnd = NeverDue;
+    traceInts = debug->IsEnabled(dbgInt);
+    idleWait = FALSE;
+    inputOverdue = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -81,10 +113,17 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-	    delete pending->RemoveFront();
+    PendingInterrupt *p;
+
+    for (int i = 0; i < numPending; i++) {
+	    delete pending[i];
+    }
+    delete [] pending;
+    while (freeList != NULL) {
+        p = freeList;
+        freeList = p->nextFree;
+        delete p;
     }
-    delete pending;
 }
 
 //----------------------------------------------------------------------
@@ -143,6 +182,19 @@ Interrupt::SetLevel(IntStatus now)
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	"numTicks" -- how many ticks to advance; more than one when the
+//		machine has executed a whole block of user instructions
+//		since the last call.  Pending interrupts are still only
+//		checked once, at the end.
+//
+//	Most calls find nothing to do: we keep the time the next
+//	interrupt is due ("nextDue"), and until then just count ticks,
+//	without going through the interrupt-disable/CheckIfDue path.
+//	Interrupts still fire at exactly the same tick.
+//
+//	On a machine with several CPUs, this is also where the Scheduler
+//	switches to another CPU, once the current one's slice is over.
 //----------------------------------------------------------------------
 /*
 // 23-0302[j]:  void OneTick();
@@ -166,7 +218,7 @@ Interrupt::SetLevel(IntStatus now)
                         (在 Machine::Run() 中呼叫)
 */
 void
-Interrupt::OneTick()
+Interrupt::OneTick(int numTicks)
 {
     MachineStatus oldStatus = status;   // 23-0101[j]: enum MachineStatus 分為 IdleMode, SystemMode, UserMode
     Statistics *stats = kernel->stats;
@@ -176,12 +228,14 @@ Interrupt::OneTick()
 // 23-0101[j]: (1) stats->totalTicks 開始運作 NachOS 到現在的 Tick數
 // 23-0101[j]: (2) stats->SystemTick/UserTick 開始運作 SystemMode/UserMode 到現在的 Tick數
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-	    stats->systemTicks += SystemTick;
+        stats->totalTicks += SystemTick * numTicks;
+	    stats->systemTicks += SystemTick * numTicks;
     } else {
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += UserTick * numTicks;
+	stats->userTicks += UserTick * numTicks;
     }
+    if (stats->totalTicks < nextDue && !yieldOnReturn && !traceInts)
+        return;				// nothing can be due yet
     DEBUG(dbgInt, "== Tick " << stats->totalTicks << " ==");
 
 // check any pending interrupts are now ready to fire
@@ -203,6 +257,18 @@ Interrupt::OneTick()
         kernel->currentThread->Yield();
         status = oldStatus;
     }
+
+    if (stats->totalTicks >= sliceEnd) {	// let the other CPUs catch up
+        bool sliced;
+
+        status = SystemMode;
+        ChangeLevel(IntOn, IntOff);	// as for CheckIfDue, switch CPUs
+        sliced = kernel->scheduler->NextCPU();	// without a tick
+        ChangeLevel(IntOff, IntOn);
+        if (sliced)			// we were time sliced while
+            kernel->currentThread->Yield();	// switched out
+        status = oldStatus;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -231,8 +297,9 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
-//	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	If there are no pending interrupts, or only the timer's, stop.
+//	There's nothing more for us to do: the timer keeps going off,
+//	but with no thread to run it cannot make one ready.
 //----------------------------------------------------------------------
 /*
 // 23-0302[j]:  Interrupt::Idle()
@@ -248,8 +315,9 @@ Interrupt::Idle()
 {
     DEBUG(dbgInt, "Machine idling; checking for interrupts.");
     status = IdleMode;
+    WaitForInput();
 	DEBUG(dbgTraCode, "In Interrupt::Idle, into CheckIfDue, " << kernel->stats->totalTicks);
-    if (CheckIfDue(TRUE)) {	// check for any pending interrupts
+    if (!OnlyTimerPending() && CheckIfDue(TRUE)) {	// check for any pending interrupts
         DEBUG(dbgTraCode, "In Interrupt::Idle, return true from CheckIfDue, " << kernel->stats->totalTicks);
         status = SystemMode;
         return;			// return in case there's now
@@ -268,6 +336,72 @@ Interrupt::Idle()
     Halt();
 }
 
+//----------------------------------------------------------------------
+// Interrupt::OnlyTimerPending
+// 	Return TRUE if no interrupt but the timer's is pending, or none
+//	at all.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::OnlyTimerPending()
+{
+    for (int i = 0; i < numPending; i++) {
+        if (pending[i]->type != TimerInt)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::WaitForInput
+// 	The machine is idle.  If every pending interrupt is a poll (see
+//	SchedulePoll), nothing can happen until input arrives on one of
+//	their host files, so rather than firing the polls over and over,
+//	spinning the host CPU, block the host process until there is
+//	some ("-iw").  The clock then advances to the next poll as
+//	usual, and it finds the input.
+//
+//	If there are also timeouts (see ScheduleTimeout), always wait,
+//	but only for up to TimeoutHostWait: firing the polls would run
+//	the clock up to the timeout before a reply from another Nachos
+//	could get through the host, so every wait would seem to time
+//	out.  If nothing comes, the input is overdue; carry on as
+//	before, until a timeout is scheduled again or goes off.
+//
+//	Polls of no file (the timer) alone cannot wake us up; then we
+//	carry on as before.
+//----------------------------------------------------------------------
+
+void
+Interrupt::WaitForInput()
+{
+    int *files;
+    int numFiles = 0;
+    bool timed = FALSE;		// is a timeout pending?
+
+    for (int i = 0; i < numPending; i++) {
+        if (pending[i]->timeout)
+            timed = TRUE;
+        else if (!pending[i]->poll)
+            return;
+        else if (pending[i]->pollFile >= 0)
+            numFiles++;
+    }
+    if (numFiles == 0 || (timed ? inputOverdue : !idleWait))
+        return;
+
+    files = new int[numFiles];
+    numFiles = 0;
+    for (int i = 0; i < numPending; i++) {
+        if (pending[i]->pollFile >= 0)
+            files[numFiles++] = pending[i]->pollFile;
+    }
+    DEBUG(dbgInt, "Machine idle; waiting in the host for input.");
+    if (!WaitForFiles(files, numFiles, timed ? TimeoutHostWait : -1))
+        inputOverdue = TRUE;
+    delete [] files;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
@@ -278,7 +412,12 @@ Interrupt::Halt()
 {
     cout << "Machine halting!\n\n";
     cout << "This is halt\n";
+    kernel->scheduler->StopCPUs();
     kernel->stats->Print();
+    if (kernel->machine->profiler != NULL)
+        kernel->machine->profiler->Report();
+    if (kernel->tracer != NULL)
+        kernel->tracer->Dump();
     delete kernel;	// Never returns. // 23-0419[j]: Delete kernel 物件 -> Thread 停止運作
 }
 
@@ -327,7 +466,10 @@ Interrupt::CloseFile(OpenFileId id)
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it on a binary heap ordered by "when", so
+//	scheduling and firing take O(log n) however many interrupts
+//	are pending.  Nodes that have fired are kept on a free list
+//	and re-used, rather than going back to the allocator.
 //
 //	**NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.**
@@ -348,15 +490,77 @@ Interrupt::CloseFile(OpenFileId id)
 
 void
 Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
+{
+    AddPending(toCall, fromNow, type, FALSE, -1, FALSE);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SchedulePoll
+// 	Like Schedule, for an interrupt whose handler only checks
+//	whether input has arrived from outside Nachos -- on host file
+//	"pollFile", or on none at all if it is -1 -- and schedules
+//	the next such check if not.  While the machine is idle with
+//	nothing else pending, such interrupts can only change anything
+//	once there is input, so Idle may wait for it in the host.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SchedulePoll(CallBackObj *toCall, int fromNow, IntType type,
+                        int pollFile)
+{
+    AddPending(toCall, fromNow, type, TRUE, pollFile, FALSE);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::ScheduleTimeout
+// 	Like Schedule, for a timer that only stops a wait for input from
+//	another Nachos -- a reply, an acknowledgement -- from going on
+//	for ever.  Until it goes off, an idle machine waits in the host
+//	for the input (see WaitForInput), instead of running the clock
+//	up to it.
+//----------------------------------------------------------------------
+
+void
+Interrupt::ScheduleTimeout(CallBackObj *toCall, int fromNow, IntType type)
+{
+    AddPending(toCall, fromNow, type, FALSE, -1, TRUE);
+    inputOverdue = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::AddPending
+// 	Put a new interrupt on the pending heap; the work of Schedule,
+//	SchedulePoll and ScheduleTimeout.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AddPending(CallBackObj *toCall, int fromNow, IntType type,
+                      bool poll, int pollFile, bool timeout)
 {
     int when = kernel->stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(toCall, when, type);
+    PendingInterrupt *toOccur;
 
     DEBUG(dbgInt, "Scheduling interrupt handler the " << intTypeNames[type] << " at time = " << when);
     ASSERT(fromNow > 0);
 
-    // 22-1231[j]: pending 是個 Sorted List，依序存放「待執行中斷 類別」
-    pending->Insert(toOccur); 
+    if (freeList != NULL) {
+        toOccur = freeList;
+        freeList = toOccur->nextFree;
+        toOccur->callOnInterrupt = toCall;
+        toOccur->when = when;
+        toOccur->type = type;
+    } else {
+        toOccur = new PendingInterrupt(toCall, when, type);
+    }
+    toOccur->order = numScheduled++;
+    toOccur->poll = poll;
+    toOccur->pollFile = pollFile;
+    toOccur->timeout = timeout;
+
+    // 22-1231[j]: pending 是個 heap，pending[0] 為最早發生的「待執行中斷」
+    InsertPending(toOccur);
+    if (when < nextDue)
+        nextDue = when;
 }
 
 //----------------------------------------------------------------------
@@ -394,12 +598,12 @@ Interrupt::CheckIfDue(bool advanceClock)
         DumpState();
     }
     
-    // 23-0101[j]: 注意!! pending = Sorted List
-    if (pending->IsEmpty()) {   	// no pending interrupts
+    // 23-0101[j]: 注意!! pending = heap
+    if (numPending == 0) {   	// no pending interrupts
         return FALSE;	
     }	
 
-    next = pending->Front();
+    next = pending[0];
 
     // 23-0301[j]: 若下個待執行中斷「應發生的時間」還沒到
     //             則依據 advanceClock 參數 決定要不要「快轉」模擬時間 到「應發生時間」
@@ -428,22 +632,137 @@ Interrupt::CheckIfDue(bool advanceClock)
     
     do {
         // 23-0101[j]: Pop 最優先的「待執行中斷」
-        next = pending->RemoveFront();    // pull interrupt off list 
+        next = RemovePending();    // pull interrupt off list 
 		
         DEBUG(dbgTraCode, "In Interrupt::CheckIfDue, into callOnInterrupt->CallBack, " << stats->totalTicks);
          
         // 23-0103[j]: 執行「最優先」的「待執行中斷 的 ISR(中斷服務程式)」
         // 23-0103[j]: = 呼叫 *callOnInterrupt物件中的方法 = callOnInterrupt->CallBack()
+        TRACE(TraceInterrupt, next->type, 0);
+        if (next->timeout)
+            inputOverdue = FALSE;	// wait for the next input again
         next->callOnInterrupt->CallBack();// call the interrupt handler 
 		
         DEBUG(dbgTraCode, "In Interrupt::CheckIfDue, return from callOnInterrupt->CallBack, " << stats->totalTicks);
-	    delete next;
-    } while ( !pending->IsEmpty() && (pending->Front()->when <= stats->totalTicks) );
+        next->nextFree = freeList;	// keep the node for re-use
+        freeList = next;
+    } while ( numPending > 0 && (pending[0]->when <= stats->totalTicks) );
     
     inHandler = FALSE;
+    UpdateNextDue();
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::UpdateNextDue
+// 	Recompute when the first pending interrupt is due, after some
+//	have been taken off the list.
+//----------------------------------------------------------------------
+
+void
+Interrupt::UpdateNextDue()
+{
+    if (numPending == 0)
+        nextDue = NeverDue;
+    else
+        nextDue = pending[0]->when;
+    if (sliceEnd < nextDue)
+        nextDue = sliceEnd;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SetSliceEnd
+// 	On a machine with several CPUs, arrange for OneTick to let the
+//	Scheduler switch to another CPU once simulated time reaches
+//	"when".
+//----------------------------------------------------------------------
+
+void
+Interrupt::SetSliceEnd(int when)
+{
+    sliceEnd = when;
+    UpdateNextDue();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::InsertPending
+// 	Add an interrupt to the heap: put it at the bottom, and move it
+//	up past any interrupt due after it.
+//----------------------------------------------------------------------
+
+void
+Interrupt::InsertPending(PendingInterrupt *toOccur)
+{
+    int i, parent;
+
+    if (numPending == pendingSize)
+        GrowPending();
+    for (i = numPending++; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (PendingCompare(pending[parent], toOccur) <= 0)
+            break;
+        pending[i] = pending[parent];
+    }
+    pending[i] = toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RemovePending
+// 	Take the first interrupt off the heap, and return it.  The last
+//	interrupt fills the hole, moving down past any interrupt due
+//	before it.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::RemovePending()
+{
+    PendingInterrupt *first, *last;
+    int i, child;
+
+    ASSERT(numPending > 0);
+    first = pending[0];
+    last = pending[--numPending];
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {
+        if (child + 1 < numPending
+                && PendingCompare(pending[child + 1], pending[child]) < 0)
+            child++;
+        if (PendingCompare(last, pending[child]) <= 0)
+            break;
+        pending[i] = pending[child];
+    }
+    pending[i] = last;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::GrowPending
+// 	Double the room for pending interrupts.
+//----------------------------------------------------------------------
+
+void
+Interrupt::GrowPending()
+{
+    int newSize = (pendingSize == 0) ? InitialPending : pendingSize * 2;
+    PendingInterrupt **newPending = new PendingInterrupt*[newSize];
+
+    for (int i = 0; i < numPending; i++)
+        newPending[i] = pending[i];
+    delete [] pending;
+    pending = newPending;
+    pendingSize = newSize;
+}
+
+//----------------------------------------------------------------------
+// PendingSortCompare
+//	PendingCompare, in the form qsort wants.
+//----------------------------------------------------------------------
+
+static int
+PendingSortCompare(const void *x, const void *y)
+{
+    return PendingCompare(*(PendingInterrupt **) x, *(PendingInterrupt **) y);
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
@@ -469,8 +788,98 @@ Interrupt::DumpState()
     cout << "Time: " << kernel->stats->totalTicks;
     cout << ", interrupts " << intLevelNames[level] << "\n";
     cout << "Pending interrupts:\n";
-    pending->Apply(PrintPending);
+
+    // the heap is only partly sorted; print a sorted copy
+    PendingInterrupt **sorted = new PendingInterrupt*[numPending];
+    for (int i = 0; i < numPending; i++)
+        sorted[i] = pending[i];
+    qsort(sorted, numPending, sizeof(PendingInterrupt *), PendingSortCompare);
+    for (int i = 0; i < numPending; i++)
+        PrintPending(sorted[i]);
+    delete [] sorted;
+
     cout << "\nEnd of pending interrupts\n";
 }
 
+// The following class is the device Interrupt::Benchmark drives:
+// each interrupt it gets schedules another one, until "toSchedule"
+// runs out, so the number pending stays the same.
+
+const int BenchmarkSpread = 10000;	// interrupts are due 1..this
+					// many ticks in the future
+const int BenchmarkDepth = 1000;	// # pending during the second run
+
+class BenchmarkDevice : public CallBackObj {
+  public:
+    BenchmarkDevice(Interrupt *ints) { interrupt = ints; toSchedule = 0; }
+    void CallBack();
+
+    Interrupt *interrupt;	// where to schedule the next interrupt
+    int toSchedule;		// # still to schedule from CallBack
+};
+
+void
+BenchmarkDevice::CallBack()
+{
+    if (toSchedule > 0) {
+        toSchedule--;
+        interrupt->Schedule(this, 1 + RandomNumber() % BenchmarkSpread,
+                            TimerInt);
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Benchmark
+// 	Time the pending interrupt queue, on a private Interrupt so the
+//	kernel's own interrupts are left alone.  Two runs, of
+//	"numEvents" interrupts each, due at random times:
+//
+//	  all scheduled up front, then fired -- the queue gets as long
+//		as it can;
+//	  "BenchmarkDepth" pending, each one scheduling the next when
+//		it fires -- a steady state, like a busy system.
+//
+//	Simulated time is rolled forward to fire the interrupts, and
+//	put back afterwards.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Benchmark(int numEvents)
+{
+    Statistics *stats = kernel->stats;
+    int totalTicks = stats->totalTicks;
+    int idleTicks = stats->idleTicks;
+    Interrupt *ints = new Interrupt;
+    BenchmarkDevice *device = new BenchmarkDevice(ints);
+    int depth = (numEvents < BenchmarkDepth) ? numEvents : BenchmarkDepth;
+    double start, all, steady;
+
+    ASSERT(numEvents > 0);
+    start = HostSeconds();
+    for (int i = 0; i < numEvents; i++)
+        ints->Schedule(device, 1 + RandomNumber() % BenchmarkSpread, TimerInt);
+    while (ints->CheckIfDue(TRUE))
+        ;
+    all = HostSeconds() - start;
+
+    start = HostSeconds();
+    device->toSchedule = numEvents - depth;
+    for (int i = 0; i < depth; i++)
+        ints->Schedule(device, 1 + RandomNumber() % BenchmarkSpread, TimerInt);
+    while (ints->CheckIfDue(TRUE))
+        ;
+    steady = HostSeconds() - start;
+
+    stats->totalTicks = totalTicks;
+    stats->idleTicks = idleTicks;
+    delete device;
+    delete ints;
+
+    cout << "Interrupt benchmark: " << numEvents << " interrupts per run\n";
+    cout << "All pending: " << all << " seconds, "
+         << all * 1e9 / numEvents << " ns per interrupt\n";
+    cout << depth << " pending: " << steady << " seconds, "
+         << steady * 1e9 / numEvents << " ns per interrupt\n";
+}
+
 
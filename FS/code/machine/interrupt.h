@@ -86,6 +86,17 @@ class PendingInterrupt {
 
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int order;			// Breaks ties in "when": interrupts
+				// scheduled for the same time fire in
+				// the order they were scheduled
+    bool poll;			// Does it only check for input from
+				// outside Nachos?
+    int pollFile;		// If so, the host file it checks, or
+				// -1 for none
+    bool timeout;		// Does it only limit how long to wait
+				// for input (see ScheduleTimeout)?
+    PendingInterrupt *nextFree;	// Next node on the free list, once
+				// this one has fired
 };
 
 // The following class defines the data structures for the simulation
@@ -109,6 +120,9 @@ class Interrupt {
     void Idle(); 		// The ready queue is empty, roll 
 				// simulated time forward until the 
 				// next interrupt
+    void SetIdleWait(bool wait) { idleWait = wait; }
+				// Should Idle wait in the host when
+				// only polls are pending?
 
     void Halt(); 		// quit and print out stats 
 
@@ -136,21 +150,43 @@ class Interrupt {
     // but they need to be public since they are called by the
     // hardware device simulators.
 
-    // 23-0419[j]: 安排 未來要發生的中斷(順序存在 SortedList* pending)
+    // 23-0419[j]: 安排 未來要發生的中斷(順序存在 pending heap)
     void Schedule(CallBackObj *callTo, int when, IntType type);
     				// Schedule an interrupt to occur
 				// at time "when".  This is called
     				// by the hardware device simulators.
+    void SchedulePoll(CallBackObj *callTo, int when, IntType type,
+		      int pollFile);
+				// Schedule an interrupt that only checks
+				// whether host file "pollFile" (-1 for
+				// none) has input
+    void ScheduleTimeout(CallBackObj *callTo, int when, IntType type);
+				// Schedule an interrupt that gives up
+				// on input that has not arrived
     
     // 23-0127[j]: 模擬 時間快轉 10個 or 1個 Tick
-    void OneTick();       	// Advance simulated time
+    void OneTick(int numTicks = 1);	// Advance simulated time
+					// ("numTicks" instructions' worth)
+
+    int NextDue() { return nextDue; }	// When the next pending interrupt
+					// is due, or the CPU's slice ends;
+					// nothing can happen before then
+    void SetSliceEnd(int when);		// Switch to another CPU at "when"
+
+    static void Benchmark(int numEvents);
+    				// Time scheduling and firing "numEvents"
+				// interrupts, and print the results
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
 
-    // 22-1231[j]: pending 是個 Sorted List，依序存放「待執行中斷」物件的位址
-    SortedList<PendingInterrupt *> *pending;		
-    				// the list of interrupts scheduled to occur in the future
+    PendingInterrupt **pending;	// the interrupts scheduled to occur in
+				// the future, kept as a binary heap:
+				// pending[0] is the next one due
+    int numPending;		// # of interrupts in "pending"
+    int pendingSize;		// # of entries allocated for "pending"
+    int numScheduled;		// for "order" of the next interrupt
+    PendingInterrupt *freeList;	// nodes for re-use by Schedule
 
     //int writeFileNo;            //UNIX file emulating the display
     bool inHandler;		// TRUE if we are running an interrupt handler
@@ -158,9 +194,35 @@ class Interrupt {
                                   // If so, you cannoot do another one
     bool yieldOnReturn; 	// TRUE if we are to context switch on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    int nextDue;		// "when" of the first pending interrupt,
+				// or sliceEnd if earlier; NeverDue if
+				// there is neither
+    int sliceEnd;		// when the current CPU's time slice ends,
+				// NeverDue with only one CPU
+    bool traceInts;		// is interrupt debugging enabled?
+    bool idleWait;		// wait in the host, rather than poll,
+				// when idle?
+    bool inputOverdue;		// did waiting in the host for input,
+				// with a timeout pending, run out?
 
     // these functions are internal to the interrupt simulation code
 
+    void UpdateNextDue();	// Recompute nextDue from the pending list
+
+    void InsertPending(PendingInterrupt *toOccur);
+    				// Add an interrupt to the heap
+    PendingInterrupt *RemovePending();
+    				// Take the first interrupt off the heap
+    void GrowPending();		// Double the size of the heap
+    void AddPending(CallBackObj *callTo, int when, IntType type,
+		    bool poll, int pollFile, bool timeout);
+				// Schedule, SchedulePoll or ScheduleTimeout
+    bool OnlyTimerPending();	// Is the timer all that is left to
+				// happen?
+    void WaitForInput();	// If only polls (and timeouts) are
+				// pending, wait in the host for one of
+				// their files
+
     bool CheckIfDue(bool advanceClock); 
     				// Check if any interrupts are supposed
 				// to occur now, and if so, do them
@@ -9,7 +9,10 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "cache.h"
 #include "main.h"
+#include "tracer.h"
+#include "profile.h"
 
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
@@ -18,6 +21,38 @@ static char* exceptionNames[] = { "no exception", "syscall",
 				"bus error", "address error", "overflow",
 				"illegal instruction" };
 
+// The size of physical memory; see machine.h.
+int PageSize = DefaultPageSize;
+int NumPhysPages = DefaultNumPhysPages;
+int MemorySize = DefaultNumPhysPages * DefaultPageSize;
+
+//----------------------------------------------------------------------
+// SetMemoryGeometry
+// 	Choose the size of physical memory and of a page, before the
+//	Machine is created.  Return FALSE, changing nothing, if the
+//	sizes don't make sense: the page size must be a power of 2
+//	between MinPageSize and MaxPageSize, and memory a whole number
+//	of pages, at most MaxMemorySize.
+//
+//	"memorySize" -- bytes of physical memory
+//	"pageSize" -- bytes per page
+//----------------------------------------------------------------------
+
+bool
+SetMemoryGeometry(int memorySize, int pageSize)
+{
+    if (pageSize < MinPageSize || pageSize > MaxPageSize ||
+        (pageSize & (pageSize - 1)) != 0)
+        return FALSE;
+    if (memorySize < pageSize || memorySize > MaxMemorySize ||
+        memorySize % pageSize != 0)
+        return FALSE;
+    PageSize = pageSize;
+    NumPhysPages = memorySize / pageSize;
+    MemorySize = memorySize;
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // CheckEndian
 // 	Check to be sure that the host really uses the format it says it
@@ -52,7 +87,7 @@ void CheckEndian()
 //		is executed.
 //----------------------------------------------------------------------
 // 23-0419[j]: 初始化模擬機器
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks, int tlbEntries, int tlbAssoc)
 {
     int i;
 
@@ -61,17 +96,45 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    if (tlbEntries > 0) {
+        tlbSize = tlbEntries;
+        tlbWays = (tlbAssoc > 0) ? tlbAssoc : tlbEntries;
+        ASSERT(tlbSize % tlbWays == 0);
+        tlb = new TranslationEntry[tlbSize];
+        for (i = 0; i < tlbSize; i++)
+	    tlb[i].valid = FALSE;
+    } else {	// use linear page table
+        tlb = NULL;
+        tlbSize = tlbWays = 0;
+    }
     pageTable = NULL;
-#endif
+
+    // mainMemory is all zero, and so is every cached instruction
+    decodeCache = new Instruction[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+        decodeCache[i].value = 0;
+        decodeCache[i].Decode();
+    }
+    fetchEntry = NULL;
+    fetchTable = NULL;
+    fetchPage = fetchFrame = 0;
+    FlushSoftTLB();
+    useBlocks = blocks;
+    profiler = NULL;
+    icache = dcache = NULL;
+    icacheStats = dcacheStats = NULL;
+    cacheTicks = 0;
+    blockDone = 0;
+    InitBlocks();
+    useCosts = FALSE;		// every instruction takes UserTick
+    for (i = 0; i < NumInstrClasses; i++)
+        cost[i] = 1;
+    loadUseCost = 0;
+    slotLoadReg = 0;
 
     singleStep = debug;
+    traceInstrs = ::debug->IsEnabled(dbgMach);
+    traceRun = ::debug->IsEnabled(dbgTraCode);
     CheckEndian();
 }
 
@@ -83,6 +146,14 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decodeCache;
+    FreeBlocks();
+    if (profiler != NULL)
+        delete profiler;
+    if (icache != NULL)
+        delete icache;
+    if (dcache != NULL)
+        delete dcache;
     if (tlb != NULL)
         delete [] tlb;
 }
@@ -103,7 +174,16 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    if (blockDone > 0) {		// the instructions of the current block
+        int done = blockDone;		// that came before this one have run,
+					// so let their time pass first
+        blockDone = 0;
+        kernel->interrupt->OneTick(done);
+    }
+
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
+    TRACE(TraceException, which,
+          which == SyscallException ? registers[2] : badVAddr);
     
     registers[BadVAddrReg] = badVAddr;
     
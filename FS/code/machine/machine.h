@@ -24,22 +24,44 @@
 #include "copyright.h"
 #include "utility.h"
 #include "translate.h"
+#include "stats.h"
 
 // Definitions related to the size, and format of user memory
 
-const int PageSize = 128; 		// set the page size equal to
-								// the disk sector size, for simplicity
-								// 23-0131[j]: 128 Bytes
+// The page size and the amount of physical memory used to be constants;
+// they are now chosen when Nachos starts ("-pgsz", "-mem"; see
+// Kernel::Kernel), before the Machine is created, and do not change
+// afterwards.  The defaults give the original 128 pages of 128 bytes.
 
-//
-// You are allowed to change this value.
-// Doing so will change the number of pages of physical memory
-// available on the simulated machine.
-//
-const int NumPhysPages = 128;
+const int DefaultPageSize = 128;	// 23-0131[j]: 128 Bytes
+const int DefaultNumPhysPages = 128;
+const int MinPageSize = 16;		// limits on "-pgsz"
+const int MaxPageSize = 65536;
+const int MaxMemorySize = 64 * 1024 * 1024;	// limit on "-mem"
+
+extern int PageSize;			// bytes per page; a power of 2
+extern int NumPhysPages;		// # of page frames
+extern int MemorySize;			// NumPhysPages * PageSize
 
-const int MemorySize = (NumPhysPages * PageSize);
+extern bool SetMemoryGeometry(int memorySize, int pageSize);
+					// Check and set the three above
 const int TLBSize = 4;			// if there is a TLB, make it small
+					// (the default size; see "-tlb")
+const int SoftTLBSize = 64;		// # of pages ReadMem/WriteMem cache
+					// the translation of; a power of 2
+
+// The following class is one entry of the simulator's own cache of
+// translations ("soft TLB", see Machine::HostAddress).  It has
+// nothing to do with the MIPS TLB above: the user program and the
+// kernel never see it.
+
+class SoftTLBEntry {
+  public:
+    int virtualPage;		// The page cached, -1 if none
+    char *host;			// Where that page is in mainMemory
+    bool writable;		// Can stores use "host" directly?  Only
+				// once a store has set the dirty bit.
+};
 
 // 23-0419[j]: 此處定義 Exception 的類型，
 //             其中包含了 SyscallException = 呼叫 System Call 
@@ -94,13 +116,48 @@ enum ExceptionType { NoException,           // Everything ok!
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
 class Interrupt;
+class TranslatedBlock;
+class Profiler;
+class Cache;
+
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+
+// 22-1223[j]: 指令 (32) = Operator (opCode(6)) + Operand (運算元 = rs(5), rt(5), rd(5) 三個) + Extra(11)
+// 22-1223[j]: MIPS ISA 的指令 有3種型態: I、J、R 分別對應不同 Operand 個數
+// 22-1223[j]: Format R = opCode(6) - rs(5) - rt(5) - rd(5) - shamt(5) - funct(6)
+// 22-1223[j]: Format I = opCode(6) - rs(5) - rt(5) - immediate (16)
+// 22-1223[j]: Format J = opCode(6) - address(26)
+
+class Instruction {
+  public:
+    void Decode();	// decode the binary representation of the instruction
+
+    unsigned int value; // binary representation of the instruction
+
+    char opCode;     // Type of instruction.  This is NOT the same as the
+    		     // opcode field from the instruction: see defs in mips.h
+    char rs, rt, rd; // Three registers from instruction. 
+    int extra;       // Immediate or target or shamt field or offset.
+                     // Immediates are sign-extended.
+};
+
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, bool blocks = FALSE, int tlbEntries = 0,
+            int tlbAssoc = 0);
+				// Initialize the simulation of the hardware
+				// for running user programs; "blocks" runs
+				// user code a basic block at a time.  With
+				// "tlbEntries" > 0, translate through a TLB
+				// of that many entries, in sets of
+				// "tlbAssoc" (0: fully associative)
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -148,6 +205,11 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 								// "read-only" to Nachos kernel code
+    int tlbSize;			// # of entries in "tlb"
+    int tlbWays;			// # of entries in each set of "tlb"
+    int TLBSet(unsigned int vpn) { return (vpn % (tlbSize / tlbWays)) * tlbWays; }
+					// First entry of the set that can
+					// hold virtual page "vpn"
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
@@ -157,6 +219,23 @@ class Machine {
     			// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+
+    Profiler *profiler;		// If not NULL, told about every user
+				// instruction executed
+
+    Cache *icache;		// Instruction and data caches, NULL if
+    Cache *dcache;		// the machine has none
+    CacheStats *icacheStats;	// Where to count the running program's
+    CacheStats *dcacheStats;	// cache accesses, NULL if nowhere;
+				// set by the kernel, like pageTable
+
+    void FlushSoftTLB();	// Forget the cached translations; call
+				// whenever the page table is switched or
+				// its entries are changed
+
+    bool SetCosts(char *spec);	// Charge user instructions by class,
+				// as "mult=12,div=35,loaduse=1,...";
+				// FALSE if "spec" is malformed
   private:
 
 // Routines internal to the machine simulation -- DO NOT call these directly
@@ -164,10 +243,39 @@ class Machine {
 				// Do a pending delayed load (modifying a reg)
 
 // 23-0419[j]: 模擬 CPU 執行一道指令
-    void OneInstruction(Instruction *instr); 	
+    int OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+				// Return the time it took, in UserTicks
+    int InstructionCost(Instruction *instr, int pc, int loadReg);
+				// Time taken by "instr", just executed
+				// at "pc", under the cost model
+
+    bool FetchInstruction(int pc, Instruction *instr);
+				// Fetch and decode the instruction at "pc",
+				// using the decode cache.  FALSE if an
+				// exception was raised.
+    bool FetchAddress(int pc, int *physAddr);
+				// Translate an instruction address
+    Instruction *DecodeAt(int physAddr);
+				// Decoded instruction at "physAddr"
+    bool ExecuteInstruction(Instruction *instr);
+				// Execute a decoded instruction.  FALSE
+				// if an exception was raised.
+
+    int RunBlock();		// Run the basic block at the PC; return
+				// the number of instructions executed
+				// whose time is not yet accounted for
+    TranslatedBlock *TranslateBlock(int physAddr);
+				// (Re)build the block starting at "physAddr"
+    void InitBlocks();		// Set up/free the block cache
+    void FreeBlocks();
     
 
+    char *HostAddress(int addr, int size, bool writing);
+				// Where virtual address "addr" is in
+				// mainMemory, via the soft TLB; NULL if
+				// an exception was raised
+
 // 23-0127[j]: 翻譯 virtAddr -> physAddr 的函數，在translate.cc那邊實作
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
@@ -193,6 +301,40 @@ class Machine {
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
+    bool traceInstrs;		// print each instruction ('m' debugging)?
+    bool traceRun;		// trace Run's steps (dbgTraCode)?  Both
+				// are looked up once, as they would
+				// otherwise be for every instruction
+
+    Instruction *decodeCache;	// Decoded form of every word of mainMemory
+    TranslationEntry *fetchEntry; // Page table entry used by the last
+				// instruction fetch, NULL if none
+    TranslationEntry *fetchTable; // Page table "fetchEntry" belongs to
+    unsigned int fetchPage;	// Virtual page of "fetchEntry"
+    int fetchFrame;		// Physical page it mapped to
+
+    SoftTLBEntry softTLB[SoftTLBSize];
+				// Recent data translations, indexed by
+				// virtual page # mod SoftTLBSize
+    TranslationEntry *softTLBTable; // Page table they came from
+
+    bool useBlocks;		// Run a basic block at a time?
+    TranslatedBlock **blocks;	// Translated block starting at each word
+				// of mainMemory, NULL if none yet
+    int blockDone;		// Instructions of the current block that
+				// ran before the one now executing
+
+    int cacheTicks;		// Time the current instruction waited
+				// for the caches to go to memory
+
+    bool useCosts;		// Charge instructions by class?
+    int cost[NumInstrClasses];	// UserTicks for each class of instruction
+    int loadUseCost;		// Extra UserTicks when an instruction uses
+				// a register loaded just before its
+				// predecessor (i.e., right after the
+				// load delay slot)
+    int slotLoadReg;		// Register whose load delay slot was
+				// the last instruction, 0 if none
 
     friend class Interrupt;		// calls DelayedLoad()    
 };
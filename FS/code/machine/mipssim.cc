@@ -16,36 +16,12 @@
 #include "debug.h"
 #include "machine.h"
 #include "mipssim.h"
+#include "profile.h"
+#include "cache.h"
 #include "main.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
-
-// 22-1223[j]: 指令 (32) = Operator (opCode(6)) + Operand (運算元 = rs(5), rt(5), rd(5) 三個) + Extra(11)
-// 22-1223[j]: MIPS ISA 的指令 有3種型態: I、J、R 分別對應不同 Operand 個數
-// 22-1223[j]: Format R = opCode(6) - rs(5) - rt(5) - rd(5) - shamt(5) - funct(6)
-// 22-1223[j]: Format I = opCode(6) - rs(5) - rt(5) - immediate (16)
-// 22-1223[j]: Format J = opCode(6) - address(26)
-
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
-
-    unsigned int value; // binary representation of the instruction
-
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction. 
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
-};
-
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
@@ -74,24 +50,712 @@ Machine::Run()
     // 22-1223[j]: 設定為 UserMode (需要中斷時 才切 KernelMode)
     kernel->interrupt->setStatus(UserMode); 
     
+    // The block engine has no way to stop after every instruction, so
+    // single-stepping, instruction tracing and profiling use the
+    // interpreter.  So does a TLB: the engine only translates the
+    // first instruction of a block, and TLB statistics would be off.
+    // And so do the cost model and the caches, which charge each
+    // instruction separately.
+    if (useBlocks && !singleStep && !traceInstrs
+            && profiler == NULL && tlb == NULL && !useCosts
+            && icache == NULL && dcache == NULL) {
+        for (;;)
+            kernel->interrupt->OneTick(RunBlock());
+    }
+
     // 22-1223[j]: 無窮迴圈
     for (;;) {
-        DEBUG(dbgTraCode, "In Machine::Run(), into OneInstruction " << "== Tick " << kernel->stats->totalTicks << " ==");
+        if (!traceRun) {		// the usual case: one test, not four
+            kernel->interrupt->OneTick(OneInstruction(instr));
+        } else {
+            DEBUG(dbgTraCode, "In Machine::Run(), into OneInstruction " << "== Tick " << kernel->stats->totalTicks << " ==");
      
-        OneInstruction(instr);
+            int ticks = OneInstruction(instr);
    	
-        DEBUG(dbgTraCode, "In Machine::Run(), return from OneInstruction  " << "== Tick " << kernel->stats->totalTicks << " ==");
-   	    DEBUG(dbgTraCode, "In Machine::Run(), into OneTick " << "== Tick " << kernel->stats->totalTicks << " ==");
+            DEBUG(dbgTraCode, "In Machine::Run(), return from OneInstruction  " << "== Tick " << kernel->stats->totalTicks << " ==");
+   	        DEBUG(dbgTraCode, "In Machine::Run(), into OneTick " << "== Tick " << kernel->stats->totalTicks << " ==");
     	
-        kernel->interrupt->OneTick();	// 23-0127[j]: 模擬 時間快轉 1 Tick
+            kernel->interrupt->OneTick(ticks);	// 23-0127[j]: 模擬 時間快轉 1 Tick
     	
-        DEBUG(dbgTraCode, "In Machine::Run(), return from OneTick " << "== Tick " << kernel->stats->totalTicks << " ==");
+            DEBUG(dbgTraCode, "In Machine::Run(), return from OneTick " << "== Tick " << kernel->stats->totalTicks << " ==");
+        }
 	    if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
 	        Debugger();
    }
 }
 
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch and decode the instruction at virtual address "pc" into
+//	"instr".  Return FALSE if the fetch raised an exception.
+//
+//	This is ReadMem followed by Instruction::Decode, made cheap for
+//	the common case of running around a loop:
+//
+//	  - the page table entry of the last code page is remembered, so
+//	    while the PC stays on that page (and the entry still maps the
+//	    same frame) the fetch skips Translate;
+//
+//	  - "decodeCache" holds the decoded form of every word of physical
+//	    memory.  An entry is only used if its "value" still matches
+//	    the word in memory, so writes to code -- by the program or by
+//	    the kernel, e.g. loading a new program into a reused frame --
+//	    can never leave a stale decoding behind, and nothing needs to
+//	    be flushed when page tables change.
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(int pc, Instruction *instr)
+{
+    int physAddr;
+
+    if (!FetchAddress(pc, &physAddr))
+        return FALSE;
+    if (icache != NULL)
+        cacheTicks += icache->Access(physAddr, FALSE, icacheStats);
+    *instr = *DecodeAt(physAddr);	// the caller's copy stays valid even
+					// if another thread re-decodes the entry
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchAddress
+// 	Translate the instruction address "pc" into a physical address.
+//	Return FALSE (having raised the exception) if that fails.
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchAddress(int pc, int *physAddr)
+{
+    unsigned int vpn = (unsigned) pc / PageSize;
+
+    if (fetchEntry != NULL && vpn == fetchPage && pageTable == fetchTable
+            && vpn < pageTableSize && fetchEntry->valid
+            && fetchEntry->physicalPage == fetchFrame && !(pc & 0x3)) {
+        fetchEntry->use = TRUE;
+        *physAddr = fetchFrame * PageSize + (unsigned) pc % PageSize;
+    } else {
+        ExceptionType exception = Translate(pc, physAddr, 4, FALSE);
+
+        if (exception != NoException) {
+            RaiseException(exception, pc);
+            return FALSE;
+        }
+        if (tlb == NULL) {		// remember the page for next time
+            fetchEntry = &pageTable[vpn];
+            fetchPage = vpn;
+            fetchTable = pageTable;
+            fetchFrame = fetchEntry->physicalPage;
+        }
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodeAt
+// 	Return the decoded form of the instruction at physical address
+//	"physAddr", decoding it again if memory has changed under it.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodeAt(int physAddr)
+{
+    unsigned int raw = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+    Instruction *cached = &decodeCache[physAddr / 4];
+
+    if (cached->value != raw) {		// first time, or the code changed
+        cached->value = raw;
+        cached->Decode();
+    }
+    return cached;
+}
+
+//----------------------------------------------------------------------
+// Basic block execution
+//
+//	With "-bb", Machine::Run executes user code a basic block at a
+//	time.  A block is a run of straight-line instructions on one page,
+//	ending with the delay slot of the first jump or branch, a syscall,
+//	or the end of the page.  It is translated once into an array of
+//	(handler, decoded instruction) pairs -- "threaded code" -- where
+//	the handler is a small function for that one opcode.  Running the
+//	block then skips the fetch, the decode and the big switch in
+//	ExecuteInstruction; the less common opcodes simply use
+//	ExecuteInstruction as their handler.
+//
+//	Time is accounted for once per block.  A block never runs past the
+//	time the next interrupt is due (Interrupt::NextDue), and an
+//	instruction that traps into the kernel first accounts for the ones
+//	before it (see RaiseException), so interrupts fire at the same
+//	tick, and the kernel sees the same clock, as with the interpreter.
+//----------------------------------------------------------------------
+
+typedef bool (*BlockHandler)(Machine *machine, int *registers,
+                             Instruction *instr);
+
+const int MaxBlockLength = 32;		// longest block we translate
+
+// One translated instruction.
+
+class BlockOp {
+  public:
+    BlockHandler handler;		// NULL means ExecuteInstruction
+    Instruction instr;			// the decoded instruction
+};
+
+// A translated basic block.
+
+class TranslatedBlock {
+  public:
+    int length;				// # of instructions in the block
+    BlockOp ops[MaxBlockLength];
+};
+
+//----------------------------------------------------------------------
+// Retire
+// 	The end of every instruction, as in ExecuteInstruction: do the
+//	delayed load from the previous instruction, schedule this one's
+//	(if any), and advance the program counters.
+//----------------------------------------------------------------------
+
+static inline void
+Retire(int *registers, int pcAfter, int loadReg = 0, int loadValue = 0)
+{
+    registers[registers[LoadReg]] = registers[LoadValueReg];
+    registers[LoadReg] = loadReg;
+    registers[LoadValueReg] = loadValue;
+    registers[0] = 0;
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = pcAfter;
+}
+
+//----------------------------------------------------------------------
+// Block handlers
+// 	One per common opcode; each does exactly what the corresponding
+//	case of ExecuteInstruction does.  Return FALSE if an exception
+//	was raised.
+//----------------------------------------------------------------------
+
+static bool
+DoADDU(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        registers[(int) instr->rs] + registers[(int) instr->rt];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoADDIU(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] = registers[(int) instr->rs] + instr->extra;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSUBU(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        registers[(int) instr->rs] - registers[(int) instr->rt];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoAND(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        registers[(int) instr->rs] & registers[(int) instr->rt];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoANDI(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] =
+        registers[(int) instr->rs] & (instr->extra & 0xffff);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoOR(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        registers[(int) instr->rs] | registers[(int) instr->rt];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoORI(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] =
+        registers[(int) instr->rs] | (instr->extra & 0xffff);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoXOR(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        registers[(int) instr->rs] ^ registers[(int) instr->rt];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoXORI(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] =
+        registers[(int) instr->rs] ^ (instr->extra & 0xffff);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoNOR(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        ~(registers[(int) instr->rs] | registers[(int) instr->rt]);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoLUI(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] = instr->extra << 16;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSLL(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] = registers[(int) instr->rt] << instr->extra;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSRA(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] = registers[(int) instr->rt] >> instr->extra;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSRL(Machine *machine, int *registers, Instruction *instr)
+{
+    int tmp = registers[(int) instr->rt];	// signed, as in ExecuteInstruction
+
+    tmp >>= instr->extra;
+    registers[(int) instr->rd] = tmp;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSLT(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] =
+        (registers[(int) instr->rs] < registers[(int) instr->rt]);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSLTI(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] = (registers[(int) instr->rs] < instr->extra);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSLTU(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] = ((unsigned int) registers[(int) instr->rs]
+                            < (unsigned int) registers[(int) instr->rt]);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSLTIU(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rt] = ((unsigned int) registers[(int) instr->rs]
+                            < (unsigned int) instr->extra);
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoMFHI(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] = registers[HiReg];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoMFLO(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] = registers[LoReg];
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoBEQ(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    if (registers[(int) instr->rs] == registers[(int) instr->rt])
+        pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    Retire(registers, pcAfter);
+    return TRUE;
+}
+
+static bool
+DoBNE(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    if (registers[(int) instr->rs] != registers[(int) instr->rt])
+        pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    Retire(registers, pcAfter);
+    return TRUE;
+}
+
+static bool
+DoBLEZ(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    if (registers[(int) instr->rs] <= 0)
+        pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    Retire(registers, pcAfter);
+    return TRUE;
+}
+
+static bool
+DoBGTZ(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    if (registers[(int) instr->rs] > 0)
+        pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    Retire(registers, pcAfter);
+    return TRUE;
+}
+
+static bool
+DoBLTZ(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    if (registers[(int) instr->rs] & SIGN_BIT)
+        pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    Retire(registers, pcAfter);
+    return TRUE;
+}
+
+static bool
+DoBGEZ(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    if (!(registers[(int) instr->rs] & SIGN_BIT))
+        pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    Retire(registers, pcAfter);
+    return TRUE;
+}
+
+static bool
+DoJ(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    Retire(registers, (pcAfter & 0xf0000000) | IndexToAddr(instr->extra));
+    return TRUE;
+}
+
+static bool
+DoJAL(Machine *machine, int *registers, Instruction *instr)
+{
+    int pcAfter = registers[NextPCReg] + 4;
+
+    registers[R31] = registers[NextPCReg] + 4;
+    Retire(registers, (pcAfter & 0xf0000000) | IndexToAddr(instr->extra));
+    return TRUE;
+}
+
+static bool
+DoJR(Machine *machine, int *registers, Instruction *instr)
+{
+    Retire(registers, registers[(int) instr->rs]);
+    return TRUE;
+}
+
+static bool
+DoJALR(Machine *machine, int *registers, Instruction *instr)
+{
+    registers[(int) instr->rd] = registers[NextPCReg] + 4;
+    Retire(registers, registers[(int) instr->rs]);
+    return TRUE;
+}
+
+static bool
+DoLW(Machine *machine, int *registers, Instruction *instr)
+{
+    int value;
+
+    // ReadMem raises the same AddressErrorException for an unaligned
+    // address that ExecuteInstruction checks for explicitly
+    if (!machine->ReadMem(registers[(int) instr->rs] + instr->extra, 4, &value))
+        return FALSE;
+    Retire(registers, registers[NextPCReg] + 4, instr->rt, value);
+    return TRUE;
+}
+
+static bool
+DoLB(Machine *machine, int *registers, Instruction *instr)
+{
+    int value;
+
+    if (!machine->ReadMem(registers[(int) instr->rs] + instr->extra, 1, &value))
+        return FALSE;
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+        value |= 0xffffff00;
+    else
+        value &= 0xff;
+    Retire(registers, registers[NextPCReg] + 4, instr->rt, value);
+    return TRUE;
+}
+
+static bool
+DoSW(Machine *machine, int *registers, Instruction *instr)
+{
+    if (!machine->WriteMem((unsigned)
+            (registers[(int) instr->rs] + instr->extra), 4,
+            registers[(int) instr->rt]))
+        return FALSE;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+static bool
+DoSB(Machine *machine, int *registers, Instruction *instr)
+{
+    if (!machine->WriteMem((unsigned)
+            (registers[(int) instr->rs] + instr->extra), 1,
+            registers[(int) instr->rt]))
+        return FALSE;
+    Retire(registers, registers[NextPCReg] + 4);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// HandlerFor
+// 	Return the block handler for an opcode, or NULL if the opcode is
+//	left to ExecuteInstruction.
+//----------------------------------------------------------------------
+
+static BlockHandler
+HandlerFor(int opCode)
+{
+    switch (opCode) {
+      case OP_ADDU:	return DoADDU;
+      case OP_ADDIU:	return DoADDIU;
+      case OP_SUBU:	return DoSUBU;
+      case OP_AND:	return DoAND;
+      case OP_ANDI:	return DoANDI;
+      case OP_OR:	return DoOR;
+      case OP_ORI:	return DoORI;
+      case OP_XOR:	return DoXOR;
+      case OP_XORI:	return DoXORI;
+      case OP_NOR:	return DoNOR;
+      case OP_LUI:	return DoLUI;
+      case OP_SLL:	return DoSLL;
+      case OP_SRA:	return DoSRA;
+      case OP_SRL:	return DoSRL;
+      case OP_SLT:	return DoSLT;
+      case OP_SLTI:	return DoSLTI;
+      case OP_SLTU:	return DoSLTU;
+      case OP_SLTIU:	return DoSLTIU;
+      case OP_MFHI:	return DoMFHI;
+      case OP_MFLO:	return DoMFLO;
+      case OP_BEQ:	return DoBEQ;
+      case OP_BNE:	return DoBNE;
+      case OP_BLEZ:	return DoBLEZ;
+      case OP_BGTZ:	return DoBGTZ;
+      case OP_BLTZ:	return DoBLTZ;
+      case OP_BGEZ:	return DoBGEZ;
+      case OP_J:	return DoJ;
+      case OP_JAL:	return DoJAL;
+      case OP_JR:	return DoJR;
+      case OP_JALR:	return DoJALR;
+      case OP_LW:	return DoLW;
+      case OP_LB:
+      case OP_LBU:	return DoLB;
+      case OP_SW:	return DoSW;
+      case OP_SB:	return DoSB;
+      default:		return NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// IsJump
+// 	Does this opcode (possibly) transfer control?  If so, the block
+//	ends after its delay slot.
+//----------------------------------------------------------------------
+
+static bool
+IsJump(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BGTZ:
+      case OP_BLTZ: case OP_BGEZ: case OP_BLTZAL: case OP_BGEZAL:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::InitBlocks, Machine::FreeBlocks
+// 	Allocate and de-allocate the table of translated blocks.
+//----------------------------------------------------------------------
+
+void
+Machine::InitBlocks()
+{
+    blocks = NULL;
+    if (!useBlocks)
+        return;
+    blocks = new TranslatedBlock *[MemorySize / 4];
+    for (int i = 0; i < MemorySize / 4; i++)
+        blocks[i] = NULL;
+}
+
+void
+Machine::FreeBlocks()
+{
+    if (blocks == NULL)
+        return;
+    for (int i = 0; i < MemorySize / 4; i++)
+        delete blocks[i];
+    delete [] blocks;
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Translate the basic block starting at physical address
+//	"physAddr", replacing any older translation.
+//----------------------------------------------------------------------
+
+TranslatedBlock *
+Machine::TranslateBlock(int physAddr)
+{
+    TranslatedBlock *block = blocks[physAddr / 4];
+    int pageEnd = (physAddr / PageSize + 1) * PageSize;
+    bool delaySlot = FALSE;
+
+    if (block == NULL) {
+        block = new TranslatedBlock;
+        blocks[physAddr / 4] = block;
+    }
+    block->length = 0;
+    for (int addr = physAddr; addr < pageEnd
+                && block->length < MaxBlockLength; addr += 4) {
+        BlockOp *op = &block->ops[block->length++];
+
+        op->instr = *DecodeAt(addr);
+        op->handler = HandlerFor(op->instr.opCode);
+        if (delaySlot || op->instr.opCode == OP_SYSCALL
+                || op->instr.opCode == OP_UNIMP || op->instr.opCode == OP_RES)
+            break;
+        delaySlot = IsJump(op->instr.opCode);
+    }
+    DEBUG(dbgMach, "Translated block at " << physAddr << ", "
+                        << block->length << " instructions");
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Execute the basic block at the PC, translating it first if need
+//	be.  Return how many instructions were executed (or attempted,
+//	if one raised an exception) whose time has not been accounted
+//	for yet; the caller passes that on to Interrupt::OneTick.
+//
+//	We leave the block early when the next interrupt is due, if an
+//	instruction raises an exception (the kernel may have changed
+//	anything), if the PC does not go where the block expects (we
+//	started in the delay slot of a taken branch), or if the code has
+//	been overwritten since it was translated.
+//----------------------------------------------------------------------
+
+int
+Machine::RunBlock()
+{
+    int pc = registers[PCReg];
+    int physAddr, done, limit;
+    TranslatedBlock *block;
+
+    if (!FetchAddress(pc, &physAddr))
+        return 1;			// exception while fetching
+
+    block = blocks[physAddr / 4];
+    if (block == NULL || block->ops[0].instr.value !=
+            WordToHost(*(unsigned int *) &mainMemory[physAddr]))
+        block = TranslateBlock(physAddr);
+
+    // stop when the next interrupt is due, so it is not delivered late
+    limit = (kernel->interrupt->NextDue() - kernel->stats->totalTicks)
+                                                        / UserTick;
+    if (limit > block->length)
+        limit = block->length;
+    else if (limit < 1)
+        limit = 1;
+
+    for (done = 0; done < limit; done++) {
+        BlockOp *op = &block->ops[done];
+        bool ok;
+
+        if (done > 0) {
+            if (registers[PCReg] != pc + 4 * done)
+                break;
+            if (op->instr.value != WordToHost(*(unsigned int *)
+                                    &mainMemory[physAddr + 4 * done])) {
+                block->length = done;	// code changed; re-translate the
+                break;			// rest when we get there
+            }
+        }
+
+        blockDone = done;		// in case RaiseException is called
+        if (op->handler != NULL)
+            ok = (*op->handler)(this, registers, &op->instr);
+        else
+            ok = ExecuteInstruction(&op->instr);
+        if (!ok) {			// RaiseException accounted for the
+            blockDone = 0;		// instructions before this one
+            return 1;
+        }
+    }
+    blockDone = 0;
+    return done;
+}
+
 //----------------------------------------------------------------------
 // TypeToReg
 // 	Retrieve the register # referred to in an instruction.
@@ -142,27 +806,22 @@ TypeToReg(RegType reg, Instruction *instr)
 // 22-1228[j]: (1) [從 Reg(34)=PCReg 指向的記憶體位址 ] 讀入指令 並 Decode 
 // 22-1228[j]: (2) 根據 不同 instr->opCode 對 運算元進行運算(包含 system call 中斷)
 
-void
+int
 Machine::OneInstruction(Instruction *instr)
 {
-#ifdef SIM_FIX
-    int byte;       // described in Kane for LWL,LWR,...
-#endif
-
-    int raw;
-    int nextLoadReg = 0;
-    int nextLoadValue = 0; 	// record delayed load operation, to apply in the future
-
+    int pc = registers[PCReg];
+    int loadReg = registers[LoadReg];	// this is that load's delay slot
+    int ticks = 1;
+    bool executed;
 
     // Fetch instruction
-    // 22-1223[j]: boot ReadMem(int addr, int size, int *value): 將 Memory 中 addr+size 上的資料，存入 *value
-    if (!ReadMem(registers[PCReg], 4, &raw))
-	    return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();    // 22-1223[j]: 解碼指令 = raw = instr->value 
+    if (!FetchInstruction(pc, instr)) {
+        slotLoadReg = 0;
+	    return 1;			// exception occurred
+    }
 
     // 22-1223[j]: 有開啟 debug machine simulation 的功能，就印出 執行的指令
-    if (debug->IsEnabled('m')) {
+    if (traceInstrs) {
         struct OpString *str = &opStrings[instr->opCode];
 	    char buf[80];
 
@@ -173,6 +832,207 @@ Machine::OneInstruction(Instruction *instr)
         cout << "\t" << buf << "\n";
     }
 
+    executed = ExecuteInstruction(instr);
+    if (useCosts && executed)
+        ticks = InstructionCost(instr, pc, slotLoadReg);
+    slotLoadReg = executed ? loadReg : 0;
+    ticks += cacheTicks;		// waiting for memory, on cache misses
+    cacheTicks = 0;
+    if (profiler == NULL)
+        return ticks;
+
+    // tell the profiler, including about calls and returns (after
+    // a jump, NextPCReg holds its target).  An instruction that
+    // faulted -- a TLB miss, a page fault -- is run again once the
+    // kernel has handled it, so it is only counted then; a syscall
+    // is not run again, so it counts now.
+    if (instr->opCode == OP_SYSCALL)
+        profiler->Count(pc);
+    if (!executed)
+        return ticks;
+    profiler->Count(pc);
+    switch (instr->opCode) {
+      case OP_JAL:
+      case OP_JALR:
+        profiler->Call(pc, registers[NextPCReg]);
+        break;
+      case OP_BGEZAL:
+      case OP_BLTZAL:
+        if (registers[NextPCReg] != pc + 8)	// branch taken
+            profiler->Call(pc, registers[NextPCReg]);
+        break;
+      case OP_JR:
+        if (instr->rs == RetAddrReg)
+            profiler->Return();
+        break;
+    }
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// Machine::SetCosts
+// 	Turn on the cost model: instead of one UserTick each, user
+//	instructions take the time given for their class (InstrClass),
+//	and an instruction that needs a loaded value as soon as the MIPS
+//	load delay slot allows -- right after the slot -- waits "loaduse"
+//	ticks more, as on a deeper pipeline with an interlock.  (The slot
+//	itself never uses the value; the compiler fills it with something
+//	else or a nop.)  Return FALSE, changing nothing, if "spec" is not a
+//	comma separated list of "class=ticks":
+//
+//	    alu, mult, div, load, store, taken, nottaken -- at least 1
+//	    loaduse -- at least 0
+//
+//	Classes not mentioned take one tick; "loaduse" defaults to 0.
+//----------------------------------------------------------------------
+
+bool
+Machine::SetCosts(char *spec)
+{
+    static const char *names[NumInstrClasses + 1] = { "alu", "mult", "div",
+        "load", "store", "taken", "nottaken", "loaduse" };
+    int ticks[NumInstrClasses + 1];
+    char name[16];
+    int value, length, i;
+    char *p = spec;
+
+    for (i = 0; i < NumInstrClasses; i++)
+        ticks[i] = 1;
+    ticks[NumInstrClasses] = 0;		// no load-use stalls
+
+    while (*p != '\0') {
+        if (sscanf(p, "%15[a-z]=%d%n", name, &value, &length) != 2)
+            return FALSE;
+        for (i = 0; i <= NumInstrClasses; i++) {
+            if (strcmp(name, names[i]) == 0)
+                break;
+        }
+        if (i > NumInstrClasses || value < (i < NumInstrClasses ? 1 : 0))
+            return FALSE;
+        ticks[i] = value;
+        p += length;
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return FALSE;
+    }
+
+    for (i = 0; i < NumInstrClasses; i++)
+        cost[i] = ticks[i];
+    loadUseCost = ticks[NumInstrClasses];
+    useCosts = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::InstructionCost
+// 	Return how long "instr" took under the cost model, and count it
+//	in the statistics.  Called after it executed without raising an
+//	exception (those take one tick, and the instruction is usually
+//	retried).
+//
+//	"pc" -- where "instr" is; after a branch, NextPCReg tells whether
+//		it was taken
+//	"loadReg" -- the register loaded by the instruction two before
+//		"instr", 0 if none
+//----------------------------------------------------------------------
+
+int
+Machine::InstructionCost(Instruction *instr, int pc, int loadReg)
+{
+    Statistics *stats = kernel->stats;
+    InstrClass kind;
+    bool readsRs = TRUE, readsRt = FALSE;
+    int ticks;
+
+    switch (instr->opCode) {
+      case OP_MULT:
+      case OP_MULTU:
+        kind = InstrMult;
+        readsRt = TRUE;
+        break;
+      case OP_DIV:
+      case OP_DIVU:
+        kind = InstrDiv;
+        readsRt = TRUE;
+        break;
+      case OP_LB:
+      case OP_LBU:
+      case OP_LH:
+      case OP_LHU:
+      case OP_LW:
+      case OP_LWL:
+      case OP_LWR:
+        kind = InstrLoad;
+        break;
+      case OP_SB:
+      case OP_SH:
+      case OP_SW:
+      case OP_SWL:
+      case OP_SWR:
+        kind = InstrStore;
+        readsRt = TRUE;
+        break;
+      case OP_BEQ:
+      case OP_BNE:
+        readsRt = TRUE;
+        // fall through
+      case OP_BGEZ:
+      case OP_BGEZAL:
+      case OP_BGTZ:
+      case OP_BLEZ:
+      case OP_BLTZ:
+      case OP_BLTZAL:
+        kind = (registers[NextPCReg] != pc + 8) ? InstrTaken : InstrNotTaken;
+        break;
+      case OP_J:
+      case OP_JAL:
+        kind = InstrTaken;
+        readsRs = FALSE;		// the "rs" bits are part of the target
+        break;
+      case OP_JR:
+      case OP_JALR:
+        kind = InstrTaken;
+        break;
+      default:
+        kind = InstrALU;
+        // register-register instructions (opcode 0) also read rt;
+        // the rest write it
+        readsRt = ((instr->value >> 26) == 0);
+        break;
+    }
+
+    ticks = cost[kind];
+    stats->numInstrs[kind]++;
+    stats->instrCycles[kind] += ticks;
+
+    if (loadUseCost > 0 && loadReg != 0 &&
+            ((readsRs && instr->rs == loadReg)
+             || (readsRt && instr->rt == loadReg))) {
+        ticks += loadUseCost;
+        stats->numLoadUseStalls++;
+        stats->loadUseCycles += loadUseCost;
+    }
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute an instruction that has already been fetched and decoded.
+//	Return FALSE if it raised an exception, in which case the PC has
+//	not been advanced (unless the exception handler did so).
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
+#ifdef SIM_FIX
+    int byte;       // described in Kane for LWL,LWR,...
+#endif
+
+    int nextLoadReg = 0;
+    int nextLoadValue = 0; 	// record delayed load operation, to apply in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4; // 22-1223[j]: 將 Program counter 指向下個 指令位址(4 byte = 32 bits) 
     int sum, diff, tmp, value;
@@ -189,7 +1049,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -199,7 +1059,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -294,7 +1154,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -309,10 +1169,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -331,10 +1191,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -354,7 +1214,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -362,7 +1222,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -406,7 +1266,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -414,7 +1274,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -488,13 +1348,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!WriteMem((unsigned)
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 
       case OP_SH:
 	if (!WriteMem((unsigned)
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 
       case OP_SLL:
@@ -564,7 +1424,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -576,7 +1436,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!WriteMem((unsigned)
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 
       case OP_SWL:
@@ -592,7 +1452,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 
         // DEBUG('P', "Value 0x%X\n",value);
 #else
@@ -602,7 +1462,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);
 
 	if (!ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 #ifdef SIM_FIX
@@ -629,12 +1489,12 @@ Machine::OneInstruction(Instruction *instr)
 	}
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 	break;
 
@@ -647,7 +1507,7 @@ Machine::OneInstruction(Instruction *instr)
         ASSERT((tmp & 0x3) == 0);
 
         if (!ReadMem((tmp & ~0x3), 4, &value))
-            return;
+            return FALSE;
 #else
         // The only difference between this code and the BIG ENDIAN code
         // is that the ReadMem call is guaranteed an aligned access as
@@ -660,7 +1520,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
         // DEBUG('P', "Value 0x%X\n",value);
 #endif // SIM_FIX
 
@@ -686,12 +1546,12 @@ Machine::OneInstruction(Instruction *instr)
 
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 
 
@@ -700,7 +1560,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SYSCALL:	// 23-0419[j]: MP1 注意
 	DEBUG(dbgTraCode, "In Machine::OneInstruction, RaiseException(SyscallException, 0), " << kernel->stats->totalTicks);
 	RaiseException(SyscallException, 0);
-	return;
+	return FALSE;
 
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -713,7 +1573,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 
       default:
 	ASSERT(FALSE);
@@ -729,6 +1589,7 @@ Machine::OneInstruction(Instruction *instr)
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -1,6 +1,7 @@
 // network.cc 
 //	Routines to simulate a network interface, using UNIX sockets
-//	to deliver packets between multiple invocations of nachos.
+//	(or, with "-shm", shared memory) to deliver packets between 
+//	multiple invocations of nachos.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -17,22 +18,37 @@
 // 	Initialize the simulation for the network input
 //
 //   	"toCall" is the interrupt handler to call when packet arrives
+//	"shared" says whether packets come through shared memory rather
+//		than a socket (see network.h)
 //-----------------------------------------------------------------------
 
-NetworkInput::NetworkInput(CallBackObj *toCall)
+NetworkInput::NetworkInput(CallBackObj *toCall, bool shared)
 {
     // set up the stuff to emulate asynchronous interrupts
     callWhenAvail = toCall;
     packetAvail = FALSE;
     inHdr.length = 0;
+    this->shared = shared;
+    sharedInbox = NULL;
+    nextRing = 0;
     
     sock = OpenSocket();
-    sprintf(sockName, "SOCKET_%d", kernel->hostName);
+    if (shared) {
+        // the socket is only the doorbell
+        ASSERT(kernel->hostName >= 0 && kernel->hostName < SharedNetHosts);
+        sprintf(sharedName, "SHMNET_%d", kernel->hostName);
+        sharedInbox = (SharedInbox *) MapSharedFile(sharedName,
+                                                    sizeof(SharedInbox), TRUE);
+        ASSERT(sharedInbox != NULL);
+        sprintf(sockName, "SHMBELL_%d", kernel->hostName);
+    } else {
+        sprintf(sockName, "SOCKET_%d", kernel->hostName);
+    }
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
     // start polling for incoming packets
-    kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
+    kernel->interrupt->SchedulePoll(this, NetworkTime, NetworkRecvInt, sock);
 }
 
 //-----------------------------------------------------------------------
@@ -45,6 +61,11 @@ NetworkInput::~NetworkInput()
 {
     CloseSocket(sock);
     DeAssignNameToSocket(sockName);
+    if (shared) {
+        sharedInbox->closed = TRUE;	// senders must look for a new one
+        UnmapSharedFile((char *) sharedInbox, sizeof(SharedInbox));
+        (void) Unlink(sharedName);
+    }
 }
 
 //-----------------------------------------------------------------------
@@ -60,23 +81,21 @@ NetworkInput::~NetworkInput()
 void
 NetworkInput::CallBack()
 {
-    // schedule the next time to poll for a packet
-    kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
+    // schedule the next time to poll for a packet; while one is
+    // buffered, the socket is not read, so there is nothing to wait for
+    kernel->interrupt->SchedulePoll(this, NetworkTime, NetworkRecvInt,
+                                    (inHdr.length != 0) ? -1 : sock);
 
     if (inHdr.length != 0) 	// do nothing if packet is already buffered
 	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+    char buffer[MaxWireSize];
+    if (!ReadPacket(buffer)) 	// do nothing if no packet to be read
 	return;
 
-    // otherwise, read packet in
-    char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
-
     // divide packet into header and data
     inHdr = *(PacketHeader *)buffer;
     ASSERT((inHdr.to == kernel->hostName) && (inHdr.length <= MaxPacketSize));
     bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
-    delete [] buffer ;
 
     DEBUG(dbgNet, "Network received packet from " << inHdr.from << ", length " << inHdr.length);
     kernel->stats->numPacketsRecvd++;
@@ -85,6 +104,63 @@ NetworkInput::CallBack()
     callWhenAvail->CallBack();
 }
 
+//-----------------------------------------------------------------------
+// NetworkInput::ReadPacket
+// 	Read the next packet, padded to MaxWireSize, into "buffer".
+//	Return FALSE if none has arrived.
+//-----------------------------------------------------------------------
+
+bool
+NetworkInput::ReadPacket(char *buffer)
+{
+    if (!shared) {
+        if (!PollSocket(sock))
+            return FALSE;
+        ReadFromSocket(sock, buffer, MaxWireSize);
+        return TRUE;
+    }
+
+    if (ReadSharedRing(buffer))
+        return TRUE;
+    if (!sharedInbox->bellRung)
+        return FALSE;
+
+    // every ring is empty, but the doorbell has been rung: clear it, so
+    // that "-iw" waits for the next packet, and then look again, in case
+    // a packet arrived after we looked but before the bell was cleared
+    // (its sender would not have rung).  A ring that is late getting to
+    // the socket only wakes us up early.
+    sharedInbox->bellRung = FALSE;
+    __sync_synchronize();
+    DrainSocket(sock);
+    return ReadSharedRing(buffer);
+}
+
+//-----------------------------------------------------------------------
+// NetworkInput::ReadSharedRing
+// 	Take the next packet out of the shared inbox, looking at each
+//	sender's ring in turn.  Return FALSE if they are all empty.
+//-----------------------------------------------------------------------
+
+bool
+NetworkInput::ReadSharedRing(char *buffer)
+{
+    for (int i = 0; i < SharedNetHosts; i++) {
+        SharedRing *ring = &sharedInbox->ring[(nextRing + i) % SharedNetHosts];
+        unsigned int head = ring->head;
+
+        if (head == ring->tail)
+            continue;
+        __sync_synchronize();		// read the tail, then the packet
+        bcopy(ring->slot[head % SharedRingSlots], buffer, MaxWireSize);
+        __sync_synchronize();		// read the packet, then free its slot
+        ring->head = head + 1;
+        nextRing = (nextRing + i + 1) % SharedNetHosts;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 //-----------------------------------------------------------------------
 // NetworkInput::Receive
 // 	Read a packet, if one is buffered
@@ -108,9 +184,12 @@ NetworkInput::Receive(char* data)
 //
 //   	"reliability" says whether we drop packets to emulate unreliable links
 //   	"toCall" is the interrupt handler to call when next packet can be sent
+//	"shared" says whether packets go through shared memory rather
+//		than a socket (see network.h)
 //-----------------------------------------------------------------------
 
-NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall)
+NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall,
+                             bool shared)
 {
     if (reliability < 0) chanceToWork = 0;
     else if (reliability > 1) chanceToWork = 1;
@@ -119,7 +198,15 @@ NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall)
     // set up the stuff to emulate asynchronous interrupts
     callWhenDone = toCall;
     sendBusy = FALSE;
-    sock = OpenSocket();
+    sock = OpenSocket();		// with "-shm", to ring doorbells
+    this->shared = shared;
+    if (shared) {
+        ASSERT(kernel->hostName >= 0 && kernel->hostName < SharedNetHosts);
+    }
+    for (int i = 0; i < SharedNetHosts; i++)
+        outbox[i] = NULL;
+    for (int i = 0; i < MaxLinks; i++)
+        links[i] = NULL;
 }
 
 //-----------------------------------------------------------------------
@@ -130,6 +217,12 @@ NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall)
 NetworkOutput::~NetworkOutput()
 {
     CloseSocket(sock);
+    for (int i = 0; i < SharedNetHosts; i++) {
+        if (outbox[i] != NULL)
+            UnmapSharedFile((char *) outbox[i], sizeof(SharedInbox));
+    }
+    for (int i = 0; i < MaxLinks; i++)
+        delete links[i];
 }
 
 //-----------------------------------------------------------------------
@@ -153,30 +246,291 @@ NetworkOutput::CallBack()
 //
 // 	Note we always pad out a packet to MaxWireSize before putting it into
 // 	the socket, because it's simpler at the receive end.
+//
+//	If the link to the destination is modelled, the device hands the
+//	packet to the link at once, and the link decides when (and
+//	whether) it arrives; otherwise it takes NetworkTime.
 //-----------------------------------------------------------------------
 
 void
 NetworkOutput::Send(PacketHeader hdr, char* data)
 {
-    char toName[32];
+    char buffer[MaxWireSize];
+    Link *link = NULL;
 
-    sprintf(toName, "SOCKET_%d", (int)hdr.to);
-    
     ASSERT((sendBusy == FALSE) && (hdr.length > 0) && 
 	(hdr.length <= MaxPacketSize) && (hdr.from == kernel->hostName));
     DEBUG(dbgNet, "Sending to addr " << hdr.to << ", length " << hdr.length);
 
+    // concatenate hdr and data into a single buffer
+    *(PacketHeader *)buffer = hdr;
+    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
+
+    if (hdr.to >= 0 && hdr.to < MaxLinks)
+        link = links[hdr.to];
+    if (link != NULL) {
+        kernel->interrupt->Schedule(this, 1, NetworkSendInt);
+        link->Send(buffer, sizeof(PacketHeader) + hdr.length);
+        return;
+    }
+
     kernel->interrupt->Schedule(this, NetworkTime, NetworkSendInt);
 
     if (RandomNumber() % 100 >= chanceToWork * 100) { // emulate a lost packet
 	DEBUG(dbgNet, "oops, lost it!");
 	return;
     }
+    PutOnWire(hdr.to, buffer);
+}
 
-    // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
-    *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete [] buffer;
+//-----------------------------------------------------------------------
+// NetworkOutput::PutOnWire
+// 	Hand a packet, padded to MaxWireSize, to the host to deliver to
+//	machine "to": through its socket, or its shared inbox.
+//-----------------------------------------------------------------------
+
+void
+NetworkOutput::PutOnWire(NetworkAddress to, char *buffer)
+{
+    char toName[32];
+
+    if (shared) {
+        SendShared(to, buffer);
+    } else {
+        sprintf(toName, "SOCKET_%d", (int) to);
+        SendToSocket(sock, buffer, MaxWireSize, toName);
+    }
+}
+
+//-----------------------------------------------------------------------
+// NetworkOutput::SetLinks
+// 	Model the links to other machines, as given on the command line:
+//	one or more link models separated by "/", each of them
+//
+//		[to:]delay,bandwidth,queueSize[,jitter[,burst]]
+//
+//	for the link to machine "to", or without it for the links to all
+//	machines (a later one replaces an earlier one).  See LinkModel.
+//	Return FALSE if the spec is malformed.
+//-----------------------------------------------------------------------
+
+bool
+NetworkOutput::SetLinks(char *spec)
+{
+    char *next = spec;
+
+    while (next != NULL) {
+        char *colon = strchr(next, ':');
+        char *slash = strchr(next, '/');
+        LinkModel model;
+        int to = -1;
+
+        if (colon != NULL && (slash == NULL || colon < slash)) {
+            to = atoi(next);
+            if (to < 0 || to >= MaxLinks)
+                return FALSE;
+            next = colon + 1;
+        }
+        model.jitter = 0;
+        model.burst = 1;
+        if (sscanf(next, "%d,%lf,%d,%d,%lf", &model.delay, &model.bandwidth,
+                   &model.queueSize, &model.jitter, &model.burst) < 3
+                || model.delay < 0 || model.bandwidth <= 0
+                || model.queueSize < 1 || model.jitter < 0 || model.burst < 1)
+            return FALSE;
+
+        for (int i = 0; i < MaxLinks; i++) {
+            if (to < 0 || i == to) {
+                delete links[i];
+                links[i] = new Link(this, i, &model, chanceToWork,
+                                    &kernel->stats->links[i]);
+            }
+        }
+        next = (slash != NULL) ? slash + 1 : NULL;
+    }
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------
+// NetworkOutput::SendShared
+// 	Put a packet, padded to MaxWireSize, in the shared inbox of
+//	machine "to", and ring its doorbell if it may be waiting.
+//
+//	The packet is dropped if "to" is not running, as SendToSocket
+//	does, or if our ring in its inbox is full, as a real network
+//	would when the receiver falls behind.
+//-----------------------------------------------------------------------
+
+void
+NetworkOutput::SendShared(NetworkAddress to, char *buffer)
+{
+    char name[32];
+    SharedRing *ring;
+    unsigned int tail;
+
+    if (to < 0 || to >= SharedNetHosts) {
+	DEBUG(dbgNet, "No machine " << to << " on the shared network");
+	return;
+    }
+    if (outbox[to] != NULL && outbox[to]->closed) {
+        // it has halted, and may since have started again
+        UnmapSharedFile((char *) outbox[to], sizeof(SharedInbox));
+        outbox[to] = NULL;
+    }
+    if (outbox[to] == NULL) {
+        sprintf(name, "SHMNET_%d", (int) to);
+        outbox[to] = (SharedInbox *) MapSharedFile(name, sizeof(SharedInbox),
+                                                   FALSE);
+        if (outbox[to] == NULL) {
+	    DEBUG(dbgNet, "Machine " << to << " is not running, packet lost");
+	    return;
+        }
+    }
+
+    ring = &outbox[to]->ring[kernel->hostName];
+    tail = ring->tail;
+    if (tail - ring->head >= (unsigned int) SharedRingSlots) {
+	DEBUG(dbgNet, "Ring to machine " << to << " is full, packet lost");
+	return;
+    }
+    bcopy(buffer, ring->slot[tail % SharedRingSlots], MaxWireSize);
+    __sync_synchronize();		// write the packet, then the tail
+    ring->tail = tail + 1;
+
+    // ring the doorbell only if no one else has since it was cleared;
+    // the exchange also makes sure the tail is written first
+    if (__sync_val_compare_and_swap(&outbox[to]->bellRung, FALSE, TRUE)
+            == FALSE) {
+        sprintf(name, "SHMBELL_%d", (int) to);
+        RingDoorbell(sock, name);
+    }
+}
+
+//-----------------------------------------------------------------------
+// Link::Link
+// 	Initialize the simulation of the link to another machine, with
+//	nothing on it.
+//
+//	"output" -- the device that packets are sent from
+//	"to" -- the machine at the other end
+//	"model" -- how the link behaves
+//	"chanceToWork" -- likelihood a burst of losses does not start
+//	"stats" -- where to count the packets sent on the link
+//-----------------------------------------------------------------------
+
+Link::Link(NetworkOutput *output, NetworkAddress to, LinkModel *model,
+           double chanceToWork, LinkStats *stats)
+{
+    this->output = output;
+    this->to = to;
+    this->model = *model;
+    this->chanceToWork = chanceToWork;
+    this->stats = stats;
+    departures = new int[model->queueSize];
+    queueStart = queueCount = 0;
+    lastArrival = 0;
+    inBurst = FALSE;
+    inFlight = new List<char *>;
+}
+
+//-----------------------------------------------------------------------
+// Link::~Link
+// 	Deallocate the simulation of a link.
+//-----------------------------------------------------------------------
+
+Link::~Link()
+{
+    while (!inFlight->IsEmpty())
+        delete [] inFlight->RemoveFront();
+    delete inFlight;
+    delete [] departures;
+}
+
+//-----------------------------------------------------------------------
+// Link::Send
+// 	Put a packet in the link's queue, unless the queue is full, and
+//	work out when it will arrive: once the packets ahead of it and
+//	then it have been sent, and the delay has passed.  Schedule an
+//	interrupt for then.
+//
+//	"buffer" -- the packet, padded to MaxWireSize
+//	"bytes" -- how much of it is sent, for the bandwidth
+//-----------------------------------------------------------------------
+
+void
+Link::Send(char *buffer, int bytes)
+{
+    int now = kernel->stats->totalTicks;
+    int start, sendTicks, arrival;
+    char *packet;
+
+    // forget the packets that have been sent by now
+    while (queueCount > 0 && departures[queueStart] <= now) {
+        queueStart = (queueStart + 1) % model.queueSize;
+        queueCount--;
+    }
+    if (queueCount == model.queueSize) {
+	DEBUG(dbgNet, "Queue to " << to << " is full, packet dropped");
+        stats->tailDrops++;
+        return;
+    }
+
+    if (queueCount > 0)
+        start = departures[(queueStart + queueCount - 1) % model.queueSize];
+    else
+        start = now;
+    sendTicks = (int) (bytes / model.bandwidth);
+    if (sendTicks < bytes / model.bandwidth || sendTicks == 0)
+        sendTicks++;			// a partial tick takes a whole one
+    departures[(queueStart + queueCount) % model.queueSize] =
+        start + sendTicks;
+    queueCount++;
+
+    arrival = start + sendTicks + model.delay;
+    if (model.jitter > 0)
+        arrival += RandomNumber() % (model.jitter + 1);
+    if (arrival < lastArrival)		// the network keeps packets in order
+        arrival = lastArrival;
+    lastArrival = arrival;
+
+    stats->packets++;
+    stats->bytes += bytes;
+    stats->queueTicks += start - now;
+    stats->busyTicks += sendTicks;
+    DEBUG(dbgNet, "Link to " << to << " queues packet for " << start - now
+                  << " ticks, it arrives at " << arrival);
+
+    packet = new char[MaxWireSize];
+    bcopy(buffer, packet, MaxWireSize);
+    inFlight->Append(packet);
+    kernel->interrupt->Schedule(this, arrival - now, NetworkSendInt);
+}
+
+//-----------------------------------------------------------------------
+// Link::CallBack
+// 	The oldest packet in flight has reached the other end: deliver
+//	it, unless it is lost.  A loss starts a burst, and each packet
+//	after it is lost too with a chance that makes the mean length of
+//	a burst the model's "burst".
+//-----------------------------------------------------------------------
+
+void
+Link::CallBack()
+{
+    char *packet = inFlight->RemoveFront();
+    bool lost;
+
+    if (inBurst)
+        lost = (RandomNumber() % 10000 < 10000 * (1 - 1 / model.burst));
+    else
+        lost = (RandomNumber() % 100 >= chanceToWork * 100);
+    inBurst = lost;
+
+    if (lost) {
+	DEBUG(dbgNet, "Link to " << to << " lost a packet");
+        stats->lossDrops++;
+    } else {
+        output->PutOnWire(to, packet);
+    }
+    delete [] packet;
 }
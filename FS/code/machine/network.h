@@ -18,6 +18,8 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "list.h"
+#include "stats.h"
 
 // Network address -- uniquely identifies a machine.  This machine's ID 
 //  is given on the command line.
@@ -42,6 +44,55 @@ class PacketHeader {
 #define MaxPacketSize 	(MaxWireSize - sizeof(struct PacketHeader))	
 				// data "payload" of the largest packet
 
+// With "-shm", packets between Nachos on the same host go through
+// shared memory rather than sockets.  The packets for machine n
+// arrive in the file SHMNET_n, a SharedInbox, which has a ring of
+// packets for each machine that may send to it: each ring has only
+// one writer and one reader, so it needs no lock, and a packet is
+// sent and received without a system call.  The receiver finds
+// packets when it polls, as with sockets; a sender only rings its
+// doorbell (a one byte datagram to the socket SHMBELL_n) when the
+// receiver may be waiting in the host for one (see "-iw").  Packets
+// take NetworkTime either way.
+
+const int SharedNetHosts = 16;	// machine IDs must be less than this
+const int SharedRingSlots = 64;	// packets each ring holds
+
+typedef struct {
+    volatile unsigned int head;	// # of packets ever taken out
+    volatile unsigned int tail;	// # of packets ever put in
+    char slot[SharedRingSlots][MaxWireSize];
+} SharedRing;
+
+typedef struct {
+    volatile int closed;	// The receiver has gone; map the file
+				// again before sending to it
+    volatile int bellRung;	// The doorbell has been rung since the
+				// receiver last cleared it
+    SharedRing ring[SharedNetHosts]; // By the sender's machine ID
+} SharedInbox;
+
+// With "-link", the link from this machine to each other one is
+// modelled, rather than every packet taking NetworkTime.  A packet
+// waits in the link's queue -- or is dropped, if "queueSize" packets
+// are already waiting or being sent -- takes its size divided by the
+// bandwidth to be sent, and arrives "delay" ticks after that, plus up
+// to "jitter" more (but never before the packet ahead of it).  The
+// chance of loss ("-n") is then the chance that a burst of losses
+// starts; a burst is "burst" packets long on average.
+//
+// Each Nachos keeps its own time, so it is the sender that simulates
+// the link: it hands the packet to the host (a socket, or shared
+// memory) at the tick the packet would arrive.
+
+typedef struct {
+    int delay;			// Propagation delay, in ticks
+    double bandwidth;		// Bytes sent per tick
+    int queueSize;		// Most packets waiting or being sent
+    int jitter;			// Most extra delay, in ticks
+    double burst;		// Mean # of packets lost in a row
+} LinkModel;
+
 
 // The following two classes defines a physical network device.  The network
 // is capable of delivering fixed sized packets, in order but unreliably, 
@@ -55,8 +106,9 @@ class PacketHeader {
 
 class NetworkInput : public CallBackObj{
   public:
-    NetworkInput(CallBackObj *toCall);
-				// Allocate and initialize network input driver
+    NetworkInput(CallBackObj *toCall, bool shared);
+				// Allocate and initialize network input 
+				// driver; "shared" for shared memory
     ~NetworkInput();		// De-allocate the network input driver data
     
     PacketHeader Receive(char* data);
@@ -71,6 +123,11 @@ class NetworkInput : public CallBackObj{
   private:
     int sock;                   // UNIX socket number for incoming packets
     char sockName[32];          // File name corresponding to UNIX socket
+    bool shared;		// Do packets come through shared memory?
+    SharedInbox *sharedInbox;	// If so, where they arrive; "sock" is
+				// then the doorbell
+    char sharedName[32];	// File name of the shared inbox
+    int nextRing;		// Ring to look in first, for fairness
 
     CallBackObj *callWhenAvail; // Interrupt handler, signalling packet has 
 				// 	arrived.
@@ -78,12 +135,51 @@ class NetworkInput : public CallBackObj{
 				//   network
     PacketHeader inHdr;		// Information about arrived packet
     char inbox[MaxPacketSize];  // Data for arrived packet
+
+    bool ReadPacket(char *buffer); // Take a packet off the wire, if any
+    bool ReadSharedRing(char *buffer);
+				// Take one out of the shared inbox
+};
+
+class NetworkOutput;
+
+// The following class simulates the link to one other machine, as
+// described by a LinkModel.
+
+class Link : public CallBackObj {
+  public:
+    Link(NetworkOutput *output, NetworkAddress to, LinkModel *model,
+	 double chanceToWork, LinkStats *stats);
+				// Model the link from "output" to "to"
+    ~Link();			// Packets still in flight are lost
+
+    void Send(char *buffer, int bytes);
+				// Queue a packet (MaxWireSize in "buffer",
+				// of which "bytes" are sent)
+
+    void CallBack();		// The oldest packet in flight has arrived
+
+  private:
+    NetworkOutput *output;	// Where packets go when they arrive
+    NetworkAddress to;		// The machine at the other end
+    LinkModel model;
+    double chanceToWork;	// Likelihood a burst of losses does not
+				// start
+    LinkStats *stats;		// Where the link's packets are counted
+    int *departures;		// When each packet in the queue will have
+				// been sent (a ring of "queueSize")
+    int queueStart, queueCount;
+    int lastArrival;		// When the newest packet will arrive
+    bool inBurst;		// Was the last packet lost?
+    List<char *> *inFlight;	// Packets queued or on their way, oldest
+				// first
 };
 
 class NetworkOutput : public CallBackObj {
   public:
-    NetworkOutput(double reliability, CallBackObj *toCall);
-				// Allocate and initialize network output driver
+    NetworkOutput(double reliability, CallBackObj *toCall, bool shared);
+				// Allocate and initialize network output 
+				// driver; "shared" for shared memory
     ~NetworkOutput();		// De-allocate the network input driver data
     
     void Send(PacketHeader hdr, char* data);
@@ -99,12 +195,26 @@ class NetworkOutput : public CallBackObj {
     void CallBack();		// Interrupt handler, called when message is 
 				// sent
 
+    bool SetLinks(char *spec);	// Model the links to other machines
+				// (see "-link"); FALSE if "spec" is bad
+    void PutOnWire(NetworkAddress to, char *buffer);
+				// Hand a packet to the host, to deliver
+
   private:
     int sock;                   // UNIX socket number for outgoing packets
     double chanceToWork;	// Likelihood packet will be dropped
     CallBackObj *callWhenDone;  // Interrupt handler, signalling next packet 
 				//      can be sent.  
     bool sendBusy;		// Packet is being sent.
+    bool shared;		// Do packets go through shared memory?
+    SharedInbox *outbox[SharedNetHosts];
+				// Inboxes of the machines sent to so far
+				// (with "-shm"), or NULL
+    Link *links[MaxLinks];	// Modelled links, by the machine at the
+				// other end, or NULL for NetworkTime
+
+    void SendShared(NetworkAddress to, char *buffer);
+				// Put a packet in another machine's inbox
 };
 
 #endif // NETWORK_H
@@ -0,0 +1,542 @@
+// profile.cc
+//	Routines to profile user programs.  See profile.h for the
+//	overall design.
+//
+//	The symbol table is the one the MIPS compiler leaves at the end
+//	of the COFF file (the "symbolic header" f_symptr points to), of
+//	which we only use the procedure entries: local ones, for static
+//	functions, and external ones.  Everything in the file is
+//	little-endian, whatever the host is.
+
+#include "copyright.h"
+#include "profile.h"
+#include "machine.h"
+#include "sysdep.h"
+#include "main.h"
+
+const int ProfileNameLength = 80;	// longest "function+offset" printed
+
+// Where to find things in a MIPS COFF file (see coff2noff/coff.h)
+const int CoffHeaderSize = 20;		// file header
+const int CoffMagic = 0x0162;		// f_magic of a little-endian MIPS file
+const int CoffSymPtr = 8;		// offset of f_symptr in the file header
+const int SymHeaderSize = 96;		// symbolic header
+const int SymHeaderMagic = 0x7009;
+const int FileDescSize = 72;		// one entry per source file
+const int LocalSymSize = 12;		// local symbol
+const int ExternalSymSize = 16;		// external symbol: flags, file,
+					// then a local symbol
+const int StProc = 6;			// symbol types of a function
+const int StStaticProc = 14;
+const int ScText = 1;			// storage class: in the text segment
+
+//----------------------------------------------------------------------
+// GetWord, GetShort
+// 	Fetch a little-endian value from a buffer read from the file.
+//----------------------------------------------------------------------
+
+static int
+GetWord(char *p)
+{
+    unsigned int word;
+
+    bcopy(p, &word, sizeof(unsigned int));
+    return WordToHost(word);
+}
+
+static int
+GetShort(char *p)
+{
+    unsigned short shortword;
+
+    bcopy(p, &shortword, sizeof(unsigned short));
+    return ShortToHost(shortword);
+}
+
+//----------------------------------------------------------------------
+// ReadRegion
+// 	Read "size" bytes at "offset" in the file, into a new buffer.
+//----------------------------------------------------------------------
+
+static char *
+ReadRegion(int fd, int offset, int size)
+{
+    char *buffer = new char[size > 0 ? size : 1];
+
+    if (size > 0) {
+        Lseek(fd, offset, 0);
+        Read(fd, buffer, size);
+    }
+    return buffer;
+}
+
+//----------------------------------------------------------------------
+// SymbolCompare
+// 	Order symbols by entry point, for qsort.
+//----------------------------------------------------------------------
+
+static int
+SymbolCompare(const void *x, const void *y)
+{
+    ProfileSymbol *a = (ProfileSymbol *) x;
+    ProfileSymbol *b = (ProfileSymbol *) y;
+
+    if (a->value < b->value) { return -1; }
+    else if (a->value > b->value) { return 1; }
+    else { return 0; }
+}
+
+//----------------------------------------------------------------------
+// ProfileNode::ProfileNode
+// 	A function called from "caller"; link it into the caller's
+//	list of callees.  "caller" is NULL for the root.
+//----------------------------------------------------------------------
+
+ProfileNode::ProfileNode(int entry, ProfileNode *caller)
+{
+    function = entry;
+    count = calls = 0;
+    parent = caller;
+    children = NULL;
+    if (caller != NULL) {
+        depth = caller->depth + 1;
+        sibling = caller->children;
+        caller->children = this;
+    } else {
+        depth = 0;
+        sibling = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// ProfileNode::~ProfileNode
+// 	Delete this node and everything called from it.
+//----------------------------------------------------------------------
+
+ProfileNode::~ProfileNode()
+{
+    ProfileNode *child;
+
+    while (children != NULL) {
+        child = children;
+        children = child->sibling;
+        delete child;
+    }
+}
+
+//----------------------------------------------------------------------
+// Profiler::Profiler
+// 	Set up to profile a program.
+//
+//	"coffName" -- the program's COFF file, for the symbols
+//	"foldedName" -- UNIX file to write the folded stacks to
+//----------------------------------------------------------------------
+
+Profiler::Profiler(const char *coffName, const char *foldedName)
+{
+    this->foldedName = foldedName;
+    numInstructions = numCalls = 0;
+    pcCounts = new int[MemorySize / 4];
+    callCounts = new int[MemorySize / 4];
+    callTargets = new int[MemorySize / 4];
+    for (int i = 0; i < MemorySize / 4; i++)
+        pcCounts[i] = callCounts[i] = callTargets[i] = 0;
+    contexts = context = NULL;
+
+    symbols = NULL;
+    numSymbols = 0;
+    localStrings = externalStrings = NULL;
+    ReadSymbols(coffName);
+}
+
+//----------------------------------------------------------------------
+// Profiler::~Profiler
+//----------------------------------------------------------------------
+
+Profiler::~Profiler()
+{
+    ProfileContext *c;
+
+    delete [] pcCounts;
+    delete [] callCounts;
+    delete [] callTargets;
+    while (contexts != NULL) {
+        c = contexts;
+        contexts = c->next;
+        delete c->root;
+        delete c;
+    }
+    delete [] symbols;
+    delete [] localStrings;
+    delete [] externalStrings;
+}
+
+//----------------------------------------------------------------------
+// Profiler::ReadSymbols
+// 	Collect the functions of the COFF file "coffName", sorted by
+//	entry point.  A file without a symbol table is fine: PCs are
+//	then reported as addresses.
+//----------------------------------------------------------------------
+
+void
+Profiler::ReadSymbols(const char *coffName)
+{
+    char header[SymHeaderSize];
+    char *fileDescs, *localSyms, *externalSyms, *sym;
+    int fd, symPtr, numLocal, numExternal, numFiles;
+    int localSize, externalSize, iss, type;
+
+    fd = OpenForReadWrite(coffName, TRUE);
+    if (ReadPartial(fd, header, CoffHeaderSize) != CoffHeaderSize
+            || GetShort(header) != CoffMagic) {
+        cerr << "Profiler: " << coffName << " is not a MIPS COFF file\n";
+        Abort();
+    }
+    symPtr = GetWord(header + CoffSymPtr);
+    if (symPtr == 0) {
+        cerr << "Profiler: " << coffName << " has no symbol table\n";
+        Close(fd);
+        return;
+    }
+    Lseek(fd, symPtr, 0);
+    if (ReadPartial(fd, header, SymHeaderSize) != SymHeaderSize
+            || GetShort(header) != SymHeaderMagic) {
+        cerr << "Profiler: bad symbol table in " << coffName << "\n";
+        Abort();
+    }
+
+    numLocal = GetWord(header + 32);		// isymMax
+    localSize = GetWord(header + 56);		// issMax
+    externalSize = GetWord(header + 64);	// issExtMax
+    numFiles = GetWord(header + 72);		// ifdMax
+    numExternal = GetWord(header + 88);		// iextMax
+    localSyms = ReadRegion(fd, GetWord(header + 36), numLocal * LocalSymSize);
+    localStrings = ReadRegion(fd, GetWord(header + 60), localSize);
+    externalStrings = ReadRegion(fd, GetWord(header + 68), externalSize);
+    fileDescs = ReadRegion(fd, GetWord(header + 76), numFiles * FileDescSize);
+    externalSyms = ReadRegion(fd, GetWord(header + 92),
+                              numExternal * ExternalSymSize);
+    Close(fd);
+
+    symbols = new ProfileSymbol[numLocal + numExternal];
+
+    // local symbols are numbered, and named, relative to their file
+    for (int f = 0; f < numFiles; f++) {
+        char *desc = fileDescs + f * FileDescSize;
+        int issBase = GetWord(desc + 8);
+        int isymBase = GetWord(desc + 16);
+        int numSyms = GetWord(desc + 20);
+
+        for (int i = isymBase; i < isymBase + numSyms && i < numLocal; i++) {
+            sym = localSyms + i * LocalSymSize;
+            iss = issBase + GetWord(sym);
+            type = GetWord(sym + 8);
+            if ((type & 0x3f) != StProc && (type & 0x3f) != StStaticProc)
+                continue;
+            if (((type >> 6) & 0x1f) != ScText || iss < 0 || iss >= localSize)
+                continue;
+            symbols[numSymbols].value = GetWord(sym + 4);
+            symbols[numSymbols].name = localStrings + iss;
+            numSymbols++;
+        }
+    }
+    for (int i = 0; i < numExternal; i++) {
+        sym = externalSyms + i * ExternalSymSize + 4;
+        iss = GetWord(sym);
+        type = GetWord(sym + 8);
+        if ((type & 0x3f) != StProc || ((type >> 6) & 0x1f) != ScText
+                || iss < 0 || iss >= externalSize)
+            continue;
+        symbols[numSymbols].value = GetWord(sym + 4);
+        symbols[numSymbols].name = externalStrings + iss;
+        numSymbols++;
+    }
+    delete [] localSyms;
+    delete [] fileDescs;
+    delete [] externalSyms;
+
+    // a function can be both local and external: keep one of each
+    qsort(symbols, numSymbols, sizeof(ProfileSymbol), SymbolCompare);
+    int kept = 0;
+    for (int i = 0; i < numSymbols; i++) {
+        if (kept == 0 || symbols[kept - 1].value != symbols[i].value)
+            symbols[kept++] = symbols[i];
+    }
+    numSymbols = kept;
+    DEBUG(dbgMach, "Profiler: " << numSymbols << " functions in " << coffName);
+}
+
+//----------------------------------------------------------------------
+// Profiler::FindSymbol
+// 	Return the index of the function "pc" is in -- the last one
+//	starting at or before it -- or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+Profiler::FindSymbol(int pc)
+{
+    int low = 0, high = numSymbols - 1, middle;
+
+    if (numSymbols == 0 || pc < symbols[0].value)
+        return -1;
+    while (low < high) {		// symbols[low].value <= pc throughout
+        middle = (low + high + 1) / 2;
+        if (symbols[middle].value <= pc)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return low;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Symbolize
+// 	Print "pc" into "buf" as "function+offset" (just "function" if
+//	"withOffset" is FALSE), or in hex if no function holds it.
+//----------------------------------------------------------------------
+
+void
+Profiler::Symbolize(int pc, bool withOffset, char *buf, int size)
+{
+    int i = FindSymbol(pc);
+
+    if (i < 0)
+        snprintf(buf, size, "0x%x", pc);
+    else if (withOffset && pc != symbols[i].value)
+        snprintf(buf, size, "%s+0x%x", symbols[i].name, pc - symbols[i].value);
+    else
+        snprintf(buf, size, "%s", symbols[i].name);
+}
+
+//----------------------------------------------------------------------
+// Profiler::FindContext
+// 	Return the call stack of the address space now running,
+//	starting a new one the first time we see it.
+//----------------------------------------------------------------------
+
+ProfileContext *
+Profiler::FindContext()
+{
+    void *space = (void *) kernel->currentThread->space;
+
+    if (context != NULL && context->space == space)
+        return context;
+    for (context = contexts; context != NULL; context = context->next) {
+        if (context->space == space)
+            return context;
+    }
+    context = new ProfileContext;
+    context->space = space;
+    context->root = context->current = NULL;
+    context->pendingCall = -1;
+    context->pendingReturn = FALSE;
+    context->lost = 0;
+    context->next = contexts;
+    contexts = context;
+    return context;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Count
+// 	Count an instruction of the running program, and charge it to
+//	the function on top of the call stack.
+//
+//	A call or return (see Call and Return) takes effect only now,
+//	after the instruction in its delay slot has been charged to the
+//	function that made it.
+//----------------------------------------------------------------------
+
+void
+Profiler::Count(int pc)
+{
+    ProfileContext *c = FindContext();
+    ProfileNode *callee;
+
+    numInstructions++;
+    if ((unsigned) pc < (unsigned) MemorySize)
+        pcCounts[pc / 4]++;
+
+    if (c->root == NULL) {
+        c->root = c->current = new ProfileNode(pc, NULL);
+    } else if (pc == c->root->function) {	// a new program, in an
+        c->current = c->root;			// address space we have
+        c->pendingCall = -1;			// seen before
+        c->pendingReturn = FALSE;
+        c->lost = 0;
+    }
+    c->current->count++;
+
+    if (c->pendingCall != -1) {
+        if (c->current->depth >= MaxProfileDepth) {
+            c->lost++;
+        } else {
+            for (callee = c->current->children; callee != NULL;
+                                    callee = callee->sibling) {
+                if (callee->function == c->pendingCall)
+                    break;
+            }
+            if (callee == NULL)
+                callee = new ProfileNode(c->pendingCall, c->current);
+            callee->calls++;
+            c->current = callee;
+        }
+        c->pendingCall = -1;
+    } else if (c->pendingReturn) {
+        if (c->lost > 0)
+            c->lost--;
+        else if (c->current->parent != NULL)
+            c->current = c->current->parent;
+        c->pendingReturn = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Profiler::Call
+// 	The instruction just counted, at "site", called "entry".
+//----------------------------------------------------------------------
+
+void
+Profiler::Call(int site, int entry)
+{
+    numCalls++;
+    if ((unsigned) site < (unsigned) MemorySize) {
+        callCounts[site / 4]++;
+        callTargets[site / 4] = entry;
+    }
+    context->pendingCall = entry;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Return
+// 	The instruction just counted returns to its caller.
+//----------------------------------------------------------------------
+
+void
+Profiler::Return()
+{
+    context->pendingReturn = TRUE;
+}
+
+//----------------------------------------------------------------------
+// TopEntries
+// 	Find the (at most) "numTop" largest non-zero entries of
+//	"counts", and store their indices in "top", largest first.
+//	Return how many were found.
+//----------------------------------------------------------------------
+
+static int
+TopEntries(int *counts, int numCounts, int *top, int numTop)
+{
+    int found = 0, j;
+
+    for (int i = 0; i < numCounts; i++) {
+        if (counts[i] == 0 || (found == numTop && counts[i] <= counts[top[found - 1]]))
+            continue;
+        if (found < numTop)
+            found++;
+        for (j = found - 1; j > 0 && counts[top[j - 1]] < counts[i]; j--)
+            top[j] = top[j - 1];
+        top[j] = i;
+    }
+    return found;
+}
+
+//----------------------------------------------------------------------
+// Profiler::WriteFolded
+// 	Write one line for "node", and for every function called from
+//	it, that executed any instructions itself: the chain of calls
+//	that led there, outermost first, and the number of instructions.
+//
+//	"prefix" -- the chain of calls above "node"
+//----------------------------------------------------------------------
+
+void
+Profiler::WriteFolded(int fd, ProfileNode *node, const char *prefix)
+{
+    char name[ProfileNameLength];
+    char number[20];
+    char *path;
+
+    Symbolize(node->function, FALSE, name, ProfileNameLength);
+    path = new char[strlen(prefix) + strlen(name) + 2];
+    if (prefix[0] == '\0')
+        strcpy(path, name);
+    else
+        sprintf(path, "%s;%s", prefix, name);
+
+    if (node->count > 0) {
+        sprintf(number, " %d\n", node->count);
+        WriteFile(fd, path, strlen(path));
+        WriteFile(fd, number, strlen(number));
+    }
+    for (ProfileNode *callee = node->children; callee != NULL;
+                                    callee = callee->sibling)
+        WriteFolded(fd, callee, path);
+    delete [] path;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Report
+// 	Print the hottest PCs, functions, and call sites, and write the
+//	folded stacks out.  Called at Halt.
+//----------------------------------------------------------------------
+
+void
+Profiler::Report()
+{
+    int top[ProfileTopN];
+    int *selfCounts;
+    int found, fd;
+    char where[ProfileNameLength], callee[ProfileNameLength];
+    char line[2 * ProfileNameLength + 40];
+    double total = (numInstructions > 0) ? numInstructions : 1;
+
+    cout << "\nProfile: " << numInstructions << " user instructions, "
+         << numCalls << " calls\n";
+
+    cout << "Hot PCs:\n";
+    found = TopEntries(pcCounts, MemorySize / 4, top, ProfileTopN);
+    for (int i = 0; i < found; i++) {
+        Symbolize(top[i] * 4, TRUE, where, ProfileNameLength);
+        sprintf(line, "%12d %5.1f%%  0x%06x  %s\n", pcCounts[top[i]],
+                100.0 * pcCounts[top[i]] / total, top[i] * 4, where);
+        cout << line;
+    }
+
+    if (numSymbols > 0) {
+        cout << "Hot functions (own instructions):\n";
+        selfCounts = new int[numSymbols];
+        for (int i = 0; i < numSymbols; i++)
+            selfCounts[i] = 0;
+        for (int i = 0; i < MemorySize / 4; i++) {
+            int s = (pcCounts[i] > 0) ? FindSymbol(i * 4) : -1;
+
+            if (s >= 0)
+                selfCounts[s] += pcCounts[i];
+        }
+        found = TopEntries(selfCounts, numSymbols, top, ProfileTopN);
+        for (int i = 0; i < found; i++) {
+            sprintf(line, "%12d %5.1f%%  ", selfCounts[top[i]],
+                    100.0 * selfCounts[top[i]] / total);
+            cout << line << symbols[top[i]].name << "\n";
+        }
+        delete [] selfCounts;
+    }
+
+    cout << "Hot call sites:\n";
+    found = TopEntries(callCounts, MemorySize / 4, top, ProfileTopN);
+    for (int i = 0; i < found; i++) {
+        Symbolize(top[i] * 4, TRUE, where, ProfileNameLength);
+        Symbolize(callTargets[top[i]], FALSE, callee, ProfileNameLength);
+        sprintf(line, "%12d  %s -> %s\n", callCounts[top[i]], where, callee);
+        cout << line;
+    }
+
+    fd = OpenForWrite(foldedName);
+    for (ProfileContext *c = contexts; c != NULL; c = c->next) {
+        if (c->root != NULL)
+            WriteFolded(fd, c->root, "");
+    }
+    Close(fd);
+    cout << "Folded stacks written to " << foldedName << "\n";
+}
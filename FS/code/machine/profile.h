@@ -0,0 +1,114 @@
+// profile.h
+//	Data structures for profiling user programs, one instruction
+//	at a time.
+//
+//	With "nachos -prof prog.coff", Machine::Run tells the profiler
+//	about every user instruction it executes, and about every call
+//	(jal, jalr, bgezal, bltzal) and return ("jr $31").  The profiler
+//	counts executions per PC and calls per call site, and keeps a
+//	shadow call stack for each address space, so that every
+//	instruction can be charged to the chain of calls it ran under.
+//
+//	At Halt, the hottest PCs, functions and call sites are printed,
+//	symbolized with the COFF symbol table of the program -- the
+//	".coff" file the test Makefile links before running coff2noff.
+//	The call chains are written out as "folded stacks", one line
+//	per chain ("__start;main;Sort 1234"), the input format of the
+//	usual flame graph tools.
+//
+//	Only one symbol table is read; if several programs run ("-e"
+//	more than once) their PCs are counted together.  Block
+//	execution ("-bb") is turned off while profiling.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+const int ProfileTopN = 20;		// # of lines in each table of the report
+const int MaxProfileDepth = 256;	// calls deeper than this are not followed
+
+// The following class is a function reached by one particular chain
+// of calls: the nodes form a tree, rooted at the program's entry
+// point, with one child per function called from here.
+
+class ProfileNode {
+  public:
+    ProfileNode(int entry, ProfileNode *caller);
+    ~ProfileNode();			// Deletes the subtree, too
+
+    int function;			// PC of the function's entry point
+    int count;				// Instructions executed in the function
+					// itself, along this chain
+    int calls;				// # of times called along this chain
+    int depth;				// # of callers above us
+    ProfileNode *parent;		// Caller; NULL at the root
+    ProfileNode *children;		// First function called from here
+    ProfileNode *sibling;		// Next function called by our caller
+};
+
+// The following class is the shadow call stack of one address space.
+
+class ProfileContext {
+  public:
+    void *space;			// The AddrSpace it belongs to
+    ProfileNode *root;			// Top of the call tree
+    ProfileNode *current;		// Function now running
+    int pendingCall;			// Call to enter after the delay slot,
+					// -1 if none
+    bool pendingReturn;			// Return after the delay slot?
+    int lost;				// Calls not followed, past MaxProfileDepth
+    ProfileContext *next;		// Next address space
+};
+
+// The following class is a function in the program's symbol table.
+
+class ProfileSymbol {
+  public:
+    int value;				// Entry point
+    char *name;				// Points into the string tables
+};
+
+class Profiler {
+  public:
+    Profiler(const char *coffName, const char *foldedName);
+					// Read the symbols in "coffName";
+					// write folded stacks to "foldedName"
+    ~Profiler();
+
+    void Count(int pc);			// An instruction at "pc" was executed
+    void Call(int site, int entry);	// The instruction at "site" calls
+					// the function at "entry"
+    void Return();			// The instruction just counted returns
+
+    void Report();			// Print the report, write the stacks
+
+  private:
+    const char *foldedName;		// Where to write the folded stacks
+    int numInstructions;		// # of instructions counted
+    int numCalls;			// # of calls counted
+    int *pcCounts;			// Executions of each word of memory
+    int *callCounts;			// Calls made from each word of memory
+    int *callTargets;			// Function last called from each word
+
+    ProfileContext *contexts;		// Call stack of each address space
+    ProfileContext *context;		// The one now running
+
+    ProfileSymbol *symbols;		// Functions, sorted by entry point
+    int numSymbols;
+    char *localStrings;			// Names of the symbols
+    char *externalStrings;
+
+    void ReadSymbols(const char *coffName);
+					// Fill in "symbols"
+    int FindSymbol(int pc);		// Index of the function holding "pc",
+					// -1 if none
+    void Symbolize(int pc, bool withOffset, char *buf, int size);
+					// Print "pc" as "function+offset"
+    ProfileContext *FindContext();	// Stack of the current address space
+    void WriteFolded(int fd, ProfileNode *node, const char *prefix);
+					// Folded stacks of a subtree
+};
+
+#endif // PROFILE_H
@@ -11,6 +11,77 @@
 #include "debug.h"
 #include "stats.h"
 
+// Names of the instruction classes, for Print.
+static const char *instrClassNames[NumInstrClasses] = {
+    "alu", "mult", "div", "load", "store", "taken", "not taken" };
+
+//----------------------------------------------------------------------
+// CacheStats::CacheStats
+// 	No accesses yet.
+//----------------------------------------------------------------------
+
+CacheStats::CacheStats()
+{
+    reads = readMisses = writes = writeMisses = writeBacks = 0;
+}
+
+//----------------------------------------------------------------------
+// CacheStats::Print
+// 	Print the counts, and the miss rate, under "name" -- unless the
+//	cache was never used.
+//----------------------------------------------------------------------
+
+void
+CacheStats::Print(const char *name)
+{
+    int accesses = reads + writes;
+    char rate[16];
+
+    if (accesses == 0)
+        return;
+    sprintf(rate, "%.2f%%", 100.0 * (readMisses + writeMisses) / accesses);
+    cout << name << ": reads " << reads << ", read misses " << readMisses;
+		cout << ", writes " << writes << ", write misses " << writeMisses;
+		cout << ", write-backs " << writeBacks;
+		cout << ", miss rate " << rate << "\n";
+}
+
+//----------------------------------------------------------------------
+// LinkStats::LinkStats
+// 	Initialize the counts for one network link to zero.
+//----------------------------------------------------------------------
+
+LinkStats::LinkStats()
+{
+    packets = bytes = queueTicks = busyTicks = 0;
+    tailDrops = lossDrops = 0;
+}
+
+//----------------------------------------------------------------------
+// LinkStats::Print
+// 	Print the counts for the link to machine "to", with the mean
+//	queueing delay and the fraction of the time ("totalTicks") the
+//	link was busy -- unless nothing was sent on it.
+//----------------------------------------------------------------------
+
+void
+LinkStats::Print(int to, int totalTicks)
+{
+    char delay[16], used[16];
+
+    if (packets + tailDrops == 0)
+        return;
+    sprintf(delay, "%.1f", packets > 0 ? (double) queueTicks / packets : 0.0);
+    sprintf(used, "%.1f%%", totalTicks > 0 ?
+                    100.0 * busyTicks / totalTicks : 0.0);
+    cout << "Link to " << to << ": packets " << packets;
+		cout << ", bytes " << bytes;
+		cout << ", mean queueing delay " << delay;
+		cout << ", tail drops " << tailDrops;
+		cout << ", lost " << lossDrops;
+		cout << ", utilization " << used << "\n";
+}
+
 //----------------------------------------------------------------------
 // Statistics::Statistics
 // 	Initialize performance metrics to zero, at system startup.
@@ -20,8 +91,23 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numDiskSeekTracks = diskBusyTicks = diskQueueTicks = numDiskCacheHits = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numMailsDelivered = numMailBuffers = 0;
+    numRemoteOpens = numRemoteReads = numRemoteWrites = 0;
+    numRemoteOpenTrips = numRemoteReadTrips = numRemoteWriteTrips = 0;
+    numRemoteCacheHits = numRemoteCacheMisses = 0;
+    numRemoteBreaks = 0;
+    numTLBHits = numTLBMisses = numTLBFlushes = 0;
+    for (int i = 0; i < NumInstrClasses; i++)
+        numInstrs[i] = instrCycles[i] = 0;
+    numLoadUseStalls = loadUseCycles = 0;
+    numCPUs = 1;
+    for (int i = 0; i < MaxCPUs; i++) {
+        cpuTotalTicks[i] = cpuIdleTicks[i] = 0;
+        cpuSystemTicks[i] = cpuUserTicks[i] = cpuSteals[i] = 0;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -35,11 +121,76 @@ Statistics::Print()
 {
     cout << "Ticks: total " << totalTicks << ", idle " << idleTicks;
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
+    for (int i = 0; numCPUs > 1 && i < numCPUs; i++) {
+        int busy = cpuSystemTicks[i] + cpuUserTicks[i];
+        char used[16];
+
+        sprintf(used, "%.1f%%", busy + cpuIdleTicks[i] > 0 ?
+                        100.0 * busy / (busy + cpuIdleTicks[i]) : 0.0);
+        cout << "CPU " << i << ": ticks " << cpuTotalTicks[i];
+		cout << ", idle " << cpuIdleTicks[i];
+		cout << ", system " << cpuSystemTicks[i];
+		cout << ", user " << cpuUserTicks[i];
+		cout << ", utilization " << used;
+		cout << ", steals " << cpuSteals[i] << "\n";
+    }
     cout << "Disk I/O: reads " << numDiskReads;
 		cout << ", writes " << numDiskWrites << "\n";
+    cout << "Disk scheduling: seek tracks " << numDiskSeekTracks;
+		cout << ", busy ticks " << diskBusyTicks;
+		cout << ", queue ticks " << diskQueueTicks;
+		cout << ", cache hits " << numDiskCacheHits << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
+    cout << "TLB: hits " << numTLBHits << ", misses " << numTLBMisses;
+		cout << ", flushes " << numTLBFlushes << "\n";
+    icache.Print("I-cache");
+    dcache.Print("D-cache");
+    int counted = 0;
+    for (int i = 0; i < NumInstrClasses; i++)
+        counted += numInstrs[i];
+    if (counted > 0) {			// the cost model was in use
+        cout << "Instructions:";
+        for (int i = 0; i < NumInstrClasses; i++)
+            cout << (i == 0 ? " " : ", ") << instrClassNames[i] << " "
+                 << numInstrs[i];
+        cout << "\n";
+        cout << "Instruction cycles:";
+        for (int i = 0; i < NumInstrClasses; i++)
+            cout << (i == 0 ? " " : ", ") << instrClassNames[i] << " "
+                 << instrCycles[i];
+        cout << ", load-use stalls " << numLoadUseStalls << " ("
+             << loadUseCycles << ")\n";
+    }
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    for (int i = 0; i < MaxLinks; i++)
+        links[i].Print(i, totalTicks);
+    if (numMailsDelivered > 0)
+        cout << "Mail: delivered " << numMailsDelivered
+             << ", buffers allocated " << numMailBuffers << "\n";
+    if (numRemoteOpens > 0) {
+        int blocks = numRemoteCacheHits + numRemoteCacheMisses;
+        char perOpen[16], perRead[16], perWrite[16], hitRate[16];
+
+        sprintf(perOpen, "%.2f", (double) numRemoteOpenTrips / numRemoteOpens);
+        sprintf(perRead, "%.2f", numRemoteReads > 0 ?
+                        (double) numRemoteReadTrips / numRemoteReads : 0.0);
+        sprintf(perWrite, "%.2f", numRemoteWrites > 0 ?
+                        (double) numRemoteWriteTrips / numRemoteWrites : 0.0);
+        sprintf(hitRate, "%.1f%%", blocks > 0 ?
+                        100.0 * numRemoteCacheHits / blocks : 0.0);
+        cout << "Remote files: opens " << numRemoteOpens;
+		cout << ", reads " << numRemoteReads;
+		cout << ", writes " << numRemoteWrites << "\n";
+        cout << "Remote round trips per operation: open " << perOpen;
+		cout << ", read " << perRead;
+		cout << ", write " << perWrite << "\n";
+        cout << "Remote block cache: hits " << numRemoteCacheHits;
+		cout << ", misses " << numRemoteCacheMisses;
+		cout << ", hit rate " << hitRate << "\n";
+    }
+    if (numRemoteBreaks > 0)
+        cout << "File server: callbacks broken " << numRemoteBreaks << "\n";
 }
@@ -13,6 +13,50 @@
 
 #include "copyright.h"
 
+// The classes of user instructions, as charged by the cost model
+// ("nachos -cost"; see Machine::SetCosts).  Jumps count as taken
+// branches.
+
+enum InstrClass { InstrALU, InstrMult, InstrDiv, InstrLoad, InstrStore,
+		  InstrTaken, InstrNotTaken, NumInstrClasses };
+
+const int MaxCPUs = 16;		// most CPUs the machine can have
+const int MaxLinks = 16;	// machines with their own link from this
+				// one (see "-link" and NetworkOutput)
+
+// The following class counts the accesses to one of the simulated
+// caches (see cache.h), for the whole machine or for one program.
+
+class CacheStats {
+  public:
+    CacheStats();			// initialize everything to zero
+
+    int reads;				// loads or instruction fetches
+    int readMisses;
+    int writes;				// stores
+    int writeMisses;
+    int writeBacks;			// dirty lines written to memory
+
+    void Print(const char *name);	// one line, if there were accesses
+};
+
+// The following class counts the packets sent over the simulated link
+// to one other machine, when the link is modelled (see "-link").
+
+class LinkStats {
+  public:
+    LinkStats();			// initialize everything to zero
+
+    int packets;			// packets put on the link
+    int bytes;				// and the bytes in them
+    int queueTicks;			// time packets waited to be sent
+    int busyTicks;			// time the link spent sending them
+    int tailDrops;			// packets dropped, the queue full
+    int lossDrops;			// packets lost on the link
+
+    void Print(int to, int totalTicks);	// one line, if it was used
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -27,15 +71,53 @@ class Statistics {
     int idleTicks;       	// Time spent idle (no threads to run)
     int systemTicks;	 	  // Time spent executing system code
     int userTicks;       	// Time spent executing user code
-				// (this is also equal to # of user instructions executed)
+				// (this is also equal to # of user instructions executed,
+				// unless they are charged by class with "-cost")
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numDiskSeekTracks;	// number of tracks the disk head moved across
+    int diskBusyTicks;		// time the disk spent serving requests
+    int diskQueueTicks;		// time requests waited for the disk
+    int numDiskCacheHits;	// sector reads served by the SynchDisk cache
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numTLBHits;		// translations found in the TLB
+    int numTLBMisses;		// translations the kernel had to load
+    int numTLBFlushes;		// times the TLB was emptied
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numMailsDelivered;	// messages the post office put in mailboxes
+    int numMailBuffers;		// Mails it had to allocate for them
+    int numRemoteOpens;		// remote file operations (see remotefs.h)
+    int numRemoteReads;
+    int numRemoteWrites;
+    int numRemoteOpenTrips;	// requests sent to file servers for them
+    int numRemoteReadTrips;
+    int numRemoteWriteTrips;
+    int numRemoteCacheHits;	// remote blocks read from the client cache
+    int numRemoteCacheMisses;	// and from the server
+    int numRemoteBreaks;	// callbacks our file server broke
+    int numInstrs[NumInstrClasses];	// user instructions of each class,
+    int instrCycles[NumInstrClasses];	// and the time they took -- only
+					// kept with the cost model
+    int numLoadUseStalls;	// instructions that waited for a load
+    int loadUseCycles;		// and the time they waited
+    CacheStats icache;		// instruction and data cache accesses,
+    CacheStats dcache;		// if the machine has caches
+    LinkStats links[MaxLinks];	// by the machine at the other end
+
+    // With more than one CPU, each has its own clock and tick counts;
+    // the fields above are those of the CPU being simulated, and
+    // these of the others (see Scheduler).  At Halt, the fields above
+    // become the totals.
+    int numCPUs;
+    int cpuTotalTicks[MaxCPUs];
+    int cpuIdleTicks[MaxCPUs];
+    int cpuSystemTicks[MaxCPUs];
+    int cpuUserTicks[MaxCPUs];
+    int cpuSteals[MaxCPUs];	// threads taken from other CPUs' lists
 
     Statistics(); 		// initialize everything to zero
 
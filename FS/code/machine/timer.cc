@@ -82,7 +82,9 @@ Timer::SetInterrupt()
        if (randomize) {
 	     delay = 1 + (RandomNumber() % (TimerTicks * 2));
         }
-       // schedule the next timer device interrupt
-       kernel->interrupt->Schedule(this, delay, TimerInt);
+       // schedule the next timer device interrupt; with no thread
+       // to run, it has nothing to do, so while the machine is idle
+       // it counts as a poll (of no host file)
+       kernel->interrupt->SchedulePoll(this, delay, TimerInt, -1);
     }
 }
@@ -0,0 +1,391 @@
+// tracer.cc
+//	Routines to record kernel events in a ring buffer, write them to
+//	a file, and convert that file for a timeline viewer.  See
+//	tracer.h for what is recorded.
+//
+//	A trace file holds a TraceHeader, the records (oldest first) and
+//	then the thread names.
+
+#include "copyright.h"
+#include "tracer.h"
+#include "main.h"
+
+typedef struct {
+    int magic;			// TraceMagic
+    int numRecords;		// # of TraceRecords that follow
+    int dropped;		// # overwritten before the dump
+    int numNames;		// # of TraceNames after the records
+} TraceHeader;
+
+// Categories, as letters for "-tcat", of each TraceEvent
+
+static char traceCategory[NumTraceEvents] = { 't', 't', 'i', 'd', 'd', 'u' };
+
+static const char *traceIntNames[] = { "timer", "disk", "console write",
+				       "console read", "network send",
+				       "network recv" };
+static const char *traceExceptionNames[] = { "no exception", "syscall",
+				"page fault", "page read only", "bus error",
+				"address error", "overflow",
+				"illegal instruction" };
+
+const int TraceIntTrack = 1000;		// Chrome "tid" of the interrupt
+const int TraceDiskTrack = 1001;	// and disk tracks; CPUs are 0..
+
+//----------------------------------------------------------------------
+// Tracer::Tracer
+// 	Start recording events.
+//
+//	"fileName" -- where Dump writes the trace
+//	"size" -- records in the ring buffer; rounded up to a power of 2
+//	"categories" -- letters of the categories to record (tracer.h)
+//----------------------------------------------------------------------
+
+Tracer::Tracer(const char *fileName, int size, const char *categories)
+{
+    ASSERT(size > 0);
+    this->fileName = fileName;
+    for (this->size = 1; this->size < (unsigned) size; this->size <<= 1)
+        ;
+    ring = new TraceRecord[this->size];
+    next = 0;
+    for (int i = 0; i < NumTraceEvents; i++)
+        enabled[i] = (strchr(categories, traceCategory[i]) != NULL);
+    names = new List<TraceName *>;
+}
+
+//----------------------------------------------------------------------
+// Tracer::~Tracer
+//----------------------------------------------------------------------
+
+Tracer::~Tracer()
+{
+    delete [] ring;
+    while (!names->IsEmpty())
+        delete names->RemoveFront();
+    delete names;
+}
+
+//----------------------------------------------------------------------
+// Tracer::Record
+// 	Append an event to the ring buffer, overwriting the oldest one
+//	if it is full.  See TraceEvent for the meaning of the arguments.
+//----------------------------------------------------------------------
+
+void
+Tracer::Record(TraceEvent type, int arg0, int arg1)
+{
+    TraceRecord *record;
+
+    if (!enabled[type])
+        return;
+    record = &ring[next++ & (size - 1)];
+    record->when = kernel->stats->totalTicks;
+    record->thread = kernel->currentThread->getID();
+    record->type = type;
+    record->cpu = kernel->scheduler->CurrentCPU();
+    record->arg[0] = arg0;
+    record->arg[1] = arg1;
+}
+
+//----------------------------------------------------------------------
+// Tracer::NameThread
+// 	Remember the name of a new thread, so that the timeline can show
+//	names rather than IDs.  Characters that would need quoting in
+//	the JSON are replaced.
+//----------------------------------------------------------------------
+
+void
+Tracer::NameThread(int id, const char *name)
+{
+    TraceName *entry = new TraceName;
+
+    bzero((char *) entry, sizeof(TraceName));
+    entry->id = id;
+    strncpy(entry->name, name, TraceNameLength - 1);
+    for (char *c = entry->name; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\' || *c < ' ')
+            *c = '_';
+    }
+    names->Append(entry);
+}
+
+//----------------------------------------------------------------------
+// Tracer::Dump
+// 	Write the trace out: the header, the records still in the ring
+//	buffer, oldest first, and the thread names.
+//----------------------------------------------------------------------
+
+void
+Tracer::Dump()
+{
+    ListIterator<TraceName *> iter(names);
+    TraceHeader header;
+    unsigned int first;
+    int fd;
+
+    header.magic = TraceMagic;
+    header.numRecords = (next < size) ? next : size;
+    header.dropped = next - header.numRecords;
+    header.numNames = names->NumInList();
+
+    fd = OpenForWrite(fileName);
+    WriteFile(fd, (char *) &header, sizeof(header));
+    first = next - header.numRecords;
+    if ((first & (size - 1)) + header.numRecords <= size) {
+        WriteFile(fd, (char *) &ring[first & (size - 1)],
+                  header.numRecords * sizeof(TraceRecord));
+    } else {				// wrapped around
+        WriteFile(fd, (char *) &ring[first & (size - 1)],
+                  (size - (first & (size - 1))) * sizeof(TraceRecord));
+        WriteFile(fd, (char *) ring, (next & (size - 1)) * sizeof(TraceRecord));
+    }
+    for (; !iter.IsDone(); iter.Next())
+        WriteFile(fd, (char *) iter.Item(), sizeof(TraceName));
+    Close(fd);
+    cout << "Trace of " << header.numRecords << " events written to "
+         << fileName;
+    if (header.dropped > 0)
+        cout << " (" << header.dropped << " older ones overwritten; see -tsize)";
+    cout << "\n";
+}
+
+//----------------------------------------------------------------------
+// JSONWriter
+// 	Buffers the text of the JSON file, since there is a line for
+//	every event.
+//----------------------------------------------------------------------
+
+class JSONWriter {
+  public:
+    JSONWriter(int fd) { this->fd = fd; used = 0; first = TRUE; }
+    ~JSONWriter() { Flush(); }
+
+    void Event(const char *text);	// Add one event object
+    void Flush() { WriteFile(fd, buffer, used); used = 0; }
+
+  private:
+    int fd;
+    char buffer[65536];
+    int used;
+    bool first;				// No comma before the first event
+};
+
+void
+JSONWriter::Event(const char *text)
+{
+    int length = strlen(text);
+
+    if (used + length + 3 > (int) sizeof(buffer))
+        Flush();
+    if (!first)
+        buffer[used++] = ',';
+    first = FALSE;
+    strcpy(&buffer[used], text);
+    used += length;
+    buffer[used++] = '\n';
+}
+
+//----------------------------------------------------------------------
+// TraceNameCompare
+// 	Order thread names by ID, for qsort.  Threads can share an ID;
+//	the one named first (lower in the file) sorts first.
+//----------------------------------------------------------------------
+
+static int
+TraceNameCompare(const void *a, const void *b)
+{
+    const TraceName *x = *(const TraceName * const *) a;
+    const TraceName *y = *(const TraceName * const *) b;
+
+    if (x->id != y->id)
+        return (x->id < y->id) ? -1 : 1;
+    return (x < y) ? -1 : (x > y);
+}
+
+//----------------------------------------------------------------------
+// FindTraceName
+// 	Return the name of thread "id" from "byId", the thread names
+//	sorted by TraceNameCompare, or NULL if it was never named.
+//----------------------------------------------------------------------
+
+static char *
+FindTraceName(TraceName **byId, int numNames, int id)
+{
+    int low = 0, high = numNames, middle;
+
+    while (low < high) {		// the first with ID >= "id"
+        middle = (low + high) / 2;
+        if (byId[middle]->id < id)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low < numNames && byId[low]->id == id)
+        return byId[low]->name;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Tracer::Export
+// 	Convert a trace written by Dump to the Chrome trace event format
+//	(JSON).  Each CPU gets a track, on which the thread it runs is a
+//	"B"/"E" slice and exceptions are instant events; interrupts and
+//	disk requests get a track each.
+//
+//	"traceName" -- the trace
+//	"jsonName" -- the file to write
+//----------------------------------------------------------------------
+
+bool
+Tracer::Export(const char *traceName, const char *jsonName)
+{
+    TraceHeader header;
+    TraceRecord *records;
+    TraceName *threads, **byId;
+    int fd, fileSize, maxCPU = 0, last = 0;
+    int running[256];			// thread on each CPU, -1 if none
+    char line[256];
+    JSONWriter *out;
+
+    fd = OpenForReadWrite(traceName, FALSE);
+    if (fd < 0)
+        return FALSE;
+    if (ReadPartial(fd, (char *) &header, sizeof(header)) != sizeof(header)
+            || header.magic != TraceMagic) {
+        Close(fd);
+        return FALSE;
+    }
+    // the counts must match the file before they size anything
+    Lseek(fd, 0, SEEK_END);
+    fileSize = Tell(fd) - sizeof(header);
+    Lseek(fd, sizeof(header), SEEK_SET);
+    if (header.numRecords < 0 || header.numNames < 0
+            || header.numRecords > fileSize / (int) sizeof(TraceRecord)
+            || header.numNames > fileSize / (int) sizeof(TraceName)
+            || header.numRecords * sizeof(TraceRecord)
+                + header.numNames * sizeof(TraceName) != (size_t) fileSize) {
+        Close(fd);
+        return FALSE;
+    }
+    records = new TraceRecord[header.numRecords];
+    threads = new TraceName[header.numNames];
+    if (ReadPartial(fd, (char *) records,
+                header.numRecords * sizeof(TraceRecord))
+                    != (int) (header.numRecords * sizeof(TraceRecord))
+            || ReadPartial(fd, (char *) threads,
+                header.numNames * sizeof(TraceName))
+                    != (int) (header.numNames * sizeof(TraceName))) {
+        Close(fd);
+        delete [] records;
+        delete [] threads;
+        return FALSE;
+    }
+    Close(fd);
+
+    // look thread names up by ID, rather than searching for each switch
+    byId = new TraceName *[header.numNames];
+    for (int n = 0; n < header.numNames; n++) {
+        threads[n].name[TraceNameLength - 1] = '\0';
+        byId[n] = &threads[n];
+    }
+    qsort(byId, header.numNames, sizeof(TraceName *), TraceNameCompare);
+
+    fd = OpenForWrite(jsonName);
+    WriteFile(fd, "{\"traceEvents\":[\n", 17);
+    out = new JSONWriter(fd);
+
+    for (int i = 0; i < 256; i++)
+        running[i] = -1;
+    for (int i = 0; i < header.numRecords; i++) {
+        TraceRecord *r = &records[i];
+        int cpu = r->cpu;
+        char *name = NULL;
+
+        if (r->cpu > maxCPU)
+            maxCPU = r->cpu;
+        last = r->when;
+        switch (r->type) {
+          case TraceDispatch:
+            cpu = r->arg[0] & 255;
+            if (cpu > maxCPU)
+                maxCPU = cpu;
+            // fall through: the idle CPU switches to the thread
+          case TraceSwitch:
+            if (running[cpu] >= 0) {
+                sprintf(line, "{\"ph\":\"E\",\"ts\":%d,\"pid\":0,\"tid\":%d}",
+                        r->when, cpu);
+                out->Event(line);
+            }
+            running[cpu] = r->arg[1];
+            if (running[cpu] < 0)
+                break;
+            name = FindTraceName(byId, header.numNames, running[cpu]);
+            if (name != NULL)
+                sprintf(line, "{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%d,"
+                        "\"pid\":0,\"tid\":%d}", name, r->when, cpu);
+            else
+                sprintf(line, "{\"name\":\"thread %d\",\"ph\":\"B\",\"ts\":%d,"
+                        "\"pid\":0,\"tid\":%d}", running[cpu], r->when, cpu);
+            out->Event(line);
+            break;
+          case TraceInterrupt:
+            sprintf(line, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%d,"
+                    "\"pid\":0,\"tid\":%d}",
+                    (r->arg[0] >= 0 && r->arg[0] < 6) ?
+                        traceIntNames[r->arg[0]] : "interrupt",
+                    r->when, TraceIntTrack);
+            out->Event(line);
+            break;
+          case TraceDiskRead:
+          case TraceDiskWrite:
+            sprintf(line, "{\"name\":\"%s %d\",\"ph\":\"X\",\"ts\":%d,"
+                    "\"dur\":%d,\"pid\":0,\"tid\":%d}",
+                    r->type == TraceDiskRead ? "read" : "write", r->arg[0],
+                    r->when, r->arg[1], TraceDiskTrack);
+            out->Event(line);
+            break;
+          case TraceException:
+            if (r->arg[0] == 1)		// SyscallException
+                sprintf(line, "{\"name\":\"syscall %d\",\"ph\":\"i\",\"s\":\"t\","
+                        "\"ts\":%d,\"pid\":0,\"tid\":%d}",
+                        r->arg[1], r->when, cpu);
+            else
+                sprintf(line, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+                        "\"ts\":%d,\"pid\":0,\"tid\":%d,\"args\":{\"addr\":%d}}",
+                        (r->arg[0] >= 0 && r->arg[0] < 8) ?
+                            traceExceptionNames[r->arg[0]] : "exception",
+                        r->when, cpu, r->arg[1]);
+            out->Event(line);
+            break;
+        }
+    }
+
+    // close what is still running, and name the tracks
+    for (int cpu = 0; cpu <= maxCPU; cpu++) {
+        if (running[cpu] >= 0) {
+            sprintf(line, "{\"ph\":\"E\",\"ts\":%d,\"pid\":0,\"tid\":%d}",
+                    last, cpu);
+            out->Event(line);
+        }
+        sprintf(line, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                "\"tid\":%d,\"args\":{\"name\":\"CPU %d\"}}", cpu, cpu);
+        out->Event(line);
+    }
+    sprintf(line, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+            "\"tid\":%d,\"args\":{\"name\":\"interrupts\"}}", TraceIntTrack);
+    out->Event(line);
+    sprintf(line, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+            "\"tid\":%d,\"args\":{\"name\":\"disk\"}}", TraceDiskTrack);
+    out->Event(line);
+    delete out;				// flushes it
+    WriteFile(fd, "]}\n", 3);
+    Close(fd);
+
+    cout << "Converted " << header.numRecords << " events from " << traceName
+         << " to " << jsonName << "\n";
+    delete [] records;
+    delete [] threads;
+    delete [] byId;
+    return TRUE;
+}
@@ -0,0 +1,96 @@
+// tracer.h
+//	Data structures for recording a binary trace of kernel events.
+//
+//	DEBUG messages are fine for following a few hundred events, but
+//	too slow, and too hard to analyze, for a run with millions.  With
+//	"nachos -trace file", events are instead written, as fixed-size
+//	TraceRecords, into a ring buffer in memory ("-tsize" records; once
+//	it is full, the oldest are overwritten).  At Halt the buffer is
+//	dumped to the file, followed by the names of the threads.
+//
+//	The events recorded, by category ("-tcat", default all of them;
+//	the letters are those of the matching DEBUG flags):
+//		t -- a CPU switching threads, or going idle
+//		i -- an interrupt handler being called
+//		d -- a disk request being sent to the disk
+//		u -- a system call or other exception from a user program
+//
+//	"nachos -tj file json" converts a trace to the Chrome trace event
+//	format, which chrome://tracing and ui.perfetto.dev display as a
+//	timeline: one track per CPU showing the thread it runs (with the
+//	system calls it makes), one for interrupts and one for the disk.
+//	Ticks are shown as microseconds.
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "list.h"
+
+enum TraceEvent {
+    TraceSwitch,		// arg0 switched out for arg1 (-1: idle)
+    TraceDispatch,		// idle CPU arg0 given thread arg1
+    TraceInterrupt,		// handler for IntType arg0 called
+    TraceDiskRead,		// sector arg0, taking arg1 ticks
+    TraceDiskWrite,
+    TraceException,		// ExceptionType arg0; arg1 is the system
+				// call code, or the bad address
+    NumTraceEvents
+};
+
+typedef struct {
+    int when;			// totalTicks
+    int thread;			// ID of the current thread
+    unsigned char type;		// TraceEvent
+    unsigned char cpu;		// CPU it happened on
+    int arg[2];			// depend on "type"
+} TraceRecord;
+
+const int TraceMagic = 0x4e545232;	// "NTR2"; "NTRC" files had
+					// 16-bit thread IDs
+const int TraceNameLength = 24;		// bytes kept of each thread name
+const int DefaultTraceSize = 1 << 20;	// records in the ring buffer
+
+// The name of a thread, as written to the trace.
+
+typedef struct {
+    int id;
+    char name[TraceNameLength];
+} TraceName;
+
+class Tracer {
+  public:
+    Tracer(const char *fileName, int size, const char *categories);
+				// Record events of "categories" in a
+				// ring of "size" records, for "fileName"
+    ~Tracer();
+
+    void Record(TraceEvent type, int arg0, int arg1);
+				// Append an event, if its category is on
+    void NameThread(int id, const char *name);
+				// Remember a thread's name for the trace
+    void Dump();		// Write the trace out, at Halt
+
+    static bool Export(const char *traceName, const char *jsonName);
+				// Convert a trace to Chrome trace JSON;
+				// FALSE if it cannot be read
+
+  private:
+    const char *fileName;	// Where Dump writes the trace
+    TraceRecord *ring;		// The last "size" records
+    unsigned int size;		// A power of 2
+    unsigned int next;		// # of records ever appended
+    bool enabled[NumTraceEvents]; // Which events are recorded
+    List<TraceName *> *names;	// Every thread created
+};
+
+// TRACE records an event, if Nachos is tracing.  Like DEBUG, it is a
+// macro so that a run without "-trace" only pays for one test.
+
+#define TRACE(type, arg0, arg1)                                              \
+    if (kernel->tracer == NULL) {} else {                                    \
+        kernel->tracer->Record(type, arg0, arg1);                            \
+    }
+
+#endif // TRACER_H
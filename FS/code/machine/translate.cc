@@ -28,6 +28,7 @@
 
 #include "copyright.h"
 #include "main.h"
+#include "cache.h"
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -84,31 +85,31 @@ bool
 Machine::ReadMem(int addr, int size, int *value)
 {
     int data;
-    ExceptionType exception;
-    int physicalAddress;
+    char *host;
     
     DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-		RaiseException(exception, addr);
-		return FALSE;
+    host = HostAddress(addr, size, FALSE);
+    if (host == NULL) {
+		return FALSE;			// exception already raised
     }
+    if (dcache != NULL)
+        cacheTicks += dcache->Access(host - mainMemory, FALSE, dcacheStats);
     switch (size) {
       case 1:
 		// 22-1223[j]: 取出 主記憶體中的資料(1 byte) 存入 data (因為 mainMemory 的型態是 char *，直接取值 就取 1 byte)
-		data = mainMemory[physicalAddress]; 
+		data = *host; 
 		*value = data;
 		break;
 	
       case 2:
 		// 22-1223[j]: 將陣列元素位址 轉型為「指向 無號short的指標」再取值(2 byte) 存入 data
-		data = *(unsigned short *) &mainMemory[physicalAddress]; 
+		data = *(unsigned short *) host; 
 		*value = ShortToHost(data);
 		break;
 	
       case 4:
-		data = *(unsigned int *) &mainMemory[physicalAddress];
+		data = *(unsigned int *) host;
 		*value = WordToHost(data);
 		break;
 
@@ -135,28 +136,28 @@ Machine::ReadMem(int addr, int size, int *value)
 bool
 Machine::WriteMem(int addr, int size, int value)
 {
-    ExceptionType exception;
-    int physicalAddress;
+    char *host;
      
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-		RaiseException(exception, addr);
-		return FALSE;
+    host = HostAddress(addr, size, TRUE);
+    if (host == NULL) {
+		return FALSE;			// exception already raised
     }
+    if (dcache != NULL)
+        cacheTicks += dcache->Access(host - mainMemory, TRUE, dcacheStats);
     switch (size) {
       case 1:
-		mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+		*host = (unsigned char) (value & 0xff);
 		break;
 
       case 2:
-		*(unsigned short *) &mainMemory[physicalAddress]
+		*(unsigned short *) host
 			= ShortToMachine((unsigned short) (value & 0xffff));
 	  	break;
       
       case 4:
-		*(unsigned int *) &mainMemory[physicalAddress]
+		*(unsigned int *) host
 			= WordToMachine((unsigned int) value);
 		break;
 	
@@ -166,6 +167,70 @@ Machine::WriteMem(int addr, int size, int value)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::HostAddress
+//	Return a pointer to where the "size" bytes at virtual address
+//	"addr" are kept in mainMemory.  If the translation fails, raise
+//	the exception and return NULL.
+//
+//	Going through Translate on every load and store is slow, so
+//	the pages used recently are kept in a small direct-mapped cache
+//	(the "soft TLB").  A hit skips straight to the page in
+//	mainMemory.  Translate has already set the use bit for a cached
+//	page, and the dirty bit too if "writable" is set; a store to a
+//	page cached by a load goes through Translate once, to set it.
+//
+//	The cache is only used with a page table (the kernel can change
+//	the MIPS TLB at any time), and not while address translation is
+//	being traced, so "-d a" output is unchanged.  The kernel must call
+//	FlushSoftTLB when it changes the page table.
+//
+//	"addr" -- the virtual address
+//	"size" -- the number of bytes to be accessed (1, 2, or 4)
+//	"writing" -- if TRUE, the bytes will be written
+//----------------------------------------------------------------------
+
+char *
+Machine::HostAddress(int addr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) addr / PageSize;
+    SoftTLBEntry *cached = &softTLB[vpn % SoftTLBSize];
+    ExceptionType exception;
+    int physicalAddress;
+
+    if (cached->virtualPage == (int) vpn && (cached->writable || !writing)
+            && !(addr & (size - 1)) && pageTable == softTLBTable) {
+        return cached->host + (unsigned) addr % PageSize;
+    }
+
+    exception = Translate(addr, &physicalAddress, size, writing);
+    if (exception != NoException) {
+		RaiseException(exception, addr);
+		return NULL;
+    }
+    if (tlb == NULL && !debug->IsEnabled(dbgAddr)) {
+        if (softTLBTable != pageTable)	// entries of another table
+            FlushSoftTLB();
+        cached->virtualPage = vpn;
+        cached->host = &mainMemory[physicalAddress - physicalAddress % PageSize];
+        cached->writable = writing;
+    }
+    return &mainMemory[physicalAddress];
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushSoftTLB
+//	Forget every translation cached by HostAddress.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushSoftTLB()
+{
+    for (int i = 0; i < SoftTLBSize; i++)
+        softTLB[i].virtualPage = -1;
+    softTLBTable = pageTable;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -224,8 +289,11 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     } 
 	// 23-0127[j]: 採用 TLB，並逐一搜尋 TLB Entry (若有硬體支援，可在O(1)搜尋完畢)
+	// (only the set that can hold the page)
 	else {				
-        for (entry = NULL, i = 0; i < TLBSize; i++)
+        int first = TLBSet(vpn);
+
+        for (entry = NULL, i = first; i < first + tlbWays; i++)
 			// 23-0127[j]: 若 tlb[i] = Valid 
 			//             且 Page Num(virtualPage)等於 virtAddr所在Page 的 Page Num(p)
 			//             則將 entry 指向 tlb entry 的 實體位址
@@ -234,11 +302,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 				break;
 			}
 		if (entry == NULL) {				// TLB miss!
+			kernel->stats->numTLBMisses++;
 			DEBUG(dbgAddr, "Invalid TLB entry for this virtual page!");
 			return PageFaultException;		// really, this is a TLB fault,
 											// the page may be in memory,
 											// but not in the TLB
 		}
+		kernel->stats->numTLBHits++;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -250,7 +320,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) { 
 		DEBUG(dbgAddr, "Illegal pageframe " << pageFrame);
 		return BusErrorException;
     }
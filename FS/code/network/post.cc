@@ -38,18 +38,80 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
     bcopy(msgData, data, mailHdr.length);
 }
 
+//----------------------------------------------------------------------
+// MailPool::MailPool
+//      Initialize an empty pool of Mails; they are allocated as they
+//	are first needed.
+//----------------------------------------------------------------------
+
+MailPool::MailPool()
+{
+    freeList = NULL;
+}
+
+//----------------------------------------------------------------------
+// MailPool::~MailPool
+//      De-allocate the Mails that are not in use.
+//----------------------------------------------------------------------
+
+MailPool::~MailPool()
+{
+    while (freeList != NULL) {
+        Mail *mail = freeList;
+
+        freeList = mail->next;
+        delete mail;
+    }
+}
+
+//----------------------------------------------------------------------
+// MailPool::Allocate
+//      Return a Mail that is not in use, reusing one that has been
+//	freed if there is one.
+//----------------------------------------------------------------------
+
+Mail *
+MailPool::Allocate()
+{
+    Mail *mail = freeList;
+
+    if (mail == NULL) {
+        mail = new Mail();
+        kernel->stats->numMailBuffers++;
+    } else {
+        freeList = mail->next;
+        mail->next = NULL;
+    }
+    return mail;
+}
+
+//----------------------------------------------------------------------
+// MailPool::Free
+//      Put a Mail back in the pool, to be reused.
+//----------------------------------------------------------------------
+
+void
+MailPool::Free(Mail *mail)
+{
+    mail->next = freeList;
+    freeList = mail;
+}
+
 //----------------------------------------------------------------------
 // MailBox::MailBox
 //      Initialize a single mail box within the post office, so that it
 //	can receive incoming messages.
 //
-//	Just initialize a list of messages, representing the mailbox.
+//	Just initialize an empty list of messages, representing the 
+//	mailbox.
 //----------------------------------------------------------------------
 
 
 MailBox::MailBox()
 { 
-    messages = new SynchList<Mail *>(); 
+    lock = new Lock("mailbox lock");
+    arrived = new Condition("mail arrived");
+    first = last = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -62,7 +124,14 @@ MailBox::MailBox()
 
 MailBox::~MailBox()
 { 
-    delete messages; 
+    while (first != NULL) {
+        Mail *mail = first;
+
+        first = mail->next;
+        delete mail;
+    }
+    delete lock;
+    delete arrived;
 }
 
 //----------------------------------------------------------------------
@@ -86,54 +155,49 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 // 	Add a message to the mailbox.  If anyone is waiting for message
 //	arrival, wake them up!
 //
-//	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
-//
-//	"pktHdr" -- source, destination machine ID's
-//	"mailHdr" -- source, destination mailbox ID's
-//	"data" -- payload message data
+//	"mail" -- the message; it is not copied, so the caller must not
+//		use it again
 //----------------------------------------------------------------------
 
 void 
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+MailBox::Put(Mail *mail)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
-
-    messages->Append(mail);		// put on the end of the list of 
-					// arrived messages, and wake up 
-					// any waiters
+    lock->Acquire();
+    mail->next = NULL;			// put on the end of the list of
+    if (first == NULL)			// arrived messages, and wake up
+        first = mail;			// any waiters
+    else
+        last->next = mail;
+    last = mail;
+    arrived->Signal(lock);
+    lock->Release();
 }
 
 //----------------------------------------------------------------------
 // MailBox::Get
-// 	Get a message from a mailbox, parsing it into the packet header,
-//	mailbox header, and data. 
+// 	Take the oldest message out of a mailbox, and return it.
 //
 //	The calling thread waits if there are no messages in the mailbox.
-//
-//	"pktHdr" -- address to put: source, destination machine ID's
-//	"mailHdr" -- address to put: source, destination mailbox ID's
-//	"data" -- address to put: payload message data
 //----------------------------------------------------------------------
 
-void 
-MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
+Mail *
+MailBox::Get() 
 { 
+    Mail *mail;
+
     DEBUG(dbgNet, "Waiting for mail in mailbox");
-    Mail *mail = messages->RemoveFront();	// remove message from list;
-						// will wait if list is empty
+    lock->Acquire();
+    while (first == NULL)		// wait until a message arrives
+        arrived->Wait(lock);
+    mail = first;
+    first = mail->next;
+    lock->Release();
 
-    *pktHdr = mail->pktHdr;
-    *mailHdr = mail->mailHdr;
     if (debug->IsEnabled('n')) {
 	cout << "Got mail from mailbox: ";
-	PrintHeader(*pktHdr, *mailHdr);
+	PrintHeader(mail->pktHdr, mail->mailHdr);
     }
-    bcopy(mail->data, data, mail->mailHdr.length);
-					// copy the message data into
-					// the caller's buffer
-    delete mail;			// we've copied out the stuff we
-					// need, we can now discard the message
+    return mail;
 }
 
 //----------------------------------------------------------------------
@@ -156,8 +220,9 @@ PostOfficeInput::PostOfficeInput(int nBoxes)
 
     numBoxes = nBoxes;
     boxes = new MailBox[nBoxes];
+    pool = new MailPool();
 
-    network = new NetworkInput(this);
+    network = new NetworkInput(this, kernel->sharedNetwork);
 
     Thread *t = new Thread("postal worker", 1);
 
@@ -177,6 +242,7 @@ PostOfficeInput::~PostOfficeInput()
 {
     delete network;
     delete [] boxes;
+    delete pool;
 }
 
 //----------------------------------------------------------------------
@@ -191,27 +257,27 @@ void
 PostOfficeInput::PostalDelivery(void* data)
 {
     PostOfficeInput* _this = (PostOfficeInput*)data;
-    PacketHeader pktHdr;
-    MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
+    Mail *mail;
 
     for (;;) {
         // first, wait for a message
         _this->messageAvailable->P();	
-        pktHdr = _this->network->Receive(buffer);
 
-        mailHdr = *(MailHeader *)buffer;
+        // read it straight into a Mail: the MailHeader, then the data
+        mail = _this->pool->Allocate();
+        mail->pktHdr = _this->network->Receive((char *) &mail->mailHdr);
         if (debug->IsEnabled('n')) {
 	    cout << "Putting mail into mailbox: ";
-	    PrintHeader(pktHdr, mailHdr);
+	    PrintHeader(mail->pktHdr, mail->mailHdr);
         }
 
 	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < _this->numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+	ASSERT(0 <= mail->mailHdr.to && mail->mailHdr.to < _this->numBoxes);
+	ASSERT(mail->mailHdr.length <= MaxMailSize);
 
 	// put into mailbox
-        _this->boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+        kernel->stats->numMailsDelivered++;
+        _this->boxes[mail->mailHdr.to].Put(mail);
     }
 }
 
@@ -234,10 +300,48 @@ void
 PostOfficeInput::Receive(int box, PacketHeader *pktHdr, 
 				MailHeader *mailHdr, char* data)
 {
+    Mail *mail = ReceiveMail(box);
+
+    *pktHdr = mail->pktHdr;
+    *mailHdr = mail->mailHdr;
+    bcopy(mail->data, data, mail->mailHdr.length);
+					// copy the message data into
+					// the caller's buffer
+    FreeMail(mail);			// we've copied out the stuff we
+					// need, we can now reuse the message
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::ReceiveMail
+// 	Like Receive, but return the message itself, so that the caller
+//	can read it where it is rather than having it copied.  The
+//	caller must give it back with FreeMail.
+//
+//	"box" -- mailbox ID in which to look for message
+//----------------------------------------------------------------------
+
+Mail *
+PostOfficeInput::ReceiveMail(int box)
+{
+    Mail *mail;
+
     ASSERT((box >= 0) && (box < numBoxes));
 
-    boxes[box].Get(pktHdr, mailHdr, data);
-    ASSERT(mailHdr->length <= MaxMailSize);
+    mail = boxes[box].Get();
+    ASSERT(mail->mailHdr.length <= MaxMailSize);
+    return mail;
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::FreeMail
+// 	The caller of ReceiveMail is done with "mail"; it can be reused
+//	for the next message that arrives.
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::FreeMail(Mail *mail)
+{
+    pool->Free(mail);
 }
 
 //----------------------------------------------------------------------
@@ -265,10 +369,9 @@ PostOfficeInput::CallBack()
 
 PostOfficeOutput::PostOfficeOutput(double reliability)
 {
-    messageSent = new Semaphore("message sent", 0);
-    sendLock = new Lock("message send lock");
+    messageSent = new Semaphore("message sent", 1);	// the device is idle
 
-    network = new NetworkOutput(reliability, this);
+    network = new NetworkOutput(reliability, this, kernel->sharedNetwork);
 }
 
 //----------------------------------------------------------------------
@@ -280,7 +383,6 @@ PostOfficeOutput::~PostOfficeOutput()
 {
     delete network;
     delete messageSent;
-    delete sendLock;
 }
 
 //----------------------------------------------------------------------
@@ -291,6 +393,11 @@ PostOfficeOutput::~PostOfficeOutput()
 //	Note that the MailHeader + data looks just like normal payload
 //	data to the Network.
 //
+//	The device takes the packet at once, and is then busy for as
+//	long as it takes to send; we only wait for it if the previous
+//	message is still going out, so that the caller's next work
+//	overlaps with the sending.
+//
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
 //	"data" -- payload message data
@@ -299,8 +406,8 @@ PostOfficeOutput::~PostOfficeOutput()
 void
 PostOfficeOutput::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
+    char buffer[MaxPacketSize];		// space to hold concatenated
+					// mailHdr + data
 
     if (debug->IsEnabled('n')) {
 	cout << "Post send: ";
@@ -317,15 +424,10 @@ PostOfficeOutput::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
     bcopy((char *)&mailHdr, buffer, sizeof(MailHeader));
     bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
 
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
+    messageSent->P();			// only one message can be sent
+					// to the network at any one time:
+					// wait for the last one to be done
     network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
-
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
 }
 
 //----------------------------------------------------------------------
@@ -342,3 +444,15 @@ PostOfficeOutput::CallBack()
     messageSent->V();
 }
 
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::SetLinks
+// 	Model the links from the network device to other machines, as
+//	given by "-link".  Return FALSE if "spec" is malformed.
+//----------------------------------------------------------------------
+
+bool
+PostOfficeOutput::SetLinks(char *spec)
+{
+    return network->SetLinks(spec);
+}
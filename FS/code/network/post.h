@@ -61,9 +61,13 @@ class MailHeader {
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// As on the wire, the MailHeader is followed directly by the data, so
+// that an arriving packet can be read straight into a Mail.
 
 class Mail {
   public:
+     Mail() { next = NULL; }	// An empty message, for a MailPool
      Mail(PacketHeader pktH, MailHeader mailH, char *msgData);
 				// Initialize a mail message by
 				// concatenating the headers to the data
@@ -71,26 +75,51 @@ class Mail {
      PacketHeader pktHdr;	// Header appended by Network
      MailHeader mailHdr;	// Header appended by PostOffice
      char data[MaxMailSize];	// Payload -- message data
+
+     Mail *next;		// Next in a mailbox, or in the free list
+};
+
+// The following class keeps the Mails that have been read, so that
+// they can be used again for the next messages rather than being
+// deleted and allocated for each one.  No lock is needed: nothing in
+// Allocate or Free can cause a context switch.
+
+class MailPool {
+  public:
+    MailPool();			// Initialize an empty pool
+    ~MailPool();		// De-allocate the Mails in the pool
+
+    Mail *Allocate();		// A Mail that is not in use; a new one
+				// only if none is free
+    void Free(Mail *mail);	// Put a Mail back, once it has been read
+
+  private:
+    Mail *freeList;		// Mails not in use
 };
 
 // The following class defines a single mailbox, or temporary storage
 // for messages.   Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, and these messages can then be retrieved by
 // threads on this machine.
+//
+// The messages are linked through their "next" field, rather than
+// kept in a List, so that queueing one allocates nothing.
 
 class MailBox {
   public: 
     MailBox();			// Allocate and initialize mail box
     ~MailBox();			// De-allocate mail box
 
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
-   				// Atomically put a message into the mailbox
-    void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
-   				// Atomically get a message out of the 
+    void Put(Mail *mail);	// Atomically put a message into the 
+				// mailbox; the mailbox now owns it
+    Mail *Get();		// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
 				// to get!)
   private:
-    SynchList<Mail *> *messages; // A mailbox is just a list of arrived messages
+    Lock *lock;			// Protects the list of messages
+    Condition *arrived;		// Signalled when a message is put
+    Mail *first;		// Arrived messages, oldest first
+    Mail *last;
 };
 
 // The following two classes defines a "Post Office", or a collection of 
@@ -111,6 +140,9 @@ class PostOfficeInput : public CallBackObj {
 		MailHeader *mailHdr, char *data);
     				// Retrieve a message from "box".  Wait if
 				// there is no message in the box.
+    Mail *ReceiveMail(int box);	// The same, but return the message
+				// itself rather than copying it out
+    void FreeMail(Mail *mail);	// Done with a message from ReceiveMail
 
     static void PostalDelivery(void* data);
 				// Wait for incoming messages, 
@@ -124,6 +156,7 @@ class PostOfficeInput : public CallBackObj {
     NetworkInput *network;	// Physical network connection
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
+    MailPool *pool;		// Mails for incoming messages
     Semaphore *messageAvailable;// V'ed when message has arrived from network
 };
 
@@ -142,10 +175,13 @@ class PostOfficeOutput : public CallBackObj {
 
     void CallBack();		// Called when outgoing packet has been 
 				// put on network; next packet can now be sent
+
+    bool SetLinks(char *spec);	// Model the links to other machines
+				// (see NetworkOutput::SetLinks)
     
   private:
     NetworkOutput *network;	// Physical network connection
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    Semaphore *messageSent;	// V'ed when next message can be sent to
+				// network; 1 while the device is idle
 };
 #endif
@@ -0,0 +1,876 @@
+// remotefs.cc
+//	Routines to share files between Nachos machines: a file server,
+//	and a client that caches what it reads from servers.  See
+//	remotefs.h for the protocol and for how callbacks keep the caches
+//	consistent.
+
+#include "copyright.h"
+#include "remotefs.h"
+#include "main.h"
+#include "filesys.h"
+
+#ifndef FILESYS_STUB
+
+//----------------------------------------------------------------------
+// FileServer::FileServer
+// 	Start a thread answering requests for our files.  Like the
+//	postal worker, it runs for as long as Nachos does.
+//----------------------------------------------------------------------
+
+FileServer::FileServer()
+{
+    ASSERT(kernel->postOfficeIn != NULL);
+    numFiles = 0;
+    for (int i = 0; i < RemoteMaxClients; i++)
+        replies[i].host = -1;
+    nextReply = 0;
+    dropWriteReplies = 0;
+
+    Thread *t = new Thread("file server", 1);
+
+    t->Fork(FileServer::ServeLoop, this);
+}
+
+//----------------------------------------------------------------------
+// FileServer::ServeLoop
+// 	Body of the server thread: answer each request in turn.  A
+//	request that is not well formed is ignored, as is a RemoteBroken,
+//	which is not answered.  A request that is the same as the last
+//	one from its machine was sent again because the reply was lost:
+//	it is answered with that reply, not carried out again.
+//----------------------------------------------------------------------
+
+void
+FileServer::ServeLoop(void *server)
+{
+    FileServer *_this = (FileServer *) server;
+    char message[MaxMailSize];
+    RemoteRequest request;
+    RemoteReply reply;
+    RemoteLastReply *last;
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    Mail *mail;
+
+    for (;;) {
+        mail = kernel->postOfficeIn->ReceiveMail(RemoteServerBox);
+        bcopy(mail->data, (char *) &request, sizeof(RemoteRequest));
+        if (mail->mailHdr.length != sizeof(RemoteRequest) + request.length) {
+            kernel->postOfficeIn->FreeMail(mail);
+            continue;
+        }
+        if (request.op == RemoteBroken) {
+            _this->Broken(mail->pktHdr.from, &request);
+            kernel->postOfficeIn->FreeMail(mail);
+            continue;
+        }
+
+        pktHdr.to = mail->pktHdr.from;
+        mailHdr.from = RemoteServerBox;
+        last = _this->LastReply(mail->pktHdr.from);
+        if (last->length > 0 && last->request.xid == request.xid
+                && last->request.op == request.op
+                && last->request.length == request.length
+                && last->request.handle == request.handle
+                && last->request.offset == request.offset) {
+            DEBUG(dbgNet, "File server answers request " << request.xid
+                          << " from " << pktHdr.to << " again");
+            mailHdr.to = last->box;
+            mailHdr.length = last->length;
+            kernel->postOfficeIn->FreeMail(mail);
+            kernel->postOfficeOut->Send(pktHdr, mailHdr, last->message);
+            continue;
+        }
+        last->request = request;	// before Serve changes it
+
+        bzero((char *) &reply, sizeof(RemoteReply));
+        reply.xid = request.xid;
+        _this->Serve(mail->pktHdr.from, &request,
+                     mail->data + sizeof(RemoteRequest), &reply,
+                     message + sizeof(RemoteReply));
+        bcopy((char *) &reply, message, sizeof(RemoteReply));
+
+        mailHdr.to = mail->mailHdr.from;
+        mailHdr.length = sizeof(RemoteReply) + reply.length;
+        kernel->postOfficeIn->FreeMail(mail);
+        last->box = mailHdr.to;
+        last->length = mailHdr.length;
+        bcopy(message, last->message, mailHdr.length);
+        if (request.op == RemoteWrite && reply.status == RemoteOK
+                && _this->dropWriteReplies > 0) {
+            _this->dropWriteReplies--;		// as if the network lost it
+            continue;
+        }
+        kernel->postOfficeOut->Send(pktHdr, mailHdr, message);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileServer::LastReply
+// 	Return where the last reply to machine "host" is kept: a slot of
+//	its own, or, the first time it asks, one that has not been used,
+//	or else the next in turn.
+//----------------------------------------------------------------------
+
+RemoteLastReply *
+FileServer::LastReply(NetworkAddress host)
+{
+    RemoteLastReply *last;
+
+    for (int i = 0; i < RemoteMaxClients; i++) {
+        if (replies[i].host == host)
+            return &replies[i];
+    }
+    for (int i = 0; i < RemoteMaxClients; i++) {
+        if (replies[i].host < 0) {
+            nextReply = i;
+            break;
+        }
+    }
+    last = &replies[nextReply];
+    nextReply = (nextReply + 1) % RemoteMaxClients;
+    last->host = host;
+    last->length = 0;
+    return last;
+}
+
+//----------------------------------------------------------------------
+// FileServer::Serve
+// 	Carry out a request from machine "from", and fill in the reply.
+//	Every successful reply carries the file's length and version,
+//	and grants a callback on the file if it can.
+//
+//	"data" -- what follows the request header
+//	"replyData" -- where to put what follows the reply header
+//----------------------------------------------------------------------
+
+void
+FileServer::Serve(NetworkAddress from, RemoteRequest *request, char *data,
+                  RemoteReply *reply, char *replyData)
+{
+    ServedFile *served;
+
+    reply->status = RemoteError;
+    if (request->op == RemoteOpen) {
+        char path[RemoteMaxPath + 1];
+
+        if (request->length > RemoteMaxPath)
+            return;
+        bcopy(data, path, request->length);
+        path[request->length] = '\0';
+        request->handle = Lookup(path);
+        bcopy((char *) &request->handle, replyData, sizeof(int));
+        reply->length = sizeof(int);
+    }
+    if (request->handle < 0 || request->handle >= numFiles)
+        return;
+    served = &files[request->handle];
+    reply->fileLength = served->file->Length();
+
+    switch (request->op) {
+      case RemoteRead:
+        if (request->offset < 0 || request->offset >= reply->fileLength)
+            return;
+        reply->length = served->file->ReadAt(replyData, RemoteBlockSize,
+                                             request->offset);
+        break;
+      case RemoteWrite:
+        // the write must wait until no other machine can be reading
+        // what it changes from its cache
+        if (BreakCallbacks(served, request->handle, from)) {
+            DEBUG(dbgNet, "File server delays a write from " << from);
+            served->writer = from;
+            served->refused = 0;
+            reply->status = RemoteBusy;
+            reply->value = RemoteTimeout;
+            reply->version = served->version;
+            return;
+        }
+        if (request->offset < 0 || served->file->WriteAt(data,
+                        request->length, request->offset) != request->length)
+            return;
+        served->version++;
+        served->writer = -1;
+        break;
+    }
+    reply->status = RemoteOK;
+    reply->version = served->version;
+    reply->value = Register(served, from);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Lookup
+// 	Return the handle of the file "path", opening it the first time
+//	it is asked for.  Return -1 if it cannot be opened.
+//----------------------------------------------------------------------
+
+int
+FileServer::Lookup(char *path)
+{
+    ServedFile *served;
+    OpenFile *file;
+
+    for (int i = 0; i < numFiles; i++) {
+        if (strcmp(files[i].path, path) == 0)
+            return i;
+    }
+    if (numFiles == RemoteMaxFiles)
+        return -1;
+    file = kernel->fileSystem->Open(path);
+    if (file == NULL)
+        return -1;
+
+    served = &files[numFiles];
+    strcpy(served->path, path);
+    served->file = file;
+    served->version = 0;
+    for (int i = 0; i < RemoteMaxHolders; i++) {
+        served->holder[i] = -1;
+        served->breaks[i] = 0;
+    }
+    served->writer = -1;
+    served->refused = 0;
+    DEBUG(dbgNet, "File server opened " << path << " as " << numFiles);
+    return numFiles++;
+}
+
+//----------------------------------------------------------------------
+// FileServer::Register
+// 	Give machine "host" a callback on a file, if it does not hold
+//	one already.  Return 1 if it holds one now, 0 if it may not
+//	cache the file: too many other machines hold callbacks on it, or
+//	a write is waiting for them to be dropped (new ones, given to
+//	machines reading the file all the while, would keep it waiting
+//	for ever).  If the writer does not try again before other
+//	machines have been refused RemoteMaxRefusals times, it is taken
+//	to have gone away, and the write is no longer waited for.
+//----------------------------------------------------------------------
+
+int
+FileServer::Register(ServedFile *served, NetworkAddress host)
+{
+    int slot = -1;
+
+    if (served->writer >= 0) {
+        if (host == served->writer || ++served->refused < RemoteMaxRefusals)
+            return 0;
+        DEBUG(dbgNet, "File server gives up on " << served->writer
+                      << "'s write to " << served->path);
+        served->writer = -1;
+    }
+    for (int i = 0; i < RemoteMaxHolders; i++) {
+        if (served->holder[i] == host)
+            slot = i;
+    }
+    for (int i = 0; i < RemoteMaxHolders && slot < 0; i++) {
+        if (served->holder[i] < 0)
+            slot = i;
+    }
+    if (slot < 0)
+        return 0;
+    served->holder[slot] = host;
+    return 1;
+}
+
+//----------------------------------------------------------------------
+// FileServer::BreakCallbacks
+// 	Ask every machine but "host" that holds a callback on a file to
+//	drop it, before a write from "host" changes the file.  The break
+//	carries the version the write will give the file.  Return FALSE
+//	if no other machine holds a callback.
+//
+//	Breaks are sent again each time the writer tries again, since
+//	they or the answers may be lost; a machine that has left
+//	RemoteMaxBreaks of them unanswered is forgotten.
+//
+//	"handle" -- the file's handle, by which the machines know it
+//----------------------------------------------------------------------
+
+bool
+FileServer::BreakCallbacks(ServedFile *served, int handle,
+                           NetworkAddress host)
+{
+    RemoteReply message;
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    bool waiting = FALSE;
+
+    bzero((char *) &message, sizeof(RemoteReply));
+    message.status = RemoteBreak;
+    message.value = handle;
+    message.version = served->version + 1;
+    mailHdr.to = RemoteClientBox;
+    mailHdr.from = RemoteServerBox;
+    mailHdr.length = sizeof(RemoteReply);
+
+    for (int i = 0; i < RemoteMaxHolders; i++) {
+        if (served->holder[i] < 0 || served->holder[i] == host)
+            continue;
+        if (served->breaks[i] == RemoteMaxBreaks) {
+            DEBUG(dbgNet, "File server gives up on " << served->holder[i]
+                          << "'s callback on " << served->path);
+            served->holder[i] = -1;
+            served->breaks[i] = 0;
+            continue;
+        }
+        served->breaks[i]++;
+        kernel->stats->numRemoteBreaks++;
+        pktHdr.to = served->holder[i];
+        kernel->postOfficeOut->Send(pktHdr, mailHdr, (char *) &message);
+        waiting = TRUE;
+    }
+    return waiting;
+}
+
+//----------------------------------------------------------------------
+// FileServer::Broken
+// 	Machine "host" has dropped its callback on a file.  An answer to
+//	an earlier break, that comes after the machine has been given
+//	a new callback or is being asked to drop a newer one, is
+//	ignored.
+//----------------------------------------------------------------------
+
+void
+FileServer::Broken(NetworkAddress host, RemoteRequest *request)
+{
+    ServedFile *served;
+
+    if (request->handle < 0 || request->handle >= numFiles)
+        return;
+    served = &files[request->handle];
+    if (request->offset != served->version + 1)
+        return;
+    for (int i = 0; i < RemoteMaxHolders; i++) {
+        if (served->holder[i] == host && served->breaks[i] > 0) {
+            served->holder[i] = -1;
+            served->breaks[i] = 0;
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// FileServer::SelfTest
+// 	Check that a write whose reply is lost is done only once.  This
+//	machine writes a block of a file of its own through its client,
+//	over the network to its own server, which throws the reply to
+//	the write away; the client sends the write again, under the same
+//	xid, and should be answered with the reply kept from the first
+//	time.  (It may send it more than twice: the server's disk runs
+//	on the same clock as the client's timer.)  The file should then
+//	have had one write, and hold the block.  Run by "nachos -rfst".
+//----------------------------------------------------------------------
+
+void
+FileServer::SelfTest()
+{
+    char name[] = "/rfstest", path[40];
+    char block[RemoteBlockSize], check[RemoteBlockSize];
+    OpenFile *file;
+    int trips, written, handle;
+    bool ok;
+
+    ASSERT(kernel->remoteFiles != NULL);
+    if (!kernel->fileSystem->Create(name, RemoteBlockSize, 0)) {
+        cout << "Remote file test: cannot create " << name << "\n";
+        return;
+    }
+    sprintf(path, "%s%d%s", RemotePrefix, (int) kernel->hostName, name);
+    file = kernel->remoteFiles->Open(path);
+    ASSERT(file != NULL);
+    for (int i = 0; i < (int) RemoteBlockSize; i++)
+        block[i] = 'a' + i % 26;
+
+    trips = kernel->stats->numRemoteWriteTrips;
+    dropWriteReplies = 1;
+    written = file->WriteAt(block, RemoteBlockSize, 0);
+    trips = kernel->stats->numRemoteWriteTrips - trips;
+    delete file;
+
+    handle = Lookup(name);
+    file = kernel->fileSystem->Open(name);
+    ok = (file->ReadAt(check, RemoteBlockSize, 0) == (int) RemoteBlockSize
+          && memcmp(block, check, RemoteBlockSize) == 0);
+    delete file;
+
+    cout << "Remote file test: write sent " << trips << " times, done "
+         << files[handle].version << " time(s); " << written
+         << " bytes written, file " << (ok ? "holds them" : "is WRONG")
+         << "\n";
+    if (trips > 1 && files[handle].version == 1 && written == RemoteBlockSize
+            && ok)
+        cout << "Remote file test passed\n";
+    else
+        cout << "Remote file test FAILED\n";
+    kernel->fileSystem->Remove(name);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::RemoteFileClient
+// 	Start a thread taking replies from file servers in.  Like the
+//	postal worker, it runs for as long as Nachos does.
+//----------------------------------------------------------------------
+
+RemoteFileClient::RemoteFileClient()
+{
+    ASSERT(kernel->postOfficeIn != NULL);
+    lock = new Lock("remote file client");
+    answered = new Semaphore("remote file reply", 0);
+    waiting = FALSE;
+    gotReply = FALSE;
+    lastXid = 0;
+    callHost = -1;
+    deadline = 0;
+    files = new List<RemoteFileInfo *>;
+    cache = new RemoteBlock[RemoteCacheBlocks];
+    for (int i = 0; i < RemoteCacheBlocks; i++)
+        cache[i].valid = FALSE;
+    clock = 0;
+
+    Thread *t = new Thread("remote file receiver", 1);
+
+    t->Fork(RemoteFileClient::ReceiveLoop, this);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::Open
+// 	Open "path", which must be of the form "/net/<machine>/<path>".
+//	Return NULL if it is not, or if the server has no such file.
+//----------------------------------------------------------------------
+
+OpenFile *
+RemoteFileClient::Open(char *path)
+{
+    RemoteRequest request;
+    RemoteFileInfo *info = NULL;
+    NetworkAddress host;
+    char *name;
+    int handle;
+
+    if (strncmp(path, RemotePrefix, strlen(RemotePrefix)) != 0)
+        return NULL;
+    host = atoi(path + strlen(RemotePrefix));
+    name = strchr(path + strlen(RemotePrefix), '/');
+    if (name == NULL || strlen(name) > RemoteMaxPath)
+        return NULL;
+
+    lock->Acquire();
+    kernel->stats->numRemoteOpens++;
+    request.op = RemoteOpen;
+    request.length = strlen(name);
+    request.handle = -1;
+    request.offset = 0;
+    Call(host, &request, name);
+    if (reply.status != RemoteOK) {
+        lock->Release();
+        return NULL;
+    }
+    bcopy(replyData, (char *) &handle, sizeof(int));
+
+    // every open of the same file shares what we know about it
+    ListIterator<RemoteFileInfo *> iter(files);
+    for (; !iter.IsDone(); iter.Next()) {
+        if (iter.Item()->host == host && iter.Item()->handle == handle)
+            info = iter.Item();
+    }
+    if (info == NULL) {
+        info = new RemoteFileInfo;
+        info->host = host;
+        info->handle = handle;
+        info->version = reply.version;
+        info->callback = FALSE;
+        files->Append(info);
+    }
+    info->length = reply.fileLength;
+    GotCallback(info);
+    lock->Release();
+    return new RemoteFile(this, info);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::ReadAt
+// 	Read part of a remote file, block by block, from the cache where
+//	it can be.  Return the number of bytes read.
+//----------------------------------------------------------------------
+
+int
+RemoteFileClient::ReadAt(RemoteFileInfo *file, char *into, int numBytes,
+                         int position)
+{
+    int done = 0;
+
+    if ((numBytes <= 0) || (position < 0) || (position >= file->length))
+        return 0;
+    if ((position + numBytes) > file->length)
+        numBytes = file->length - position;
+
+    lock->Acquire();
+    kernel->stats->numRemoteReads++;
+    while (done < numBytes) {
+        int at = position + done;
+        int offset = at % RemoteBlockSize;
+        RemoteBlock *block = GetBlock(file, at / RemoteBlockSize);
+        int count;
+
+        if (block == NULL || offset >= block->length)
+            break;			// the server could not read it
+        count = min(block->length - offset, numBytes - done);
+        bcopy(&block->data[offset], into + done, count);
+        done += count;
+    }
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::WriteAt
+// 	Write part of a remote file, through to the server, a block (or
+//	part of one) at a time; keep the cached blocks up to date.
+//	Return the number of bytes written.
+//----------------------------------------------------------------------
+
+int
+RemoteFileClient::WriteAt(RemoteFileInfo *file, char *from, int numBytes,
+                          int position)
+{
+    RemoteRequest request;
+    int done = 0;
+
+    if ((numBytes <= 0) || (position < 0) || (position >= file->length))
+        return 0;
+    if ((position + numBytes) > file->length)
+        numBytes = file->length - position;
+
+    lock->Acquire();
+    kernel->stats->numRemoteWrites++;
+    while (done < numBytes) {
+        int at = position + done;
+        int block = at / RemoteBlockSize;
+        int offset = at % RemoteBlockSize;
+        int count = min((int) RemoteBlockSize - offset, numBytes - done);
+
+        request.op = RemoteWrite;
+        request.length = count;
+        request.handle = file->handle;
+        request.offset = at;
+        Call(file->host, &request, from + done);
+        if (reply.status != RemoteOK)
+            break;
+
+        for (int i = 0; i < RemoteCacheBlocks; i++) {
+            RemoteBlock *cached = &cache[i];
+
+            if (!cached->valid || cached->file != file
+                    || cached->version != file->version)
+                continue;
+            if (cached->block == block)		// now holds what we wrote
+                bcopy(from + done, &cached->data[offset], count);
+            // if ours is the only write since, the rest are still good
+            if (reply.version == file->version + 1)
+                cached->version = reply.version;
+        }
+        GotCallback(file);
+        done += count;
+    }
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::GetBlock
+// 	Return block "block" of "file": from the cache, if we hold a
+//	callback on the file and it has not been written since the block
+//	was read; otherwise from the server, into the cache.  Return
+//	NULL if the server cannot read the block.
+//----------------------------------------------------------------------
+
+RemoteBlock *
+RemoteFileClient::GetBlock(RemoteFileInfo *file, int block)
+{
+    RemoteBlock *found = NULL, *victim = &cache[0];
+    RemoteRequest request;
+
+    for (int i = 0; i < RemoteCacheBlocks; i++) {
+        RemoteBlock *cached = &cache[i];
+
+        if (cached->valid && cached->file == file && cached->block == block)
+            found = cached;
+        if (victim->valid && (!cached->valid
+                              || cached->lastUse < victim->lastUse))
+            victim = cached;
+    }
+
+    if (found != NULL && file->callback && found->version == file->version) {
+        kernel->stats->numRemoteCacheHits++;
+        found->lastUse = ++clock;
+        return found;
+    }
+
+    kernel->stats->numRemoteCacheMisses++;
+    request.op = RemoteRead;
+    request.length = 0;
+    request.handle = file->handle;
+    request.offset = block * RemoteBlockSize;
+    Call(file->host, &request, NULL);
+    if (reply.status != RemoteOK)
+        return NULL;
+    GotCallback(file);
+
+    if (found == NULL)
+        found = victim;
+    found->valid = TRUE;
+    found->file = file;
+    found->block = block;
+    found->version = reply.version;
+    found->length = reply.length;
+    found->lastUse = ++clock;
+    bcopy(replyData, found->data, reply.length);
+    return found;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::GotCallback
+// 	Note the version of "file", and whether we hold a callback on it,
+//	from the reply just received.  A reply older than a break we
+//	have had since says nothing of the file as it is now.
+//----------------------------------------------------------------------
+
+void
+RemoteFileClient::GotCallback(RemoteFileInfo *file)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    if (reply.version >= file->version) {
+        file->version = reply.version;
+        file->callback = (reply.value != 0);
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::Break
+// 	The server on machine "host" breaks our callback on a file:
+//	stop using its cached blocks, which may be older than the
+//	version the break carries.  Return FALSE if we do not know the
+//	file yet (the reply opening it is still on its way); the break
+//	is left unanswered, and the server will send it again.
+//
+//	Called with interrupts off, so that it cannot come between a
+//	reply and GotCallback.
+//----------------------------------------------------------------------
+
+bool
+RemoteFileClient::Break(NetworkAddress host, RemoteReply *message)
+{
+    ListIterator<RemoteFileInfo *> iter(files);
+
+    for (; !iter.IsDone(); iter.Next()) {
+        RemoteFileInfo *file = iter.Item();
+
+        if (file->host == host && file->handle == message->value) {
+            file->version = max(file->version, message->version);
+            file->callback = FALSE;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::Call
+// 	Send a request to the server on machine "host", and wait for
+//	the reply (in "reply" and "replyData").  Send it again, with the
+//	same xid, waiting longer each time, until the reply comes (the
+//	server will not carry it out twice).  If the server is busy, it
+//	has not carried it out: wait (at least as long as it says, and
+//	longer each time) and then start over, as a new request.
+//
+//	"data" -- what follows the request header
+//----------------------------------------------------------------------
+
+void
+RemoteFileClient::Call(NetworkAddress host, RemoteRequest *request,
+                       char *data)
+{
+    char message[MaxMailSize];
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    int timeout = RemoteTimeout;
+
+    ASSERT(request->length <= RemoteMaxPath);
+    pktHdr.to = host;
+    mailHdr.to = RemoteServerBox;
+    mailHdr.from = RemoteClientBox;
+    mailHdr.length = sizeof(RemoteRequest) + request->length;
+
+    request->xid = ++lastXid;
+    for (;;) {
+        bcopy((char *) request, message, sizeof(RemoteRequest));
+        bcopy(data, message + sizeof(RemoteRequest), request->length);
+        switch (request->op) {
+          case RemoteOpen:
+            kernel->stats->numRemoteOpenTrips++;
+            break;
+          case RemoteWrite:
+            kernel->stats->numRemoteWriteTrips++;
+            break;
+          default:
+            kernel->stats->numRemoteReadTrips++;
+            break;
+        }
+
+        callHost = host;
+        waiting = TRUE;
+        kernel->postOfficeOut->Send(pktHdr, mailHdr, message);
+        if (!Wait(timeout)) {
+            DEBUG(dbgNet, "Remote file request " << request->xid
+                          << " to " << host << " timed out");
+            timeout = min(2 * timeout, RemoteMaxTimeout);
+            continue;
+        }
+        if (reply.status != RemoteBusy)
+            return;
+
+        // other machines hold callbacks; no reply can end this wait,
+        // since none has been sent the new xid
+        request->xid = ++lastXid;
+        waiting = TRUE;
+        (void) Wait(max(reply.value, timeout));
+        timeout = min(2 * timeout, RemoteMaxTimeout);
+    }
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::Wait
+// 	Wait for the reply to the request just sent, or for "ticks" to
+//	pass.  Return TRUE if the reply came.
+//
+//	The timer is a timeout (see Interrupt::ScheduleTimeout), so that
+//	an idle machine does not skip ahead to it while the reply, or
+//	the answers to the server's breaks, are still on their way.
+//----------------------------------------------------------------------
+
+bool
+RemoteFileClient::Wait(int ticks)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    if (waiting) {			// the reply may be in already
+        deadline = kernel->stats->totalTicks + ticks;
+        kernel->interrupt->ScheduleTimeout(this, ticks, TimerInt);
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    answered->P();
+    return gotReply;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::CallBack
+// 	The timer went off.  If a request is still waiting, and this is
+//	its timer (not that of an earlier one), give up waiting.
+//----------------------------------------------------------------------
+
+void
+RemoteFileClient::CallBack()
+{
+    if (waiting && kernel->stats->totalTicks >= deadline) {
+        waiting = FALSE;
+        gotReply = FALSE;
+        answered->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// RemoteFileClient::ReceiveLoop
+// 	Body of the thread that takes replies in, and hands the one that
+//	is being waited for to the waiting request.  Others -- answers
+//	to requests that were sent more than once -- are thrown away.
+//	Interrupts are off while it checks, so that the timer cannot
+//	also end the same wait.
+//
+//	Breaks from servers come in here too, and are answered with a
+//	RemoteBroken.
+//----------------------------------------------------------------------
+
+void
+RemoteFileClient::ReceiveLoop(void *client)
+{
+    RemoteFileClient *_this = (RemoteFileClient *) client;
+    RemoteReply header;
+    RemoteRequest broken;
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    IntStatus oldLevel;
+    Mail *mail;
+    bool known;
+
+    for (;;) {
+        mail = kernel->postOfficeIn->ReceiveMail(RemoteClientBox);
+        bcopy(mail->data, (char *) &header, sizeof(RemoteReply));
+
+        oldLevel = kernel->interrupt->SetLevel(IntOff);
+        if (header.status == RemoteBreak) {
+            known = (mail->mailHdr.length == sizeof(RemoteReply))
+                    && _this->Break(mail->pktHdr.from, &header);
+            (void) kernel->interrupt->SetLevel(oldLevel);
+            if (known) {
+                bzero((char *) &broken, sizeof(RemoteRequest));
+                broken.op = RemoteBroken;
+                broken.handle = header.value;
+                broken.offset = header.version;
+                pktHdr.to = mail->pktHdr.from;
+                mailHdr.to = RemoteServerBox;
+                mailHdr.from = RemoteClientBox;
+                mailHdr.length = sizeof(RemoteRequest);
+                kernel->postOfficeOut->Send(pktHdr, mailHdr,
+                                            (char *) &broken);
+            }
+            kernel->postOfficeIn->FreeMail(mail);
+            continue;
+        }
+        if (_this->waiting && header.xid == _this->lastXid
+                && mail->pktHdr.from == _this->callHost
+                && header.length <= RemoteBlockSize
+                && mail->mailHdr.length
+                    == sizeof(RemoteReply) + header.length) {
+            _this->reply = header;
+            bcopy(mail->data + sizeof(RemoteReply), _this->replyData,
+                  header.length);
+            _this->waiting = FALSE;
+            _this->gotReply = TRUE;
+            _this->answered->V();
+        }
+        (void) kernel->interrupt->SetLevel(oldLevel);
+        kernel->postOfficeIn->FreeMail(mail);
+    }
+}
+
+//----------------------------------------------------------------------
+// RemoteFile::RemoteFile
+// 	An open file on another machine; "client" does the work.
+//----------------------------------------------------------------------
+
+RemoteFile::RemoteFile(RemoteFileClient *client, RemoteFileInfo *info)
+{
+    this->client = client;
+    this->info = info;
+}
+
+//----------------------------------------------------------------------
+// RemoteFile::ReadAt/WriteAt
+// 	Read/write part of the file, with no change to the seek
+//	position; see OpenFile.
+//----------------------------------------------------------------------
+
+int
+RemoteFile::ReadAt(char *into, int numBytes, int position)
+{
+    return client->ReadAt(info, into, numBytes, position);
+}
+
+int
+RemoteFile::WriteAt(char *from, int numBytes, int position)
+{
+    return client->WriteAt(info, from, numBytes, position);
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,266 @@
+// remotefs.h
+//	Data structures for sharing files between Nachos machines, over
+//	the post office.
+//
+//	"nachos -rfs" starts a file server -- a kernel thread that takes
+//	requests from other machines out of mailbox RemoteServerBox and
+//	answers them from the local FileSystem -- and a client, through
+//	which user programs on this machine open files on the others.
+//	The path "/net/<machine>/<path>" names the file <path> on
+//	machine <machine>; once open, it is read and written like any
+//	other file, through a RemoteFile.
+//
+//	Each request and each reply is a single message.  A request that
+//	is not answered is sent again, under the same number (its xid),
+//	waiting twice as long each time, until the server answers.  It
+//	may have been carried out, and only the reply lost, so the server
+//	keeps the last reply it sent each machine, and answers a request
+//	that comes again with that reply rather than carrying it out
+//	again: a write done twice would count as two versions, and might
+//	undo another machine's write that came in between.  Files are
+//	read in blocks of RemoteBlockSize bytes (as much as a reply
+//	holds); writes go through to the server at once.
+//
+//	The client caches the blocks it reads, and uses them without
+//	asking the server for as long as it holds a callback on the
+//	file: a promise from the server to tell it (to break the
+//	callback) before the file changes.  A reply says whether it
+//	grants one.  A write is answered RemoteBusy, and sent again,
+//	until every other machine holding a callback on the file has
+//	said it dropped it; so once a write is done, no other cache
+//	holds what it overwrote.  Each reply, and each break, carries
+//	the file's version (the number of writes it has had), so that
+//	a cached block is never taken for a newer one, whatever order
+//	messages arrive in.
+//
+//	None of this depends on how fast ticks pass on each machine.  A
+//	machine that does not answer RemoteMaxBreaks breaks is taken to
+//	have gone away, and its callback is forgotten; so is a waiting
+//	write whose writer has not tried again while RemoteMaxRefusals
+//	other requests were refused callbacks for it.  Files do not
+//	grow in Nachos, so the length of a file is learned once, when
+//	it is opened.  Changes made on the server's machine other than
+//	through the server are not seen by clients holding callbacks.
+
+#ifndef REMOTEFS_H
+#define REMOTEFS_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "callback.h"
+#include "post.h"
+#include "synch.h"
+#include "openfile.h"
+
+#ifndef FILESYS_STUB
+
+#define RemotePrefix	"/net/"		// Paths of files on other machines
+
+const int RemoteServerBox = 3;		// Where requests go
+const int RemoteClientBox = 4;		// and replies come back
+
+// The header of a request.  The data that follows is the path, for
+// RemoteOpen, or the bytes to write, for RemoteWrite.
+
+typedef struct {
+    unsigned short xid;		// Number of the request, to match the
+				// reply with
+    unsigned char op;		// RemoteOpen, RemoteRead, ...
+    unsigned char length;	// Bytes of data that follow
+    int handle;			// The file, as RemoteOpen returned it
+    int offset;			// Where in the file to read or write;
+				// for RemoteBroken, the version the
+				// break was for
+} RemoteRequest;
+
+const int RemoteOpen = 0;	// Look up a file; the handle comes back
+const int RemoteRead = 1;	// Read the block at "offset"
+const int RemoteWrite = 2;	// Write the data at "offset"
+const int RemoteBroken = 3;	// Not a request: we have dropped our
+				// callback on the file (no reply)
+
+// The header of a reply.  The data that follows is the handle, for
+// RemoteOpen, or the block, for RemoteRead.
+
+typedef struct {
+    unsigned short xid;		// That of the request
+    unsigned char status;	// RemoteOK, RemoteBusy or RemoteError
+    unsigned char length;	// Bytes of data that follow
+    int value;			// 1 if we now hold a callback on the
+				// file, else 0; if busy, how long to
+				// wait before trying again; for
+				// RemoteBreak, the handle of the file
+    int fileLength;
+    int version;		// # of writes the file has had
+} RemoteReply;
+
+const int RemoteOK = 0;
+const int RemoteBusy = 1;	// Others hold callbacks; try again later
+const int RemoteError = 2;	// No such file, or a bad request
+const int RemoteBreak = 3;	// Not a reply: the server breaks our
+				// callback on a file
+
+#define RemoteBlockSize	(MaxMailSize - sizeof(RemoteReply))
+				// Most data a reply carries
+#define RemoteMaxPath	(MaxMailSize - sizeof(RemoteRequest))
+				// Longest path a request carries
+
+const int RemoteTimeout = 8 * NetworkTime;	// First wait for a reply
+const int RemoteMaxTimeout = 64 * NetworkTime;	// Longest wait
+const int RemoteMaxFiles = 32;		// Files a server has open
+const int RemoteMaxHolders = 8;		// Machines with callbacks on one
+const int RemoteMaxBreaks = 8;		// Breaks a machine may leave
+					// unanswered
+const int RemoteMaxRefusals = 32;	// Callbacks refused for a waiting
+					// write before it is forgotten
+const int RemoteCacheBlocks = 64;	// Blocks a client caches
+const int RemoteMaxClients = 16;	// Machines whose last reply a
+					// server keeps
+
+// A file a server has opened for its clients.  It stays open until
+// the server halts.
+
+typedef struct {
+    char path[RemoteMaxPath + 1];
+    OpenFile *file;
+    int version;		// # of writes through the server
+    NetworkAddress holder[RemoteMaxHolders]; // Who holds callbacks on
+				// it (-1 for nobody), and how many
+    int breaks[RemoteMaxHolders];	// breaks each has not answered
+    NetworkAddress writer;	// Whose write is waiting for callbacks
+				// to be dropped (-1 for nobody)
+    int refused;		// Callbacks refused since it last tried
+} ServedFile;
+
+// The last reply a server sent a machine.  A machine has only one
+// request in progress at a time, so if it sends one again, it is that
+// one.
+
+typedef struct {
+    NetworkAddress host;	// The machine (-1 if the slot is unused)
+    RemoteRequest request;	// What it asked for
+    int box;			// Where the reply went
+    int length;			// Of the reply and its data; 0 if none
+    char message[MaxMailSize];
+} RemoteLastReply;
+
+class FileServer {
+  public:
+    FileServer();		// Start answering requests
+
+    void SelfTest();		// Check that a write whose reply is
+				// lost is not done twice
+
+  private:
+    ServedFile files[RemoteMaxFiles];
+    int numFiles;
+    RemoteLastReply replies[RemoteMaxClients];
+    int nextReply;		// Slot to reuse when all are taken
+    int dropWriteReplies;	// Replies to writes to throw away, for
+				// SelfTest
+
+    static void ServeLoop(void *server);
+				// Body of the server thread
+    void Serve(NetworkAddress from, RemoteRequest *request, char *data,
+	       RemoteReply *reply, char *replyData);
+				// Carry out one request
+    int Lookup(char *path);	// Handle of "path", opening it if need
+				// be; -1 if it does not exist
+    RemoteLastReply *LastReply(NetworkAddress host);
+				// The last reply sent to "host"
+    int Register(ServedFile *served, NetworkAddress host);
+				// Give "host" a callback if we can
+    bool BreakCallbacks(ServedFile *served, int handle,
+			NetworkAddress host);
+				// Break everyone's but "host"'s; FALSE
+				// if nobody else holds one
+    void Broken(NetworkAddress host, RemoteRequest *request);
+				// "host" has dropped its callback
+};
+
+// What a client knows about a file it has opened on a server.  Every
+// RemoteFile for the same file shares one of these.
+
+typedef struct {
+    NetworkAddress host;	// The server
+    int handle;			// The server's name for the file
+    int length;
+    int version;		// The newest we have heard of
+    bool callback;		// Do we hold a callback on it?
+} RemoteFileInfo;
+
+// A block of a remote file, in the client's cache.  It may be used
+// while we hold a callback on its file, if the file's version has not
+// changed since it was read.
+
+typedef struct {
+    bool valid;			// Is there a block in this slot?
+    RemoteFileInfo *file;
+    int block;			// Number of the block in the file
+    int version;		// Of the file, when the block was read
+    int length;			// Bytes in it (the last may be short)
+    int lastUse;		// For LRU replacement
+    char data[RemoteBlockSize];
+} RemoteBlock;
+
+class RemoteFileClient : public CallBackObj {
+  public:
+    RemoteFileClient();		// Start taking replies in
+
+    OpenFile *Open(char *path);	// Open a file on another machine;
+				// NULL if there is no such file
+    int ReadAt(RemoteFileInfo *file, char *into, int numBytes,
+	       int position);
+    int WriteAt(RemoteFileInfo *file, char *from, int numBytes,
+		int position);
+				// As for OpenFile
+
+    void CallBack();		// The reply timer went off
+
+  private:
+    Lock *lock;			// One operation at a time
+    Semaphore *answered;	// V'ed by a reply, or by the timer
+    bool waiting;		// Is a request waiting for either?
+    bool gotReply;		// Which one was it?
+    unsigned short lastXid;	// Of the request waiting for a reply
+    NetworkAddress callHost;	// Where it went
+    int deadline;		// When the timer should wake us up
+    RemoteReply reply;		// The reply, and its data
+    char replyData[RemoteBlockSize];
+    List<RemoteFileInfo *> *files; // Every file opened so far
+    RemoteBlock *cache;		// RemoteCacheBlocks of them
+    int clock;			// Counts cache accesses, for LRU
+
+    static void ReceiveLoop(void *client);
+				// Body of the thread taking replies in
+    void Call(NetworkAddress host, RemoteRequest *request, char *data);
+				// Send a request until it is answered
+    bool Wait(int ticks);	// Wait for a reply for up to "ticks";
+				// FALSE if none came
+    void GotCallback(RemoteFileInfo *file);
+				// Note the callback and version in "reply"
+    bool Break(NetworkAddress host, RemoteReply *message);
+				// The server breaks our callback on a
+				// file; FALSE if we do not know the file
+    RemoteBlock *GetBlock(RemoteFileInfo *file, int block);
+				// The block, from the cache if it can be
+};
+
+// An open file on another machine.
+
+class RemoteFile : public OpenFile {
+  public:
+    RemoteFile(RemoteFileClient *client, RemoteFileInfo *info);
+
+    int ReadAt(char *into, int numBytes, int position);
+    int WriteAt(char *from, int numBytes, int position);
+    int Length() { return info->length; }
+
+  private:
+    RemoteFileClient *client;	// Does the work
+    RemoteFileInfo *info;
+};
+
+#endif // FILESYS_STUB
+
+#endif // REMOTEFS_H
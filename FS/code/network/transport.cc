@@ -0,0 +1,661 @@
+// transport.cc
+//	Routines for reliable, ordered delivery of a byte stream over the
+//	post office.  See transport.h for the protocol.
+//
+//	Segment numbers are ints here, but only their low 16 bits go on
+//	the wire; the full number is recovered from the nearest one we
+//	expect, which is never more than a window away.
+
+#include "copyright.h"
+#include "transport.h"
+#include "main.h"
+
+const int InitialTimeout = 8 * NetworkTime;	// before any round trip
+const int MinTimeout = 2 * NetworkTime;		// is measured, and the
+const int MaxTimeout = 1024 * NetworkTime;	// bounds on the estimate;
+						// a full window can take
+						// this long to get through
+
+const int MaxCloseTimeouts = 8;		// timeouts in a row before a
+					// closing connection gives up
+
+const int BenchmarkBox = 2;		// mailbox the benchmark uses
+const int BenchmarkChunk = 32 * MaxSegmentSize;	// bytes it passes to Send at
+						// a time: whole segments, and
+						// enough that the ack asked for
+						// on the last one is rare
+
+//----------------------------------------------------------------------
+// Unwrap
+// 	Recover a segment number from its low 16 bits, "wire", given
+//	"near", a number it is known to be close to.
+//----------------------------------------------------------------------
+
+static int
+Unwrap(unsigned short wire, int near)
+{
+    return near + (short) (unsigned short) (wire - (near & 0xffff));
+}
+
+//----------------------------------------------------------------------
+// Connection::Connection
+// 	Set up both ends of a connection on this machine, and start the
+//	threads that serve it.  The post office must be running.
+//
+//	"localBox" -- our mailbox for the connection's packets
+//	"remoteHost", "remoteBox" -- the other end
+//	"window" -- the most segments in flight, in either direction
+//----------------------------------------------------------------------
+
+Connection::Connection(int localBox, NetworkAddress remoteHost,
+                       int remoteBox, int window)
+{
+    Thread *t;
+
+    ASSERT(kernel->postOfficeIn != NULL && window > 0 && window < 0x8000);
+    this->localBox = localBox;
+    this->remoteHost = remoteHost;
+    this->remoteBox = remoteBox;
+    this->window = window;
+    lock = new Lock("connection");
+    windowOpen = new Condition("window open");
+    dataReady = new Condition("data ready");
+    retransmit = new Semaphore("retransmit", 0);
+
+    sendBuffer = new TransportSegment[window];
+    recvBuffer = new TransportSegment[window];
+    for (int i = 0; i < window; i++)
+        sendBuffer[i].valid = recvBuffer[i].valid = FALSE;
+    sendBase = nextSeq = recvNext = askAckAt = 0;
+    congestionWindow = 1;
+    slowStartLimit = window;
+    dupAcks = 0;
+    fastRetransmit = FALSE;
+    smoothedRTT = rttVariance = 0;	// no round trip measured yet
+    timeout = InitialTimeout;
+    timerPending = FALSE;
+    closing = FALSE;
+    timeoutsInARow = 0;
+    readySize = window * MaxSegmentSize;
+    ready = new char[readySize];
+    readyStart = readyCount = 0;
+    numSent = numTimeouts = numFastResends = numDuplicates = 0;
+
+    t = new Thread("transport receiver", 1);
+    t->Fork(Connection::ReceiveLoop, this);
+    t = new Thread("transport retransmitter", 1);
+    t->Fork(Connection::RetransmitLoop, this);
+}
+
+//----------------------------------------------------------------------
+// Connection::Send
+// 	Send "length" bytes of "data" to the other end, as segments of
+//	up to MaxSegmentSize bytes.  Returns once the last segment has
+//	gone out, not when it has arrived (see Flush); waits whenever
+//	the window is full.
+//----------------------------------------------------------------------
+
+void
+Connection::Send(char *data, int length)
+{
+    char buffer[MaxMailSize];
+    TransportSegment *segment;
+    int seq, count, packetLength;
+
+    while (length > 0) {
+        count = (length < (int) MaxSegmentSize) ? length : MaxSegmentSize;
+        lock->Acquire();
+        while (nextSeq - sendBase >= (int) congestionWindow)
+            windowOpen->Wait(lock);
+        seq = nextSeq++;
+        segment = &sendBuffer[seq % window];
+        segment->valid = TRUE;
+        segment->resent = FALSE;
+        segment->length = count;
+        bcopy(data, segment->data, count);
+        packetLength = BuildSegment(seq, FALSE, count == length, buffer);
+        lock->Release();
+
+        DEBUG(dbgNet, "Transport sends segment " << seq);
+        Transmit(buffer, packetLength);
+        data += count;
+        length -= count;
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::Receive
+// 	Read up to "length" bytes that have arrived, in order, into
+//	"data", waiting until there is at least one.  Return how many
+//	were read.
+//----------------------------------------------------------------------
+
+int
+Connection::Receive(char *data, int length)
+{
+    int count;
+    bool moved;
+
+    lock->Acquire();
+    while (readyCount == 0)
+        dataReady->Wait(lock);
+    count = (length < readyCount) ? length : readyCount;
+    for (int i = 0; i < count; i++)
+        data[i] = ready[(readyStart + i) % readySize];
+    readyStart = (readyStart + count) % readySize;
+    readyCount -= count;
+    moved = Deliver();		// there may be room for more now
+    lock->Release();
+
+    if (moved)			// tell the sender, who may be waiting
+        SendAck();
+    return count;
+}
+
+//----------------------------------------------------------------------
+// Connection::Flush
+// 	Wait until the other end has acknowledged all we have sent.
+//----------------------------------------------------------------------
+
+void
+Connection::Flush()
+{
+    lock->Acquire();
+    while (sendBase < nextSeq)
+        windowOpen->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Connection::Close
+// 	Like Flush, but if the other end stops acknowledging -- it may
+//	have halted -- give up after MaxCloseTimeouts timeouts in a row,
+//	and drop what is left.  Return TRUE if everything we sent was
+//	acknowledged.  Nothing more should be sent.
+//----------------------------------------------------------------------
+
+bool
+Connection::Close()
+{
+    bool acked;
+
+    lock->Acquire();
+    closing = TRUE;
+    timeoutsInARow = 0;
+    while (sendBase < nextSeq && timeoutsInARow < MaxCloseTimeouts)
+        windowOpen->Wait(lock);
+    acked = (sendBase == nextSeq);
+    for (; sendBase < nextSeq; sendBase++)
+        sendBuffer[sendBase % window].valid = FALSE;
+    lock->Release();
+    return acked;
+}
+
+//----------------------------------------------------------------------
+// Connection::CallBack
+// 	Interrupt handler for the retransmission timer.  It cannot send
+//	anything (that needs the post office's lock), so if the oldest
+//	unacknowledged segment has waited too long, it wakes up the
+//	retransmitting thread.  If that segment has been acked since the
+//	timer was set, as it usually has, the timer is just set again
+//	for the one now oldest, without waking anyone: a handler runs
+//	with interrupts off, so nothing changes while it looks.
+//----------------------------------------------------------------------
+
+void
+Connection::CallBack()
+{
+    int waited;
+
+    timerPending = FALSE;
+    if (sendBase == nextSeq)		// nothing to time; the next
+        return;				// segment sent sets it again
+    waited = kernel->stats->totalTicks - sendBuffer[sendBase % window].sentAt;
+    if (waited < timeout)
+        StartTimer(timeout - waited);
+    else
+        retransmit->V();
+}
+
+//----------------------------------------------------------------------
+// Connection::StartTimer
+// 	Have the timer go off in "ticks", unless it is already set.
+//	It is a timeout (see Interrupt::ScheduleTimeout): while we are
+//	idle, waiting for the other end, the clock does not run ahead to
+//	it, so it measures the round trip rather than how long the host
+//	took to pass the packets between the two Nachos.
+//	The caller must hold the lock, or be the timer's handler.
+//----------------------------------------------------------------------
+
+void
+Connection::StartTimer(int ticks)
+{
+    if (!timerPending) {
+        timerPending = TRUE;
+        kernel->interrupt->ScheduleTimeout(this, ticks, TimerInt);
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::BuildSegment
+// 	Put segment "seq", after its header, in "buffer", and note when
+//	it was sent.  Return the length of the message.
+//
+//	It asks the other end for an ack if it is sent "again", or is
+//	the last one the caller has ("push"), or half a window has gone
+//	out since the last one that asked -- often enough that the
+//	window never fills waiting for one.
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+int
+Connection::BuildSegment(int seq, bool again, bool push, char *buffer)
+{
+    TransportSegment *segment = &sendBuffer[seq % window];
+    TransportHeader header;
+    int ackEvery = (int) congestionWindow / 2;
+
+    if (again)
+        segment->resent = TRUE;
+    segment->sentAt = kernel->stats->totalTicks;
+    header.seq = seq & 0xffff;
+    header.kind = TransportData;
+    if (again || push || seq >= askAckAt) {
+        header.kind = TransportDataAckNow;
+        askAckAt = seq + ((ackEvery > 1) ? ackEvery : 1);
+    }
+    header.length = segment->length;
+    bcopy((char *) &header, buffer, sizeof(TransportHeader));
+    bcopy(segment->data, buffer + sizeof(TransportHeader), segment->length);
+    numSent++;
+    StartTimer(timeout);
+    return sizeof(TransportHeader) + segment->length;
+}
+
+//----------------------------------------------------------------------
+// Connection::SendSegment
+// 	Put segment "seq" on the wire again, unless it has been
+//	acknowledged in the meantime.
+//----------------------------------------------------------------------
+
+void
+Connection::SendSegment(int seq)
+{
+    char buffer[MaxMailSize];
+    int length;
+
+    lock->Acquire();
+    if (seq < sendBase) {
+        lock->Release();
+        return;
+    }
+    length = BuildSegment(seq, TRUE, TRUE, buffer);
+    lock->Release();
+
+    DEBUG(dbgNet, "Transport sends segment " << seq << " again");
+    Transmit(buffer, length);
+}
+
+//----------------------------------------------------------------------
+// Connection::SendAck
+// 	Tell the other end the number of the first segment we are still
+//	missing.
+//----------------------------------------------------------------------
+
+void
+Connection::SendAck()
+{
+    TransportHeader header;
+
+    lock->Acquire();
+    header.seq = recvNext & 0xffff;
+    lock->Release();
+    header.kind = TransportAck;
+    header.length = 0;
+    Transmit((char *) &header, sizeof(TransportHeader));
+}
+
+//----------------------------------------------------------------------
+// Connection::Transmit
+// 	Send "length" bytes of "buffer", a header and what follows it,
+//	to the other end of the connection.
+//----------------------------------------------------------------------
+
+void
+Connection::Transmit(char *buffer, int length)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+
+    pktHdr.to = remoteHost;
+    mailHdr.to = remoteBox;
+    mailHdr.from = localBox;
+    mailHdr.length = length;
+    kernel->postOfficeOut->Send(pktHdr, mailHdr, buffer);
+}
+
+//----------------------------------------------------------------------
+// Connection::GotAck
+// 	The other end has everything before segment "ack" (its low 16
+//	bits).  Free those segments, measure the round trip, and open
+//	the congestion window; or, if the other end keeps asking for the
+//	same segment, resend it now rather than wait for the timer.
+//
+//	The round trip is timed from the oldest segment acked, not the
+//	newest: it is the oldest one the timer waits for, and with acks
+//	asked for only every half window, its ack comes that much later.
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+Connection::GotAck(int ack)
+{
+    ack = Unwrap(ack, sendBase);
+    if (ack > sendBase && ack <= nextSeq) {
+        TransportSegment *oldest = &sendBuffer[sendBase % window];
+
+        if (!oldest->resent) {	// else we cannot tell which one got there
+            int sample = kernel->stats->totalTicks - oldest->sentAt;
+
+            if (smoothedRTT == 0) {
+                smoothedRTT = sample;
+                rttVariance = sample / 2;
+            } else {
+                int error = sample - smoothedRTT;
+
+                smoothedRTT += error / 8;
+                rttVariance += (abs(error) - rttVariance) / 4;
+            }
+            timeout = smoothedRTT + 4 * rttVariance;
+            if (timeout < MinTimeout)
+                timeout = MinTimeout;
+            if (timeout > MaxTimeout)
+                timeout = MaxTimeout;
+        }
+        for (; sendBase < ack; sendBase++) {
+            sendBuffer[sendBase % window].valid = FALSE;
+            if (congestionWindow < slowStartLimit)
+                congestionWindow += 1;
+            else
+                congestionWindow += 1 / congestionWindow;
+        }
+        if (congestionWindow > window)
+            congestionWindow = window;
+        dupAcks = 0;
+        timeoutsInARow = 0;
+        windowOpen->Broadcast(lock);
+    } else if (ack == sendBase && sendBase < nextSeq && ++dupAcks == 3) {
+        // the later segments are getting there, but not this one
+        slowStartLimit = (nextSeq - sendBase) / 2;
+        if (slowStartLimit < 2)
+            slowStartLimit = 2;
+        congestionWindow = slowStartLimit;
+        fastRetransmit = TRUE;
+        numFastResends++;
+        retransmit->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::GotData
+// 	Segment "seq" (its low 16 bits) has arrived.  Keep it, if we do
+//	not have it already, and pass on whatever is now in order.
+//	Return TRUE if the sender should be told now: it asked
+//	("ackNow"), or the segment is a duplicate, or did not come next
+//	-- so that the sender hears at once what is missing -- or
+//	filled a gap.
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+bool
+Connection::GotData(int seq, bool ackNow, char *data, int length)
+{
+    TransportSegment *segment;
+    int expected = recvNext;
+
+    seq = Unwrap(seq, recvNext);
+    segment = &recvBuffer[seq % window];
+    if (seq < recvNext || seq >= recvNext + window || segment->valid) {
+        numDuplicates++;
+        return TRUE;
+    }
+    segment->valid = TRUE;
+    segment->length = length;
+    bcopy(data, segment->data, length);
+    (void) Deliver();
+    return ackNow || seq != expected || recvNext > expected + 1;
+}
+
+//----------------------------------------------------------------------
+// Connection::Deliver
+// 	Move the segments that are next in order to the data waiting to
+//	be read, as far as there is room.  Return TRUE if any moved.
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+bool
+Connection::Deliver()
+{
+    TransportSegment *segment;
+    bool moved = FALSE;
+
+    for (;;) {
+        segment = &recvBuffer[recvNext % window];
+        if (!segment->valid || readySize - readyCount < segment->length)
+            break;
+        for (int i = 0; i < segment->length; i++)
+            ready[(readyStart + readyCount++) % readySize] = segment->data[i];
+        segment->valid = FALSE;
+        recvNext++;
+        moved = TRUE;
+    }
+    if (moved)
+        dataReady->Broadcast(lock);
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// Connection::ReceiveLoop
+// 	Body of the thread that takes the connection's packets out of
+//	its mailbox, and acks the data segments that need it (see
+//	GotData).
+//----------------------------------------------------------------------
+
+void
+Connection::ReceiveLoop(void *connection)
+{
+    Connection *conn = (Connection *) connection;
+    TransportHeader header;
+    Mail *mail;
+    bool ack;
+
+    for (;;) {
+        // the segment is read where the post office put it, not copied
+        mail = kernel->postOfficeIn->ReceiveMail(conn->localBox);
+        bcopy(mail->data, (char *) &header, sizeof(TransportHeader));
+        if (mail->pktHdr.from != conn->remoteHost
+                || mail->mailHdr.from != conn->remoteBox
+                || mail->mailHdr.length
+                    != sizeof(TransportHeader) + header.length) {
+            kernel->postOfficeIn->FreeMail(mail);
+            continue;			// not ours
+        }
+
+        conn->lock->Acquire();
+        ack = FALSE;
+        if (header.kind == TransportAck)
+            conn->GotAck(header.seq);
+        else
+            ack = conn->GotData(header.seq,
+                                header.kind == TransportDataAckNow,
+                                mail->data + sizeof(TransportHeader),
+                                header.length);
+        conn->lock->Release();
+        kernel->postOfficeIn->FreeMail(mail);
+        if (ack)
+            conn->SendAck();
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::RetransmitLoop
+// 	Body of the thread that resends the oldest unacknowledged
+//	segment: at once for a fast retransmit, or when the timer finds
+//	that it has waited longer than the timeout.  Then the congestion
+//	window starts again from one segment, and the timeout doubles.
+//	A closing connection stops instead, after MaxCloseTimeouts
+//	timeouts in a row, and wakes up Close.
+//----------------------------------------------------------------------
+
+void
+Connection::RetransmitLoop(void *connection)
+{
+    Connection *conn = (Connection *) connection;
+    bool resend;
+    int seq;
+
+    for (;;) {
+        conn->retransmit->P();
+        conn->lock->Acquire();
+        resend = FALSE;
+        seq = conn->sendBase;
+        if (conn->fastRetransmit) {
+            conn->fastRetransmit = FALSE;
+            resend = (conn->sendBase < conn->nextSeq);
+        } else {				// the timer went off
+            if (conn->sendBase < conn->nextSeq) {
+                int waited = kernel->stats->totalTicks
+                             - conn->sendBuffer[seq % conn->window].sentAt;
+
+                if (waited >= conn->timeout && conn->closing
+                        && ++conn->timeoutsInARow >= MaxCloseTimeouts) {
+                    conn->windowOpen->Broadcast(conn->lock);
+                } else if (waited >= conn->timeout) {	// lost
+                    conn->slowStartLimit = (conn->nextSeq - conn->sendBase) / 2;
+                    if (conn->slowStartLimit < 2)
+                        conn->slowStartLimit = 2;
+                    conn->congestionWindow = 1;
+                    conn->dupAcks = 0;
+                    conn->timeout *= 2;
+                    if (conn->timeout > MaxTimeout)
+                        conn->timeout = MaxTimeout;
+                    conn->numTimeouts++;
+                    resend = TRUE;
+                } else {		// acked since; time the next one
+                    conn->StartTimer(conn->timeout - waited);
+                }
+            }
+        }
+        conn->lock->Release();
+        if (resend)
+            conn->SendSegment(seq);
+    }
+}
+
+//----------------------------------------------------------------------
+// Lingerer
+// 	Wakes the benchmark up some time after it is done, so that the
+//	other machine can still have its last segments acknowledged if
+//	those acknowledgements get lost.  It is a timeout, so an idle
+//	machine waits in the host for those segments, rather than
+//	running the clock up to it and halting at once.
+//----------------------------------------------------------------------
+
+class Lingerer : public CallBackObj {
+  public:
+    Lingerer() { done = new Semaphore("linger", 0); }
+    ~Lingerer() { delete done; }
+
+    void Wait(int ticks) {
+        kernel->interrupt->ScheduleTimeout(this, ticks, TimerInt);
+        done->P();
+    }
+    void CallBack() { done->V(); }
+
+  private:
+    Semaphore *done;
+};
+
+//----------------------------------------------------------------------
+// Connection::Benchmark
+// 	Send "numBytes" from machine 0 to machine 1, and report how long
+//	it took, and how busy that kept machine 0's link and CPU.  Run
+//	one Nachos with "-m 0" and one with "-m 1"; "-n" sets how many
+//	packets the network drops.  Machine 1 checks that every byte got
+//	there, in order, and then sends one back, to tell machine 0 it
+//	is done, closing the connection so that it gives up on the reply
+//	if machine 0 has halted.  Both then linger, to answer the other's
+//	retransmissions.
+//
+//	Each machine keeps its own time, so the ticks are machine 0's.
+//----------------------------------------------------------------------
+
+void
+Connection::Benchmark(int numBytes, int window)
+{
+    NetworkAddress me = kernel->hostName;
+    Connection *conn;
+    Lingerer *linger;
+    char chunk[BenchmarkChunk];
+    int start, ticks, done = 0, bad = 0;
+    int systemStart, systemTicks;
+    double hostStart;
+
+    if (me != 0 && me != 1) {
+        cout << "The transport benchmark runs on machines 0 and 1 (-m)\n";
+        return;
+    }
+    conn = new Connection(BenchmarkBox, 1 - me, BenchmarkBox, window);
+    linger = new Lingerer;
+    start = kernel->stats->totalTicks;
+    systemStart = kernel->stats->systemTicks;
+    hostStart = HostSeconds();
+
+    if (me == 0) {
+        while (done < numBytes) {
+            int count = (numBytes - done < BenchmarkChunk) ? numBytes - done
+                                                           : BenchmarkChunk;
+
+            for (int i = 0; i < count; i++)
+                chunk[i] = (done + i) & 0xff;
+            conn->Send(chunk, count);
+            done += count;
+        }
+        conn->Flush();
+        ticks = kernel->stats->totalTicks - start;
+        systemTicks = kernel->stats->systemTicks - systemStart;
+        (void) conn->Receive(chunk, 1);		// machine 1 has it all
+
+        cout << "Sent " << numBytes << " bytes in " << ticks << " ticks ("
+             << HostSeconds() - hostStart << " seconds), "
+             << numBytes * 1000.0 / ticks << " bytes per 1000 ticks\n";
+        cout << "Window " << window << " segments of " << MaxSegmentSize
+             << " bytes; link busy " << conn->numSent * NetworkTime * 100.0
+                 / ticks << "% of the time, CPU "
+             << systemTicks * 100.0 / ticks
+             << "%\n";
+        cout << "Segments sent " << conn->numSent << ", resent "
+             << conn->numTimeouts << " on timeout and " << conn->numFastResends
+             << " fast; timeout now " << conn->timeout << " ticks\n";
+    } else {
+        while (done < numBytes) {
+            int count = (numBytes - done < BenchmarkChunk) ? numBytes - done
+                                                           : BenchmarkChunk;
+
+            count = conn->Receive(chunk, count);
+            for (int i = 0; i < count; i++) {
+                if (chunk[i] != (char) ((done + i) & 0xff))
+                    bad++;
+            }
+            done += count;
+        }
+        chunk[0] = 0;
+        conn->Send(chunk, 1);
+        if (!conn->Close())
+            cout << "Machine 0 did not acknowledge the reply\n";
+        cout << "Received " << numBytes << " bytes, " << bad << " of them"
+             << " wrong, " << conn->numDuplicates << " duplicate segments\n";
+    }
+    linger->Wait(2 * MaxTimeout);
+    delete linger;
+}
@@ -0,0 +1,158 @@
+// transport.h
+//	Data structures for reliable, ordered delivery of a stream of
+//	bytes between mailboxes on two machines, on top of the post
+//	office (which may drop messages, see "-n").
+//
+//	A Connection cuts the stream into segments, numbers them, and
+//	keeps up to "window" of them in flight at once, rather than
+//	waiting for each to get through before sending the next.  The
+//	receiver keeps segments that arrive out of order, and answers
+//	with a cumulative acknowledgement: the number of the first
+//	segment it is still missing.  Each ack costs the sender as much
+//	as a segment to take in, so it is not sent for every segment:
+//	the sender asks for one every half window (and on the last
+//	segment of each Send), and the receiver answers those, and at
+//	once whenever a segment is out of order or a duplicate.
+//
+//	A lost segment is sent again when the oldest unacknowledged one
+//	has waited longer than the retransmission timeout -- estimated,
+//	as in TCP, from the measured round trip times -- or when the
+//	receiver has asked for it three times over.  A congestion window
+//	limits how much of the window is used: it starts at one segment,
+//	grows by one per acknowledgement up to a threshold (slow start)
+//	and by one per window after that, and is cut back on a loss.
+//
+//	Each Connection has two threads of its own: one takes packets out
+//	of its mailbox, the other retransmits when the timer (an
+//	interrupt, which cannot send anything itself) finds a segment
+//	overdue; when none is, the timer only sets itself again.  Like the
+//	post office's worker, they run for as long as Nachos does, so
+//	Connections are never deleted.  Once a Connection is closed, it
+//	gives up on the other end after a few timeouts in a row, since
+//	the other Nachos may have halted.
+//
+//	"nachos -m 0 -tb bytes window" and "nachos -m 1 -tb bytes window",
+//	run at the same time, time a bulk transfer from machine 0 to 1.
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "callback.h"
+#include "post.h"
+#include "synch.h"
+
+// The header the transport adds to the front of each mail message.
+// Segment numbers go on the wire as their low 16 bits.
+
+typedef struct {
+    unsigned short seq;		// Number of the segment (data), or of
+				// the first one still missing (ack)
+    unsigned char kind;		// TransportData or TransportAck
+    unsigned char length;	// Bytes of data that follow
+} TransportHeader;
+
+const int TransportData = 0;
+const int TransportAck = 1;
+const int TransportDataAckNow = 2;	// Data, to be acknowledged at once
+
+#define MaxSegmentSize	(MaxMailSize - sizeof(TransportHeader))
+				// Most data a segment carries
+
+const int DefaultTransportWindow = 16;	// segments in flight
+
+// A segment, kept by the sender until it is acknowledged, or by the
+// receiver until the ones before it have arrived.
+
+typedef struct {
+    bool valid;			// Is there a segment in this slot?
+    bool resent;		// Has it been sent more than once?
+    int sentAt;			// When it was last sent
+    int length;
+    char data[MaxSegmentSize];
+} TransportSegment;
+
+class Connection : public CallBackObj {
+  public:
+    Connection(int localBox, NetworkAddress remoteHost, int remoteBox,
+	       int window);
+				// Connect mailbox "localBox" here with
+				// "remoteBox" on "remoteHost", keeping
+				// up to "window" segments in flight
+
+    void Send(char *data, int length);
+				// Queue "length" bytes for delivery;
+				// waits while the window is full
+    int Receive(char *data, int length);
+				// Read up to "length" bytes of what has
+				// arrived; waits for at least one
+    void Flush();		// Wait until everything sent has been
+				// acknowledged
+    bool Close();		// Flush, but give up if the other end
+				// stops answering; TRUE if it did not
+
+    void CallBack();		// The retransmission timer went off
+
+    static void Benchmark(int numBytes, int window);
+				// Time sending "numBytes" from machine
+				// 0 to machine 1, and print the results
+
+  private:
+    int localBox;		// Where our packets arrive
+    NetworkAddress remoteHost;	// Where we send them
+    int remoteBox;
+    int window;			// Size of both buffers, in segments
+    Lock *lock;			// Protects everything below
+    Condition *windowOpen;	// Signalled when segments are acked
+    Condition *dataReady;	// Signalled when data can be read
+    Semaphore *retransmit;	// V'ed by the timer, or for a fast
+				// retransmit
+
+    // sending
+    TransportSegment *sendBuffer; // Unacknowledged segments, by
+				// number modulo "window"
+    int sendBase;		// Oldest unacknowledged segment
+    int nextSeq;		// Number of the next segment to send
+    double congestionWindow;	// Segments we may have in flight
+    int slowStartLimit;		// Where slow start stops
+    int askAckAt;		// Next segment to ask for an ack on
+    int dupAcks;		// Repeats of the last acknowledgement
+    bool fastRetransmit;	// Resend the oldest segment at once?
+    int smoothedRTT;		// Round trip time estimate, in ticks
+    int rttVariance;		// And how much it varies
+    int timeout;		// Retransmission timeout, in ticks
+    bool timerPending;		// Is the timer set?
+    bool closing;		// Give up after MaxCloseTimeouts?
+    int timeoutsInARow;		// Timeouts since the last new ack
+
+    // receiving
+    TransportSegment *recvBuffer; // Segments that arrived early, by
+				// number modulo "window"
+    int recvNext;		// Number of the next segment due
+    char *ready;		// Data, in order, not yet read (a ring)
+    int readySize, readyStart, readyCount;
+
+    // counts, for Benchmark
+    int numSent, numTimeouts, numFastResends, numDuplicates;
+
+    static void ReceiveLoop(void *connection);
+				// Body of the thread taking packets in
+    static void RetransmitLoop(void *connection);
+				// Body of the thread resending segments
+    int BuildSegment(int seq, bool again, bool push, char *buffer);
+				// Put a segment, and its header, in
+				// "buffer"; return its length
+    void SendSegment(int seq);	// Put a segment on the wire again
+    void SendAck();		// Tell the other end what we have
+    void Transmit(char *buffer, int length);
+				// Hand a packet to the post office
+    void GotAck(int ack);	// An acknowledgement arrived
+    bool GotData(int seq, bool ackNow, char *data, int length);
+				// A segment arrived; TRUE if it needs
+				// an ack now
+    bool Deliver();		// Move in-order segments to "ready"
+    void StartTimer(int ticks);	// Set the timer, if it is not set
+};
+
+#endif // TRANSPORT_H
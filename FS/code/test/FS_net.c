@@ -0,0 +1,43 @@
+#include "syscall.h"
+
+// Reads and writes "/file1" on machine 0, through the remote file
+// service.  Make the file with FS_test1 on machine 0 first, then serve
+// it ("nachos -m 0 -rfs") and run this on another machine:
+//	nachos -m 1 -rfs -e FS_net
+
+int main(void)
+{
+	char check[] = "abcdefghijklmnopqrstuvwxyz\n";
+	char upper[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ\n";
+	char buf[27];
+	OpenFileId fid;
+	int i, pass;
+
+	fid = Open("/net/0/file1");
+	if (fid < 0) MSG("Failed on opening /net/0/file1");
+
+	// the second pass is read from the client's cache
+	for (pass = 0; pass < 2; ++pass) {
+		if (Seek(0, fid) != 1) MSG("Failed on seeking file");
+		if (Read(buf, 27, fid) != 27) MSG("Failed on reading file");
+		for (i = 0; i < 27; ++i) {
+			if (buf[i] != check[i]) MSG("Failed: reading wrong result");
+		}
+	}
+
+	// a write goes through to the server, and is seen by later reads
+	if (Seek(0, fid) != 1) MSG("Failed on seeking file");
+	if (Write(upper, 27, fid) != 27) MSG("Failed on writing file");
+	if (Seek(0, fid) != 1) MSG("Failed on seeking file");
+	if (Read(buf, 27, fid) != 27) MSG("Failed on reading file");
+	for (i = 0; i < 27; ++i) {
+		if (buf[i] != upper[i]) MSG("Failed: write not seen");
+	}
+
+	// put it back, so that FS_test2 still passes on machine 0
+	if (Seek(0, fid) != 1) MSG("Failed on seeking file");
+	if (Write(check, 27, fid) != 27) MSG("Failed on writing file");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,42 @@
+#include "syscall.h"
+
+#define NumFiles 200
+
+int main(void)
+{
+	// opens "/file3" many more times than the old 10-entry table allowed
+	OpenFileId fid[NumFiles];
+	OpenFileId again;
+	char ch = 'a';
+	int i;
+
+	if (Create("/file3", 1) != 1) MSG("Failed on creating file");
+	fid[0] = Open("/file3");
+	if (fid[0] < 0) MSG("Failed on opening file");
+	if (Write(&ch, 1, fid[0]) != 1) MSG("Failed on writing file");
+	if (Close(fid[0]) != 1) MSG("Failed on closing file");
+
+	for (i = 0; i < NumFiles; ++i) {
+		fid[i] = Open("/file3");
+		if (fid[i] < 0) MSG("Failed on opening file");
+		if (i > 0 && fid[i] != fid[i - 1] + 1) MSG("Failed: descriptors not allocated in order");
+	}
+
+	// every descriptor has its own seek position
+	if (Read(&ch, 1, fid[0]) != 1 || ch != 'a') MSG("Failed on reading file");
+	if (Read(&ch, 1, fid[NumFiles - 1]) != 1 || ch != 'a') MSG("Failed on reading file");
+
+	// the lowest free descriptor is handed out first
+	if (Close(fid[5]) != 1) MSG("Failed on closing file");
+	if (Close(fid[3]) != 1) MSG("Failed on closing file");
+	again = Open("/file3");
+	if (again != fid[3]) MSG("Failed: lowest free descriptor not reused");
+	if (Close(again) != 1) MSG("Failed on closing file");
+	if (Close(fid[5]) != -1) MSG("Failed: closed a descriptor twice");
+
+	for (i = 0; i < NumFiles; ++i) {
+		if (i != 3 && i != 5 && Close(fid[i]) != 1) MSG("Failed on closing file");
+	}
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,51 @@
+/* fsb_create.c
+ *	File system microbenchmark: create/remove storm.
+ *
+ *	Parameters (see fsbench.h):
+ *	    files  -- number of files created per round (at most 64,
+ *		      the size of a directory)
+ *	    rounds -- number of create-then-remove rounds
+ *	    keep   -- if non-zero, leave the last round's files in
+ *		      place (used to populate a directory for listing)
+ *	    size   -- initial size of each file, in bytes
+ *
+ *	One operation is one Create or one Remove.
+ */
+
+#include "fsbench.h"
+
+int
+main()
+{
+    char name[16];
+    int files, rounds, keep, size;
+    int r, i, ops = 0;
+
+    param[0] = 50;
+    param[1] = 4;
+    param[2] = 0;
+    param[3] = 128;
+    ReadParams(4);
+    files = param[0];
+    rounds = param[1];
+    keep = param[2];
+    size = param[3];
+
+    for (r = 0; r < rounds; r++) {
+	for (i = 0; i < files; i++) {
+	    MakeName(name, "/c", i);
+	    if (Create(name, size) != 1)
+		MSG("fsb_create: Create failed");
+	    ops++;
+	}
+	if (keep && r == rounds - 1)
+	    break;
+	for (i = 0; i < files; i++) {
+	    MakeName(name, "/c", i);
+	    if (Remove(name) != 1)
+		MSG("fsb_create: Remove failed");
+	    ops++;
+	}
+    }
+    Done(ops);
+}
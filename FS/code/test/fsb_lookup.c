@@ -0,0 +1,39 @@
+/* fsb_lookup.c
+ *	File system microbenchmark: deep path lookup.
+ *
+ *	The driver creates the directories /d1/d2/.../d8 before the run
+ *	(with "nachos -mkdir"); we create a file at the bottom and then
+ *	repeatedly open and close it by its full path.
+ *
+ *	Parameters (see fsbench.h):
+ *	    iterations -- number of Open+Close pairs
+ *
+ *	One operation is one Open plus one Close.
+ */
+
+#include "fsbench.h"
+
+#define DeepPath	"/d1/d2/d3/d4/d5/d6/d7/d8/f"
+
+int
+main()
+{
+    OpenFileId fid;
+    int iterations, i, ops = 0;
+
+    param[0] = 200;
+    ReadParams(1);
+    iterations = param[0];
+
+    if (Create(DeepPath, 128) != 1)
+	MSG("fsb_lookup: Create failed");
+
+    for (i = 0; i < iterations; i++) {
+	fid = Open(DeepPath);
+	if (fid < 0)
+	    MSG("fsb_lookup: Open failed");
+	Close(fid);
+	ops++;
+    }
+    Done(ops);
+}
@@ -0,0 +1,65 @@
+/* fsb_rand.c
+ *	File system microbenchmark: random reads and writes.
+ *
+ *	Parameters (see fsbench.h):
+ *	    iosize   -- bytes per Read/Write call (at most MaxIOSize)
+ *	    filesize -- size of the file, in bytes
+ *	    numops   -- number of Read/Write calls
+ *	    seed     -- random seed; the same seed gives the same offsets
+ *	    writes   -- percentage of calls that are writes
+ *
+ *	Offsets are aligned to "iosize".  One operation is one Seek plus
+ *	one Read or Write.
+ */
+
+#include "fsbench.h"
+
+#define MaxIOSize	4096
+
+static char buffer[MaxIOSize];
+
+int
+main()
+{
+    OpenFileId fid;
+    int iosize, filesize, numops, writes, blocks;
+    int i, ops = 0;
+
+    param[0] = 128;
+    param[1] = 65536;
+    param[2] = 1000;
+    param[3] = 1;
+    param[4] = 50;
+    ReadParams(5);
+    iosize = param[0];
+    filesize = param[1];
+    numops = param[2];
+    seed = param[3] > 0 ? param[3] : 1;
+    writes = param[4];
+    if (iosize > MaxIOSize)
+	iosize = MaxIOSize;
+    blocks = filesize / iosize;
+    if (blocks <= 0)
+	MSG("fsb_rand: file smaller than one I/O");
+
+    if (Create("/rand", filesize) != 1)
+	MSG("fsb_rand: Create failed");
+    fid = Open("/rand");
+    if (fid < 0)
+	MSG("fsb_rand: Open failed");
+
+    for (i = 0; i < numops; i++) {
+	if (Seek(Random(blocks) * iosize, fid) != 1)
+	    MSG("fsb_rand: Seek failed");
+	if (Random(100) < writes) {
+	    if (Write(buffer, iosize, fid) != iosize)
+		MSG("fsb_rand: Write failed");
+	} else {
+	    if (Read(buffer, iosize, fid) != iosize)
+		MSG("fsb_rand: Read failed");
+	}
+	ops++;
+    }
+    Close(fid);
+    Done(ops);
+}
@@ -0,0 +1,60 @@
+/* fsb_seq.c
+ *	File system microbenchmark: sequential write then read.
+ *
+ *	Parameters (see fsbench.h):
+ *	    iosize   -- bytes per Read/Write call (at most MaxIOSize)
+ *	    filesize -- size of the file, in bytes
+ *	    passes   -- number of write+read passes over the file
+ *
+ *	One operation is one Read or one Write call.
+ */
+
+#include "fsbench.h"
+
+#define MaxIOSize	4096
+
+static char buffer[MaxIOSize];
+
+int
+main()
+{
+    OpenFileId fid;
+    int iosize, filesize, passes;
+    int p, pos, i, ops = 0;
+
+    param[0] = 128;
+    param[1] = 65536;
+    param[2] = 1;
+    ReadParams(3);
+    iosize = param[0];
+    filesize = param[1];
+    passes = param[2];
+    if (iosize > MaxIOSize)
+	iosize = MaxIOSize;
+
+    for (i = 0; i < iosize; i++)
+	buffer[i] = 'a' + i % 26;
+
+    if (Create("/seq", filesize) != 1)
+	MSG("fsb_seq: Create failed");
+    fid = Open("/seq");
+    if (fid < 0)
+	MSG("fsb_seq: Open failed");
+
+    for (p = 0; p < passes; p++) {
+	Seek(0, fid);
+	for (pos = 0; pos + iosize <= filesize; pos += iosize) {
+	    if (Write(buffer, iosize, fid) != iosize)
+		MSG("fsb_seq: Write failed");
+	    ops++;
+	}
+	Seek(0, fid);
+	for (pos = 0; pos + iosize <= filesize; pos += iosize) {
+	    if (Read(buffer, iosize, fid) != iosize)
+		MSG("fsb_seq: Read failed");
+	    ops++;
+	}
+    }
+    Close(fid);
+    Done(ops);
+}
@@ -0,0 +1,94 @@
+/* fsbench.h
+ *	Helpers shared by the file system microbenchmarks (fsb_*.c).
+ *
+ *	A benchmark takes its parameters from the Nachos file "/bparam",
+ *	which the host driver (../fsbench.sh) copies onto a freshly
+ *	formatted disk before each run.  The file holds whitespace
+ *	separated decimal integers; missing values keep the defaults
+ *	the program passes in.
+ *
+ *	When it is done, a benchmark prints the number of operations it
+ *	performed with PrintInt and halts; the driver pairs that number
+ *	with the statistics printed by Halt.
+ */
+
+#include "syscall.h"
+
+#define MaxParams	8
+
+static int param[MaxParams];
+
+/* Read up to "n" parameters from "/bparam" into param[], keeping
+ * whatever is already there for the ones that are missing.
+ */
+static void
+ReadParams(int n)
+{
+    char text[64];
+    OpenFileId fid;
+    int len, i, p, inNumber;
+
+    fid = Open("/bparam");
+    if (fid < 0)
+	return;
+    len = Read(text, sizeof(text), fid);
+    Close(fid);
+
+    p = 0;
+    inNumber = 0;
+    for (i = 0; i < len && p < n; i++) {
+	if (text[i] >= '0' && text[i] <= '9') {
+	    if (!inNumber)
+		param[p] = 0;
+	    param[p] = param[p] * 10 + (text[i] - '0');
+	    inNumber = 1;
+	} else if (inNumber) {
+	    p++;
+	    inNumber = 0;
+	}
+    }
+}
+
+/* Build "prefix" followed by the decimal digits of "n" in "name". */
+static void
+MakeName(char *name, char *prefix, int n)
+{
+    char digits[12];
+    int i = 0, j = 0;
+
+    while (prefix[i] != '\0') {
+	name[i] = prefix[i];
+	i++;
+    }
+    do {
+	digits[j++] = '0' + n % 10;
+	n /= 10;
+    } while (n > 0);
+    while (j > 0)
+	name[i++] = digits[--j];
+    name[i] = '\0';
+}
+
+/* Park-Miller "minimal standard" generator, so runs are repeatable. */
+static int seed = 1;
+
+static int
+Random(int range)
+{
+    int hi, lo;
+
+    hi = seed / 127773;
+    lo = seed % 127773;
+    seed = 16807 * lo - 2836 * hi;
+    if (seed <= 0)
+	seed += 2147483647;
+    return seed % range;
+}
+
+/* Report the operation count and stop the machine. */
+static void
+Done(int ops)
+{
+    PrintInt(ops);
+    Halt();
+}
@@ -38,6 +38,8 @@ Alarm::Alarm(bool doRandom)
 //
 //	For now, just provide time-slicing.  Only need to time slice 
 //      if we're currently running something (in other words, not idle).
+//	The timer is never turned off: once nothing but the timer is
+//	pending, Interrupt::Idle halts the machine instead.
 //----------------------------------------------------------------------
 // 23-0302[j]: 每次 Time out 會呼叫的 ISR
 /*
@@ -64,6 +66,10 @@ Alarm::CallBack()
     // 23-0304[j]:  MP3 每 100 Ticks 作一次 Aging 調整
     kernel->scheduler->Aging();
 
+    // the threads on the other CPUs are time sliced when those CPUs
+    // next run
+    kernel->scheduler->TimeOut();
+
     // 23-0306[j]:  MP3 檢查 RQ 中 有沒有適合 Preempt 的 Job
     //              若有，則設定 YieldOnReturn() 回到 OneTick() 後會執行 Yield() = Preempt
     if(kernel->scheduler->CheckPreempt()){
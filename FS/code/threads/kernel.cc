@@ -10,7 +10,12 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "profile.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "tracer.h"
 #include "post.h"
+#include "remotefs.h"
 #include "synchconsole.h" 
 
 // 23-0419[j]: 本檔案 主要進行 kernel 物件的初始化 & 測試
@@ -27,13 +32,48 @@ Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     debugUserProg = FALSE;
+    execfileNum = 0;           // no programs to run yet (see -e)
+    for (int i = 0; i < 10; i++)
+        execfilePry[i] = 0;    // default priority, unless -ep
+    threadNum = 0;
+    blockExec = FALSE;
+    profileSymbols = NULL;     // default is no profiling
+    profileFolded = "nachos.folded";
+    costSpec = NULL;           // default is one tick per instruction
+    icacheSize = dcacheSize = 0;    // default is no caches
+    cacheMissTicks = 10;
+#ifdef USE_TLB
+    tlbEntries = TLBSize;      // the machine has a TLB
+#else
+    tlbEntries = 0;            // default is translating with page tables
+#endif
+    tlbAssoc = 0;
+    tlbPolicy = TLBFIFO;
+    traceFile = NULL;          // default is no event trace
+    traceSize = DefaultTraceSize;
+    traceCategories = "tidu";
+    checkpointFile = NULL;     // default is no checkpoints
+    checkpointTick = -1;
+    restoreFile = NULL;
+    numCPUs = 1;               // default is a uniprocessor
+    cpuSlice = CPUSliceTicks;
+    idleWait = FALSE;          // default is polling for input when idle
+    memorySize = DefaultNumPhysPages * DefaultPageSize;
+    pageSize = DefaultPageSize;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    diskTrace = NULL;          // default is no disk trace
+    diskPolicy = DiskFIFO;
+    diskCacheSize = 0;         // default is no sector cache
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
+    remoteFileFlag = FALSE;     // default is local files only
 #endif
+    networkFlag = FALSE;        // default is no post office
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
+    sharedNetwork = FALSE;      // default is sockets between machines
+    linkSpec = NULL;            // default is NetworkTime per packet
                                 // 0 is the default machine id
 
     // 23-0126[j]: -rs -s -e ... 等指令的功能，請參考 main.cc
@@ -49,6 +89,113 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-bb") == 0) {
+            blockExec = TRUE;
+        } else if (strcmp(argv[i], "-prof") == 0) {
+            ASSERT(i + 1 < argc);
+            profileSymbols = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-pfold") == 0) {
+            ASSERT(i + 1 < argc);
+            profileFolded = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-cost") == 0) {
+            ASSERT(i + 1 < argc);
+            costSpec = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-icache") == 0) {
+            ASSERT(i + 1 < argc);
+            if (!Cache::ParseGeometry(argv[i + 1], &icacheSize, &icacheLine,
+                                      &icacheWays, &icacheWriteBack)) {
+                cout << "Bad I-cache shape " << argv[i + 1]
+                     << " (use size,line,ways[,wb|wt])\n";
+                Abort();
+            }
+            i++;
+        } else if (strcmp(argv[i], "-dcache") == 0) {
+            ASSERT(i + 1 < argc);
+            if (!Cache::ParseGeometry(argv[i + 1], &dcacheSize, &dcacheLine,
+                                      &dcacheWays, &dcacheWriteBack)) {
+                cout << "Bad D-cache shape " << argv[i + 1]
+                     << " (use size,line,ways[,wb|wt])\n";
+                Abort();
+            }
+            i++;
+        } else if (strcmp(argv[i], "-cmiss") == 0) {
+            ASSERT(i + 1 < argc);
+            cacheMissTicks = atoi(argv[i + 1]);
+            ASSERT(cacheMissTicks >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-trace") == 0) {
+            ASSERT(i + 1 < argc);
+            traceFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-tsize") == 0) {
+            ASSERT(i + 1 < argc);
+            traceSize = atoi(argv[i + 1]);
+            ASSERT(traceSize > 0);
+            i++;
+        } else if (strcmp(argv[i], "-tcat") == 0) {
+            ASSERT(i + 1 < argc);
+            traceCategories = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-ckpt") == 0) {
+            ASSERT(i + 1 < argc);
+            checkpointFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-ckat") == 0) {
+            ASSERT(i + 1 < argc);
+            checkpointTick = atoi(argv[i + 1]);
+            ASSERT(checkpointTick >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-restore") == 0) {
+            ASSERT(i + 1 < argc);
+            restoreFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-cpus") == 0) {
+            ASSERT(i + 1 < argc);
+            numCPUs = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-cslice") == 0) {
+            ASSERT(i + 1 < argc);
+            cpuSlice = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-iw") == 0) {
+            idleWait = TRUE;
+        } else if (strcmp(argv[i], "-tlb") == 0) {
+            ASSERT(i + 1 < argc);
+            tlbEntries = atoi(argv[i + 1]);
+            ASSERT(tlbEntries >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-tlbw") == 0) {
+            ASSERT(i + 1 < argc);
+            tlbAssoc = atoi(argv[i + 1]);
+            ASSERT(tlbAssoc >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-tlbp") == 0) {
+            ASSERT(i + 1 < argc);
+            if (!TLBManager::ParsePolicy(argv[i + 1], &tlbPolicy)) {
+                cout << "Unknown TLB replacement policy " << argv[i + 1]
+                     << " (use random, fifo or clock)\n";
+                Abort();
+            }
+            i++;
+        } else if (strcmp(argv[i], "-mem") == 0) {
+            ASSERT(i + 1 < argc);   // size in kilobytes
+            memorySize = atoi(argv[i + 1]);
+            if (memorySize <= 0 || memorySize > MaxMemorySize / 1024) {
+                // checked before it is made bytes, which could overflow
+                cout << "Memory size " << argv[i + 1] << " KB is out of"
+                     << " range (1 to " << MaxMemorySize / 1024 << " KB)"
+                     << endl;
+                Abort();
+            }
+            memorySize *= 1024;
+            i++;
+        } else if (strcmp(argv[i], "-pgsz") == 0) {
+            ASSERT(i + 1 < argc);
+            pageSize = atoi(argv[i + 1]);
+            i++;
 		} else if (strcmp(argv[i], "-e") == 0) {
             // 23-0126[j]: execfile 是 class kernel 的成員 char* execfile[10] in kernel.h
             // 23-0126[j]: 字元指標 execfile 指向 檔案名稱
@@ -76,7 +223,31 @@ Kernel::Kernel(int argc, char **argv)
         // 23-0507[j]: 格式化 Nachos 的模擬 Disk
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
+        } else if (strcmp(argv[i], "-rfs") == 0
+                   || strcmp(argv[i], "-rfst") == 0) {
+            remoteFileFlag = TRUE;
+            networkFlag = TRUE;     // requests go through the post office
 #endif
+        } else if (strcmp(argv[i], "-dt") == 0) {
+            ASSERT(i + 1 < argc);
+            diskTrace = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-ds") == 0) {
+            ASSERT(i + 1 < argc);
+            if (!SynchDisk::ParsePolicy(argv[i + 1], &diskPolicy)) {
+                cout << "Unknown disk scheduling policy " << argv[i + 1]
+                     << " (use fifo, sstf or scan)\n";
+                Abort();
+            }
+            i++;
+        } else if (strcmp(argv[i], "-dc") == 0) {
+            ASSERT(i + 1 < argc);
+            diskCacheSize = atoi(argv[i + 1]);
+            ASSERT(diskCacheSize >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-N") == 0
+                   || strcmp(argv[i], "-tb") == 0) {
+            networkFlag = TRUE;     // main.cc runs something on the network
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
             reliability = atof(argv[i + 1]);
@@ -85,14 +256,34 @@ Kernel::Kernel(int argc, char **argv)
             ASSERT(i + 1 < argc);   // next argument is int
             hostName = atoi(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "-shm") == 0) {
+            sharedNetwork = TRUE;
+        } else if (strcmp(argv[i], "-link") == 0) {
+            ASSERT(i + 1 < argc);
+            linkSpec = argv[i + 1];
+            i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
-	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-s] [-bb]\n";
+            cout << "Partial usage: nachos [-prof coffFile] [-pfold stackFile]\n";
+            cout << "Partial usage: nachos [-cost class=ticks,...]\n";
+            cout << "Partial usage: nachos [-icache size,line,ways[,wb|wt]]"
+                 << " [-dcache size,line,ways[,wb|wt]] [-cmiss #]\n";
+            cout << "Partial usage: nachos [-cpus #] [-cslice #]\n";
+            cout << "Partial usage: nachos [-iw]\n";
+            cout << "Partial usage: nachos [-trace file] [-tsize #] [-tcat tidu]\n";
+            cout << "Partial usage: nachos [-ckpt file] [-ckat #] [-restore file]\n";
+            cout << "Partial usage: nachos [-tlb #] [-tlbw #] [-tlbp random|fifo|clock]\n";
+            cout << "Partial usage: nachos [-mem #KB] [-pgsz #]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
+            cout << "Partial usage: nachos [-rfs] [-rfst]\n";
 #endif
-            cout << "Partial usage: nachos [-n #] [-m #]\n";
+            cout << "Partial usage: nachos [-n #] [-m #] [-shm]\n";
+            cout << "Partial usage: nachos [-link [to:]delay,bandwidth,queue"
+                 << "[,jitter[,burst]]/...]\n";
+            cout << "Partial usage: nachos [-dt traceFile] [-ds fifo|sstf|scan] [-dc #]\n";
 		}
     }
 }
@@ -114,6 +305,10 @@ Kernel::Initialize()
     // But if it ever tries to give up the CPU, we better have a Thread
     // object to save its state. 
 
+    // the tracer comes first, to hear of every thread
+    tracer = (traceFile != NULL) ?
+             new Tracer(traceFile, traceSize, traceCategories) : NULL;
+
 	// 23-0126[j]: 將正在使用CPU的Thread 設為「new Thread = main主程式」
     currentThread = new Thread("main", threadNum++);	
     currentThread->setStatus(RUNNING);     
@@ -123,17 +318,55 @@ Kernel::Initialize()
 
     stats = new Statistics();		// collect statistics
     interrupt = new Interrupt;		// start up interrupt handling
-    scheduler = new Scheduler();	// initialize the ready queue
+    interrupt->SetIdleWait(idleWait);
+    if (numCPUs < 1 || numCPUs > MaxCPUs || cpuSlice <= SystemTick) {
+        cout << "Cannot make " << numCPUs << " CPUs with a " << cpuSlice
+             << "-tick slice (at most " << MaxCPUs << " CPUs, and a slice"
+             << " of more than " << SystemTick << " ticks)" << endl;
+        Abort();
+    }
+    scheduler = new Scheduler(numCPUs, cpuSlice);
+					// initialize the ready queues
     alarm = new Alarm(randomSlice);	// start up time slicing
-    machine = new Machine(debugUserProg);
+    if (!SetMemoryGeometry(memorySize, pageSize)) {
+        cout << "Cannot make " << memorySize << " bytes of memory out of "
+             << pageSize << "-byte pages (pages are a power of 2 from "
+             << MinPageSize << " to " << MaxPageSize << " bytes; memory is"
+             << " at most " << MaxMemorySize / 1024 << " KB)" << endl;
+        Abort();
+    }
+    if (tlbEntries > 0 && tlbAssoc > 0 && tlbEntries % tlbAssoc != 0) {
+        cout << "TLB size " << tlbEntries << " is not a multiple of the"
+             << " associativity " << tlbAssoc << endl;
+        Abort();
+    }
+    machine = new Machine(debugUserProg, blockExec, tlbEntries, tlbAssoc);
+    tlbManager = (machine->tlb != NULL) ? new TLBManager(tlbPolicy) : NULL;
+    if (icacheSize > 0)
+        machine->icache = new Cache(icacheSize, icacheLine, icacheWays,
+                                    icacheWriteBack, cacheMissTicks,
+                                    &stats->icache);
+    if (dcacheSize > 0)
+        machine->dcache = new Cache(dcacheSize, dcacheLine, dcacheWays,
+                                    dcacheWriteBack, cacheMissTicks,
+                                    &stats->dcache);
+    if (costSpec != NULL && !machine->SetCosts(costSpec)) {
+        cout << "Bad instruction costs " << costSpec << " (use a list like"
+             << " mult=12,div=35,load=2,store=1,taken=2,nottaken=1,"
+             << "alu=1,loaduse=1)\n";
+        Abort();
+    }
+    if (profileSymbols != NULL)
+        machine->profiler = new Profiler(profileSymbols, profileFolded);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    synchDisk = new SynchDisk(diskTrace, diskPolicy, diskCacheSize);    //
 
     // 23-0131[j]: 建立一個 AV List
-    avList = new List<int>();
-    for(int i=0;i<NumPhysPages;i++) 
-        avList->Append(i);
+    avList = new int[NumPhysPages];
+    numFreeFrames = NumPhysPages;
+    for(int i=0;i<NumPhysPages;i++)	// frame 0 on top, as it was
+        avList[i] = NumPhysPages - 1 - i;	// first on the list
 
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
@@ -143,9 +376,43 @@ Kernel::Initialize()
     fileSystem = new FileSystem(formatFlag);
 
 #endif // FILESYS_STUB
-    // 23-0301[j]: 應 MP3 要求，將以下註解掉
-    // postOfficeIn = new PostOfficeInput(10);
-    // postOfficeOut = new PostOfficeOutput(reliability);
+    if (checkpointFile == NULL && checkpointTick >= 0) {
+        cout << "-ckat needs a checkpoint file (-ckpt)\n";
+        Abort();
+    }
+#ifndef FILESYS_STUB
+    if (restoreFile != NULL && formatFlag) {
+        cout << "Cannot restore " << restoreFile << " onto a newly"
+             << " formatted disk\n";
+        Abort();
+    }
+#endif
+    checkpointer = (checkpointFile != NULL) ?
+                   new Checkpointer(checkpointFile, checkpointTick) : NULL;
+    // the post office polls the network for as long as Nachos runs, so
+    // that it would never halt by itself; start it only when it is used
+    if (networkFlag) {
+        postOfficeIn = new PostOfficeInput(10);
+        postOfficeOut = new PostOfficeOutput(reliability);
+        if (linkSpec != NULL && !postOfficeOut->SetLinks(linkSpec)) {
+            cout << "Bad link model " << linkSpec << " (use a list like"
+                 << " 1:500,0.25,16,50,2/2:100,1,8)\n";
+            Abort();
+        }
+    } else {
+        postOfficeIn = NULL;
+        postOfficeOut = NULL;
+    }
+#ifndef FILESYS_STUB
+    // like the post office, these run for as long as Nachos does
+    if (remoteFileFlag) {
+        fileServer = new FileServer();
+        remoteFiles = new RemoteFileClient();
+    } else {
+        fileServer = NULL;
+        remoteFiles = NULL;
+    }
+#endif
 
     interrupt->Enable();
 }
@@ -160,14 +427,20 @@ Kernel::~Kernel()
     delete interrupt;
     delete scheduler;
     delete alarm;
+    if (tlbManager != NULL)
+        delete tlbManager;
+    if (checkpointer != NULL)
+        delete checkpointer;
+    if (tracer != NULL)
+        delete tracer;
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
     delete fileSystem;
-    // 23-0301[j]: 應 MP3 要求，將以下註解掉
-    // delete postOfficeIn;
-    // delete postOfficeOut;
+    delete postOfficeIn;
+    delete postOfficeOut;
+    delete [] avList;
     
     Exit(0);
 }
@@ -208,17 +481,18 @@ Kernel::ThreadSelfTest() {
 // 23-0419[j]: 測試「模擬的 輸出輸入 機器」
 void
 Kernel::ConsoleTest() {
-    char ch;
+    char line[ConsoleLineSize];
+    int length;
 
     cout << "Testing the console device.\n" 
-        << "Typed characters will be echoed, until ^D is typed.\n"
+        << "Typed lines will be echoed, until ^D is typed.\n"
         << "Note newlines are needed to flush input through UNIX.\n";
     cout.flush();
 
     do {
-        ch = synchConsoleIn->GetChar();
-        if(ch != EOF) synchConsoleOut->PutChar(ch);   // echo it!
-    } while (ch != EOF);
+        length = synchConsoleIn->GetLine(line, ConsoleLineSize);
+        synchConsoleOut->PutString(line, length);   // echo it!
+    } while (length > 0);
 
     cout << "\n";
 
@@ -314,6 +588,14 @@ void ForkExecute(Thread *t)
 //             = 切到 其他在ReadyQueue的 Thread
 void Kernel::ExecAll()
 {
+    // a restored program carries on from its checkpoint, ahead of any
+    // program started afresh
+    if (restoreFile != NULL) {
+        t[threadNum] = Checkpointer::Restore(restoreFile, threadNum);
+        if (t[threadNum] == NULL)
+            Abort();
+        threadNum++;
+    }
 	for (int i=1;i<=execfileNum;i++) {
 		int a = Exec(execfile[i],execfilePry[i]);
 	}
@@ -380,13 +662,14 @@ int Kernel::Exec(char* name,int pry)
 
 // 23-0131[j]: 實作 PopFreeFrame()
 int Kernel::PopFreeFrame(){
-    if(avList->IsEmpty())
+    if(numFreeFrames == 0)
         return -1;
-    return avList->RemoveFront();
+    return avList[--numFreeFrames];
 }
 // 23-0201[j]: 實作 PushFreeFrame()
 void Kernel::PushFreeFrame(int f){
     if(f<0) return;
-    avList->Prepend(f);
+    ASSERT(numFreeFrames < NumPhysPages);
+    avList[numFreeFrames++] = f;
     return;
 }
\ No newline at end of file
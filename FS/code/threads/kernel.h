@@ -14,12 +14,18 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "disk.h"
+#include "tlbmanager.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
+class FileServer;
+class RemoteFileClient;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class Checkpointer;
+class Tracer;
 
 typedef int OpenFileId;
 
@@ -60,6 +66,7 @@ class Kernel {
     // 23-0131[j]: Pop/Push Free Frame from AVList
     int PopFreeFrame();
     void PushFreeFrame(int f);
+    int NumFreeFrames() { return numFreeFrames; }
 
 // These are public for notational convenience; really, 
 // they're global variables used everywhere.
@@ -72,17 +79,29 @@ class Kernel {
     Statistics *stats;		// performance metrics
     Alarm *alarm;		// the software alarm clock    
     Machine *machine;           // the simulated CPU
+    TLBManager *tlbManager;     // loads the CPU's TLB, NULL if it has none
+    Checkpointer *checkpointer; // saves user programs, NULL unless -ckpt
+    Tracer *tracer;             // records kernel events, NULL unless -trace
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;       // 23-0507[j]: 提供 User 操作 Disk 的介面
     FileSystem *fileSystem;     // 23-0507[j]: NachOS File System(包含 Dir、Bitmap)
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
+#ifndef FILESYS_STUB
+    FileServer *fileServer;     // serves our files to others, NULL unless -rfs
+    RemoteFileClient *remoteFiles; // opens files on others, NULL unless -rfs
+#endif
 
     // 23-0131[j]: 透過一個 AV-List 來儲存 所有的 Free Frame
-    List<int> *avList;
+    // a stack, rather than a List, whose Append checks the whole list
+    // first: with tens of thousands of frames, filling it took minutes
+    int *avList;		// the free frames; the top is used next
+    int numFreeFrames;		// how many are on "avList"
 
     int hostName;               // machine identifier
+    bool sharedNetwork;         // network through shared memory, not
+                                // sockets (-shm)
 
   private:
 
@@ -96,11 +115,47 @@ class Kernel {
 	int threadNum;                // 23-0126[j]: 正在使用的 Threads 數量 = 最後一個 Thread 的編號
     bool randomSlice;		        // enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
+    bool blockExec;             // run user code a basic block at a time
+    char *profileSymbols;       // COFF file of the program to profile,
+                                // NULL if not profiling
+    const char *profileFolded;  // file to write the profile's stacks to
+    char *costSpec;             // ticks for each class of instruction,
+                                // NULL for one each
+    int icacheSize, icacheLine, icacheWays;
+    bool icacheWriteBack;       // shape of the instruction cache;
+                                // no cache if the size is 0
+    int dcacheSize, dcacheLine, dcacheWays;
+    bool dcacheWriteBack;       // and of the data cache
+    int cacheMissTicks;         // time for a cache to go to memory
+    int tlbEntries;             // size of the machine's TLB, 0 if none
+    int tlbAssoc;               // entries per TLB set, 0 for fully
+                                // associative
+    TLBPolicy tlbPolicy;        // which TLB entry a miss replaces
+    char *traceFile;            // where to write the event trace,
+                                // NULL if not tracing
+    int traceSize;              // # of events the trace keeps
+    const char *traceCategories; // which events it records
+    char *checkpointFile;       // where to save checkpoints, NULL if none
+    int checkpointTick;         // when to save one, -1 for only when
+                                // a program asks
+    char *restoreFile;          // checkpoint to start from, NULL if none
+    int numCPUs;                // CPUs the machine has
+    int cpuSlice;               // ticks each CPU is simulated for
+                                // before the next
+    int memorySize;             // bytes of physical memory
+    int pageSize;               // bytes per page
+    bool idleWait;              // wait in the host, not poll, when idle
+    bool networkFlag;           // start the post office?
+    char *linkSpec;             // links to model (-link), or NULL
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
+    char *diskTrace;            // file to record disk requests in
+    DiskPolicy diskPolicy;      // disk scheduling policy
+    int diskCacheSize;          // # of sectors the SynchDisk caches
 #ifndef FILESYS_STUB
     bool formatFlag;            // format the disk if this is true
+    bool remoteFileFlag;        // share files with other machines?
 #endif
 };
 
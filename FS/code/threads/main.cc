@@ -21,6 +21,9 @@
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -ib times the pending interrupt queue (see Interrupt::Benchmark)
+//    -tb times a bulk transfer between machines 0 and 1 over the
+//	  reliable transport (see Connection::Benchmark)
 //
 // 23-0427[j]: 檔案系統相關的指令
 //
@@ -31,6 +34,8 @@
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -rfst checks that a remote write whose reply is lost is not
+//	  done twice (see FileServer::SelfTest)
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -44,6 +49,10 @@
 #include "filesys.h"
 #include "openfile.h"
 #include "sysdep.h"
+#include "diskreplay.h"
+#include "tracer.h"
+#include "transport.h"
+#include "remotefs.h"
 
 // global variables
 Kernel *kernel;
@@ -209,6 +218,13 @@ main(int argc, char **argv)
     bool threadTestFlag = false;
     bool consoleTestFlag = false;
     bool networkTestFlag = false;
+    char *diskReplayFile = NULL;      // disk trace to replay
+    int diskReplaySpeedup = 1;
+    int intBenchEvents = 0;           // # of interrupts to benchmark
+    int transportBenchBytes = 0;      // # of bytes to time sending over
+    int transportBenchWindow = 0;     // the transport, and its window
+    char *traceExportFile = NULL;     // event trace to convert to JSON
+    char *traceJSONFile = NULL;
 
 // 23-0507[j]: 若採用 Real NachOS File System
 #ifndef FILESYS_STUB
@@ -220,6 +236,7 @@ main(int argc, char **argv)
     char *removeFileName = NULL;
     bool dirListFlag = false;
     bool dumpFlag = false;
+    bool remoteFileTestFlag = false;
 
     // 23-0510[j]: MP4 實作 Subdirectory 用到的工具
     char *subDirPath = NULL;
@@ -257,6 +274,36 @@ main(int argc, char **argv)
       	else if (strcmp(argv[i], "-N") == 0) {
       	    networkTestFlag = TRUE;
       	}
+      	else if (strcmp(argv[i], "-dr") == 0) {
+      	    ASSERT(i + 1 < argc);
+      	    diskReplayFile = argv[i + 1];
+      	    i++;
+      	}
+      	else if (strcmp(argv[i], "-drs") == 0) {
+      	    ASSERT(i + 1 < argc);
+      	    diskReplaySpeedup = atoi(argv[i + 1]);
+      	    ASSERT(diskReplaySpeedup >= 1);
+      	    i++;
+      	}
+      	else if (strcmp(argv[i], "-tj") == 0) {
+      	    ASSERT(i + 2 < argc);
+      	    traceExportFile = argv[i + 1];
+      	    traceJSONFile = argv[i + 2];
+      	    i += 2;
+      	}
+      	else if (strcmp(argv[i], "-ib") == 0) {
+      	    ASSERT(i + 1 < argc);
+      	    intBenchEvents = atoi(argv[i + 1]);
+      	    ASSERT(intBenchEvents > 0);
+      	    i++;
+      	}
+      	else if (strcmp(argv[i], "-tb") == 0) {
+      	    ASSERT(i + 2 < argc);
+      	    transportBenchBytes = atoi(argv[i + 1]);
+      	    transportBenchWindow = atoi(argv[i + 2]);
+      	    ASSERT(transportBenchBytes > 0 && transportBenchWindow > 0);
+      	    i += 2;
+      	}
 
 #ifndef FILESYS_STUB
 // 23-0507[j]: 若採用 Real NachOS File System
@@ -291,6 +338,9 @@ main(int argc, char **argv)
         else if (strcmp(argv[i], "-D") == 0) {
             dumpFlag = true;
         }
+        else if (strcmp(argv[i], "-rfst") == 0) {
+            remoteFileTestFlag = true;
+        }
 
         // 23-0510[j]: '-mkdir' 建立一個 新資料夾(new Dir)
         else if (strcmp(argv[i], "-mkdir") == 0) {
@@ -315,6 +365,10 @@ main(int argc, char **argv)
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
             cout << "Partial usage: nachos [-x programName]\n";
 	          cout << "Partial usage: nachos [-K] [-C] [-N]\n";
+            cout << "Partial usage: nachos [-dr traceFile] [-drs speedup]\n";
+            cout << "Partial usage: nachos [-ib numInterrupts]\n";
+            cout << "Partial usage: nachos [-tb numBytes window]\n";
+            cout << "Partial usage: nachos [-tj traceFile jsonFile]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
@@ -344,6 +398,25 @@ main(int argc, char **argv)
     if (networkTestFlag) {
       kernel->NetworkTest();   // two-machine test of the network
     }
+    if (diskReplayFile != NULL) {
+      DiskReplay *replay = new DiskReplay(diskReplayFile, diskReplaySpeedup);
+      replay->Run();           // replay a recorded disk trace
+      delete replay;
+      kernel->interrupt->Halt();
+    }
+    if (traceExportFile != NULL) {
+      if (!Tracer::Export(traceExportFile, traceJSONFile))
+        cout << traceExportFile << " is not a Nachos event trace\n";
+      kernel->interrupt->Halt();
+    }
+    if (intBenchEvents > 0) {
+      Interrupt::Benchmark(intBenchEvents);  // time the interrupt queue
+      kernel->interrupt->Halt();
+    }
+    if (transportBenchBytes > 0) {
+      Connection::Benchmark(transportBenchBytes, transportBenchWindow);
+      kernel->interrupt->Halt();
+    }
 
 #ifndef FILESYS_STUB
 // 23-0507[j]: 若採用 Real NachOS File System
@@ -376,6 +449,10 @@ main(int argc, char **argv)
     if(recurRemove) {
         kernel->fileSystem->RecursiveRemove(dirPath);
     }
+    if (remoteFileTestFlag) {
+      kernel->fileServer->SelfTest();  // a lost reply to a remote write
+      kernel->interrupt->Halt();
+    }
 #endif // FILESYS_STUB
 
     // finally, run an initial user program if requested to do so
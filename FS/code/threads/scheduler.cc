@@ -4,7 +4,8 @@
 //
 // 	These routines assume that interrupts are already disabled.
 //	If interrupts are disabled, we can assume mutual exclusion
-//	(since we are on a uniprocessor).
+//	(since we are on a uniprocessor -- or, with several CPUs, since
+//	CPUs are only switched while interrupts are enabled; see below).
 //
 // 	NOTE: We can't use Locks to provide mutual exclusion here, since
 // 	if we needed to wait for a lock, and the lock was busy, we would 
@@ -14,6 +15,24 @@
 // 	Very simple implementation -- no priorities, straight FIFO.
 //	Might need to be improved in later assignments.
 //
+//	Multiprocessor simulation: with "nachos -cpus N", the machine has
+//	N CPUs, each with its own ready lists, clock and tick counts.
+//	There is still only one host thread, so the CPUs are simulated
+//	one at a time: the current one runs until its time slice
+//	("-cslice") is over, then OneTick asks NextCPU to switch to the
+//	CPU whose clock is furthest behind.  The clocks therefore stay
+//	within a slice of each other.  kernel->currentThread is the
+//	thread of the current CPU; running[] holds those of the others.
+//
+//	A thread made ready goes to an idle CPU if there is one, else on
+//	the lists of the CPU it last ran on.  A CPU with nothing on its
+//	own lists steals from the CPU with the most ready threads.
+//
+//	Since CPUs are only switched in OneTick, and only when interrupts
+//	are enabled, turning interrupts off still gives mutual exclusion
+//	across all the CPUs (it acts as the kernel's one big spinlock):
+//	semaphores, locks and these routines need no change.
+//
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -22,6 +41,7 @@
 #include "debug.h"
 #include "scheduler.h"
 #include "main.h"
+#include "tracer.h"
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
@@ -29,12 +49,24 @@
 //	Initially, no ready threads.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(int cpus, int sliceTicks)
 { 
-    // 23-0303[j]:  MP3 始化 3條 RQ
-    readyList_L3 = new List<Thread *>; 
-    readyList_L2 = new SortedList<Thread *>(CompareForPriority); 
-    readyList_L1 = new SortedList<Thread *>(CompareForSFJ);
+    ASSERT(cpus >= 1 && cpus <= MaxCPUs && sliceTicks > 0);
+    numCPUs = cpus;
+    current = 0;
+    this->sliceTicks = sliceTicks;
+    for (int i = 0; i < numCPUs; i++) {
+        // 23-0303[j]:  MP3 始化 3條 RQ
+        readyList_L3[i] = new List<Thread *>; 
+        readyList_L2[i] = new SortedList<Thread *>(CompareForPriority); 
+        readyList_L1[i] = new SortedList<Thread *>(CompareForSFJ);
+        running[i] = NULL;		// the other CPUs start out idle
+        timeOut[i] = FALSE;
+    }
+    running[0] = kernel->currentThread;
+    kernel->stats->numCPUs = numCPUs;
+    if (numCPUs > 1)
+        kernel->interrupt->SetSliceEnd(kernel->stats->totalTicks + sliceTicks);
 
     preempFlag = FALSE;
 
@@ -48,9 +80,11 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList_L3; 
-    delete readyList_L2; 
-    delete readyList_L1; 
+    for (int i = 0; i < numCPUs; i++) {
+        delete readyList_L3[i]; 
+        delete readyList_L2[i]; 
+        delete readyList_L1[i]; 
+    }
 } 
 
 //----------------------------------------------------------------------
@@ -58,6 +92,10 @@ Scheduler::~Scheduler()
 // 	Mark a thread as ready, but not running.
 //	Put it on the ready list, for later scheduling onto the CPU.
 //
+//	With several CPUs, a thread goes straight to an idle CPU if
+//	there is one (unless the current thread is itself looking for
+//	something to run), else on the lists of the CPU it last ran on.
+//
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
 // 23-0128[j]: 功能：將 thread 排入 ReadyQueue
@@ -71,6 +109,23 @@ Scheduler::ReadyToRun (Thread *thread)
     DEBUG(dbgThread, "Putting thread on ready list: " << thread->getName());
     
     ThreadStatus prevStat = thread->getStatus();
+    int cpu = current;
+
+    // 23-0306[j]:  MP3 首次進入 Ready Queue 時 = New Thread 剛被創建的時間
+    if(prevStat == JUST_CREATED)
+        thread->busrt->SetAccumWait(kernel->stats->totalTicks);
+
+    if (numCPUs > 1) {
+        for (int i = 0; i < numCPUs; i++) {
+            if (running[i] == NULL && thread != kernel->currentThread
+                    && kernel->currentThread->getStatus() == RUNNING) {
+                Dispatch(i, thread);
+                return;
+            }
+        }
+        if (thread->getCPU() >= 0)
+            cpu = thread->getCPU();
+    }
 
     thread->setStatus(READY);
 
@@ -78,34 +133,33 @@ Scheduler::ReadyToRun (Thread *thread)
     if(CheckThreadRQ(thread) == 3){
         DEBUG(dbgSch, "[A] Tick[" << kernel->stats->totalTicks 
             << "]: Thread [ " << thread->getID() << " ] is inserted into queue L[ 3 ]");
-        readyList_L3->Append(thread);
+        readyList_L3[cpu]->Append(thread);
     }
     else if(CheckThreadRQ(thread) == 2){
         DEBUG(dbgSch, "[A] Tick[" << kernel->stats->totalTicks 
             << "]: Thread [ " << thread->getID() << " ] is inserted into queue L[ 2 ]");
-        readyList_L2->Insert(thread);
+        readyList_L2[cpu]->Insert(thread);
     }
     else if(CheckThreadRQ(thread) == 1){
         DEBUG(dbgSch, "[A] Tick[" << kernel->stats->totalTicks 
             << "]: Thread [ " << thread->getID() << " ] is inserted into queue L[ 1 ]");
-        readyList_L1->Insert(thread);
+        readyList_L1[cpu]->Insert(thread);
     }
 
     // 23-0306[j]:  MP3 檢查剛 insert 到 RQ 者，是不是 可以 優先於 currentThread 執行 = 插隊 
     //              注意：此處僅檢查「不是從 Running 回來的人」
     //                    因為「Running 回來的人，表示剛被插隊，表示 currentThread 有插隊的優先權，故不必反覆比較 」
-    if(prevStat != RUNNING)
+    if(prevStat != RUNNING && cpu == current)
         SetPreempt( CheckPreempt() );
-
-    // 23-0306[j]:  MP3 首次進入 Ready Queue 時 = New Thread 剛被創建的時間
-    if(prevStat == JUST_CREATED)
-        thread->busrt->SetAccumWait(kernel->stats->totalTicks);
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
 // 	Return the next thread to be scheduled onto the CPU.
 //	If there are no ready threads, return NULL.
+//
+//	With several CPUs, a CPU whose own lists are empty steals the
+//	thread the CPU with the most ready threads would run next.
 // Side effect: 
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
@@ -116,25 +170,54 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
+    Thread *thread;
+    int victim = -1;
+
     ASSERT(kernel->interrupt->getLevel() == IntOff);
 
+    thread = TakeFrom(current);
+    if (thread != NULL || numCPUs == 1)
+        return thread;
+
+    for (int i = 0; i < numCPUs; i++) {
+        if (NumReady(i) > 0 && (victim < 0 || NumReady(i) > NumReady(victim)))
+            victim = i;
+    }
+    if (victim < 0)
+        return NULL;
+    thread = TakeFrom(victim);
+    kernel->stats->cpuSteals[current]++;
+    DEBUG(dbgThread, "CPU " << current << " steals " << thread->getName()
+                        << " from CPU " << victim);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TakeFrom
+// 	Dequeue the thread a CPU should run next, from the highest level
+//	ready list that is not empty; NULL if they all are.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::TakeFrom(int cpu)
+{
     // 23-0303[j]:  MP3 從最高Level的 RQ 先取出 Thread
     //              Lv1 RQ 空了，再去 Lv2 RQ Dequeue，以此類推
 
-    if (!readyList_L1->IsEmpty()){
+    if (!readyList_L1[cpu]->IsEmpty()){
         DEBUG(dbgSch, "[B] Tick[" << kernel->stats->totalTicks 
-            << "]: Thread [ " << readyList_L1->Front()->getID() << " ] is removed from queue L[ 1 ]");
-        return readyList_L1->RemoveFront();
+            << "]: Thread [ " << readyList_L1[cpu]->Front()->getID() << " ] is removed from queue L[ 1 ]");
+        return readyList_L1[cpu]->RemoveFront();
     }
-    else if (!readyList_L2->IsEmpty()){
+    else if (!readyList_L2[cpu]->IsEmpty()){
         DEBUG(dbgSch, "[B] Tick[" << kernel->stats->totalTicks 
-            << "]: Thread [ " << readyList_L2->Front()->getID() << " ] is removed from queue L[ 2 ]");
-        return readyList_L2->RemoveFront();
+            << "]: Thread [ " << readyList_L2[cpu]->Front()->getID() << " ] is removed from queue L[ 2 ]");
+        return readyList_L2[cpu]->RemoveFront();
     }
-    else if (!readyList_L3->IsEmpty()){
+    else if (!readyList_L3[cpu]->IsEmpty()){
         DEBUG(dbgSch, "[B] Tick[" << kernel->stats->totalTicks 
-            << "]: Thread [ " << readyList_L3->Front()->getID() << " ] is removed from queue L[ 3 ]");
-        return readyList_L3->RemoveFront();
+            << "]: Thread [ " << readyList_L3[cpu]->Front()->getID() << " ] is removed from queue L[ 3 ]");
+        return readyList_L3[cpu]->RemoveFront();
     }
     else{ return NULL; }
 
@@ -216,6 +299,10 @@ Scheduler::Run (Thread *nextThread, bool finishing)
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    TRACE(TraceSwitch, oldThread->getID(), nextThread->getID());
+    running[current] = nextThread;
+    nextThread->setCPU(current);
+    timeOut[current] = FALSE;		// it gets a whole time slice
     kernel->currentThread = nextThread;  // switch to the next thread
     nextThread->setStatus(RUNNING);      // nextThread is now running
 
@@ -294,10 +381,7 @@ Scheduler::CheckToBeDestroyed()
 
         // 23-0303[j]:  可以在此回收 Thread 的記憶體空間
         // cout << "Destroyed Thread: " << kernel->currentThread->getName() << endl;
-        if(toBeDestroyed->space)
-            toBeDestroyed->space->~AddrSpace();
-
-        delete toBeDestroyed;
+        delete toBeDestroyed;	// and, with it, its address space
 	toBeDestroyed = NULL;
     }
 }
@@ -312,12 +396,16 @@ Scheduler::Print()
 {
     // 23-0303[j]:  MP3 改成 印出3條RQ
 
-    cout << "Lv1 Ready Queue:\n";
-    readyList_L1->Apply(ThreadPrint);
-    cout << "\nLv2 Ready Queue:\n";
-    readyList_L2->Apply(ThreadPrint);
-    cout << "\nLv3 Ready Queue:\n";
-    readyList_L3->Apply(ThreadPrint);
+    for (int i = 0; i < numCPUs; i++) {
+        if (numCPUs > 1)
+            cout << (i > 0 ? "\n" : "") << "CPU " << i << ":\n";
+        cout << "Lv1 Ready Queue:\n";
+        readyList_L1[i]->Apply(ThreadPrint);
+        cout << "\nLv2 Ready Queue:\n";
+        readyList_L2[i]->Apply(ThreadPrint);
+        cout << "\nLv3 Ready Queue:\n";
+        readyList_L3[i]->Apply(ThreadPrint);
+    }
 
     // cout << "Ready list contents:\n";
     // readyList->Apply(ThreadPrint);
@@ -347,25 +435,33 @@ int CompareForPriority(Thread * newThread, Thread * currentThread){
 int 
 Scheduler::CheckThreadRQ(Thread* thread){
     int thread_pry = thread->getPriority();
-    if(thread_pry < 50 && thread_pry >=0) return 3;
-    else if(thread_pry < 100 && thread_pry >=50) return 2;
-    else if(thread_pry < 150 && thread_pry >=100) return 1;
+    if(thread_pry < 50) return 3;
+    else if(thread_pry < 100) return 2;
+    else return 1;
 }
 
 // 23-0304[j]:  MP3 Aging
 void 
 Scheduler::Aging(){
+    for (int i = 0; i < numCPUs; i++)
+        AgeCPU(i);
+}
+
+// 23-0304[j]:  MP3 Aging, of the threads on one CPU's lists
+void 
+Scheduler::AgeCPU(int cpu){
 
     // 23-0304[j]:  重排 RQ
-    ListIterator<Thread*> *iter3 = new ListIterator<Thread*>(readyList_L3);
-    ListIterator<Thread*> *iter2 = new ListIterator<Thread*>(readyList_L2);
-    ListIterator<Thread*> *iter1 = new ListIterator<Thread*>(readyList_L1);
+    ListIterator<Thread*> *iter3 = new ListIterator<Thread*>(readyList_L3[cpu]);
+    ListIterator<Thread*> *iter2 = new ListIterator<Thread*>(readyList_L2[cpu]);
+    ListIterator<Thread*> *iter1 = new ListIterator<Thread*>(readyList_L1[cpu]);
 
     Thread* t = NULL;
 
-    if(!readyList_L3->IsEmpty()){
-        for(; !iter3->IsDone(); iter3->Next()){
+    if(!readyList_L3[cpu]->IsEmpty()){
+        for(; !iter3->IsDone(); ){
             t = iter3->Item();
+            iter3->Next();     // before t is moved, freeing its element
 
             if((t->getStatus() == READY) && t->busrt){
                 int waitTime = kernel->stats->totalTicks - (int)t->busrt->getTotal() - t->busrt->GetAccumWait();
@@ -380,19 +476,20 @@ Scheduler::Aging(){
                     << "]: Thread [ " << t->getID() 
                     << " ] changes its priority from [ "<< oldPriority <<" ] to [ "<< t->getPriority() <<" ]");
 
-                    readyList_L3->Remove(t);
+                    readyList_L3[cpu]->Remove(t);
 
-                    if(CheckThreadRQ(t)==3) readyList_L3->Append(t);
+                    if(CheckThreadRQ(t)==3) readyList_L3[cpu]->Append(t);
                     else
-                        readyList_L2->Insert(t);
+                        readyList_L2[cpu]->Insert(t);
                 }
             }
         }
     }
 
-    if(!readyList_L2->IsEmpty()){
-        for(; !iter2->IsDone(); iter2->Next()){
+    if(!readyList_L2[cpu]->IsEmpty()){
+        for(; !iter2->IsDone(); ){
             t = iter2->Item();
+            iter2->Next();     // before t is moved, freeing its element
 
             if((t->getStatus() == READY) && t->busrt){
                 int waitTime = kernel->stats->totalTicks - (int)t->busrt->getTotal() - t->busrt->GetAccumWait();
@@ -407,17 +504,17 @@ Scheduler::Aging(){
                     << "]: Thread [ " << t->getID() 
                     << " ] changes its priority from [ "<< oldPriority <<" ] to [ "<< t->getPriority() <<" ]");
 
-                    readyList_L2->Remove(t);
+                    readyList_L2[cpu]->Remove(t);
 
-                    if(CheckThreadRQ(t)==2) readyList_L2->Insert(t);
+                    if(CheckThreadRQ(t)==2) readyList_L2[cpu]->Insert(t);
                     else
-                        readyList_L1->Insert(t);
+                        readyList_L1[cpu]->Insert(t);
                 }
             }
         }
     }
 
-    if(!readyList_L1->IsEmpty()){
+    if(!readyList_L1[cpu]->IsEmpty()){
         for(; !iter1->IsDone(); iter1->Next()){
             t = iter1->Item();
 
@@ -439,7 +536,10 @@ Scheduler::Aging(){
         }
     }
 
-    // delete iter1,iter2,iter3;
+    // this runs on every timer interrupt, so the iterators must not leak
+    delete iter1;
+    delete iter2;
+    delete iter3;
 }
 
 // 23-0306[j]:  MP3 實現 Preemptive 的函數
@@ -462,25 +562,259 @@ Scheduler::CheckPreempt(){
     // 23-0305[j]:  L3 Job Running & 目前 RQ_L1、RQ_L2 非空
     if((CheckThreadRQ(kernel->currentThread)==3) 
         && kernel->currentThread->getStatus()==RUNNING
-        && !(readyList_L1->IsEmpty() && readyList_L2->IsEmpty())){
+        && !(readyList_L1[current]->IsEmpty() && readyList_L2[current]->IsEmpty())){
 
         preempFlag = TRUE;
     }
     // 23-0305[j]:  L2 Job Running & 目前 RQ_L1 非空
     else if((CheckThreadRQ(kernel->currentThread)==2) 
             && kernel->currentThread->getStatus()==RUNNING
-            && !readyList_L1->IsEmpty()){
+            && !readyList_L1[current]->IsEmpty()){
 
             preempFlag = TRUE;
     }
     // 23-0305[j]:  L1 Job Running & 目前 RQ_L1非空 且 RQ_L1中的 Job 更短！
     else if((CheckThreadRQ(kernel->currentThread)==1) 
             && kernel->currentThread->getStatus()==RUNNING
-            && !readyList_L1->IsEmpty() && readyList_L1->Front()->busrt){
+            && !readyList_L1[current]->IsEmpty() && readyList_L1[current]->Front()->busrt){
 
-            if(readyList_L1->Front()->busrt->getNext() < kernel->currentThread->busrt->getNext())
+            if(readyList_L1[current]->Front()->busrt->getNext() < kernel->currentThread->busrt->getNext())
                 return TRUE;        
     }
 
     return FALSE;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NumReady
+// 	Return the number of threads on a CPU's ready lists.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NumReady(int cpu)
+{
+    return readyList_L1[cpu]->NumInList() + readyList_L2[cpu]->NumInList()
+           + readyList_L3[cpu]->NumInList();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Dispatch
+// 	Give an idle CPU a thread to run.  The CPU has been idle since
+//	its clock stopped; it starts running the thread now.
+//
+//	"cpu" -- the idle CPU
+//	"thread" -- the thread to run on it
+//----------------------------------------------------------------------
+
+void
+Scheduler::Dispatch(int cpu, Thread *thread)
+{
+    Statistics *stats = kernel->stats;
+
+    ASSERT(running[cpu] == NULL && cpu != current);
+    if (stats->cpuTotalTicks[cpu] < stats->totalTicks) {
+        stats->cpuIdleTicks[cpu] += stats->totalTicks - stats->cpuTotalTicks[cpu];
+        stats->cpuTotalTicks[cpu] = stats->totalTicks;
+    }
+    DEBUG(dbgThread, "Dispatching " << thread->getName() << " on CPU " << cpu);
+    TRACE(TraceDispatch, cpu, thread->getID());
+    running[cpu] = thread;
+    timeOut[cpu] = FALSE;
+    thread->setCPU(cpu);
+    thread->setStatus(RUNNING);
+    if (thread->busrt)
+        thread->busrt->Start(stats->cpuUserTicks[cpu]);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SaveCPU, Scheduler::LoadCPU
+// 	Switch out, or in, the clock and tick counts of a CPU: those of
+//	the CPU being simulated are the ones in kernel->stats.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SaveCPU(int cpu)
+{
+    Statistics *stats = kernel->stats;
+
+    stats->cpuTotalTicks[cpu] = stats->totalTicks;
+    stats->cpuIdleTicks[cpu] = stats->idleTicks;
+    stats->cpuSystemTicks[cpu] = stats->systemTicks;
+    stats->cpuUserTicks[cpu] = stats->userTicks;
+}
+
+void
+Scheduler::LoadCPU(int cpu)
+{
+    Statistics *stats = kernel->stats;
+
+    stats->totalTicks = stats->cpuTotalTicks[cpu];
+    stats->idleTicks = stats->cpuIdleTicks[cpu];
+    stats->systemTicks = stats->cpuSystemTicks[cpu];
+    stats->userTicks = stats->cpuUserTicks[cpu];
+    current = cpu;
+    kernel->interrupt->SetSliceEnd(stats->totalTicks + sliceTicks);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchTo
+// 	Switch the host to the thread of another CPU, which has just
+//	been loaded.  Unlike Run, the thread we leave keeps running on
+//	its own CPU; we return once a CPU switch comes back to it.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchTo(Thread *nextThread)
+{
+    Thread *oldThread = kernel->currentThread;
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+
+    if (oldThread->space != NULL) {	// if this thread is a user program,
+        oldThread->SaveUserState(); 	// save the user's CPU registers
+        oldThread->space->SaveState();
+    }
+    oldThread->CheckOverflow();
+
+    kernel->currentThread = nextThread;
+    DEBUG(dbgThread, "Switching to CPU " << current << ", running "
+                        << nextThread->getName());
+
+    SWITCH(oldThread, nextThread);
+
+    // we're back, on the CPU we left
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    CheckToBeDestroyed();
+    if (oldThread->space != NULL) {
+        oldThread->RestoreUserState();
+        oldThread->space->RestoreState();
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextCPU
+// 	The current CPU's time slice is over: switch to the busy CPU
+//	whose clock is furthest behind, if it is not this one.  Idle CPUs
+//	have nothing to simulate; they catch up when given a thread.
+//
+//	Returns TRUE if the timer expired while this CPU was switched
+//	out, and its thread should now be time sliced.
+//
+//	Called by OneTick with interrupts off.  They must be turned back
+//	on without advancing the clock (SetLevel would), or the next
+//	tick could end the new slice and call us again, without end.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::NextCPU()
+{
+    Statistics *stats = kernel->stats;
+    int next = current;
+    bool result;
+
+    if (numCPUs == 1)
+        return FALSE;
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    for (int i = 0; i < numCPUs; i++) {
+        if (i != current && running[i] != NULL
+                && stats->cpuTotalTicks[i] < (next == current ?
+                        stats->totalTicks : stats->cpuTotalTicks[next]))
+            next = i;
+    }
+    if (next == current) {		// we are furthest behind: go on
+        kernel->interrupt->SetSliceEnd(stats->totalTicks + sliceTicks);
+    } else {
+        SaveCPU(current);
+        LoadCPU(next);
+        SwitchTo(running[next]);
+    }
+    result = timeOut[current]
+             && CheckThreadRQ(kernel->currentThread) == 3;
+    timeOut[current] = FALSE;
+    return result;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::IdleCPU
+// 	The current thread is blocked, and no CPU has a thread ready to
+//	run.  Rather than idle the machine, leave this CPU idle and let
+//	the busy CPU furthest behind run.  Returns FALSE, with nothing
+//	done, if there is no other busy CPU; else TRUE, once the thread
+//	has been given a CPU again (it never runs again if it is
+//	"finishing").
+//----------------------------------------------------------------------
+
+bool
+Scheduler::IdleCPU(bool finishing)
+{
+    Statistics *stats = kernel->stats;
+    int next = -1;
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    for (int i = 0; i < numCPUs; i++) {
+        if (i != current && running[i] != NULL && (next < 0
+                || stats->cpuTotalTicks[i] < stats->cpuTotalTicks[next]))
+            next = i;
+    }
+    if (next < 0)
+        return FALSE;
+
+    if (finishing) {
+        ASSERT(toBeDestroyed == NULL);
+        toBeDestroyed = kernel->currentThread;
+    }
+    DEBUG(dbgThread, "CPU " << current << " goes idle");
+    TRACE(TraceSwitch, kernel->currentThread->getID(), -1);
+    running[current] = NULL;
+    SaveCPU(current);
+    LoadCPU(next);
+    SwitchTo(running[next]);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TimeOut
+// 	The timer expired.  The Alarm takes care of the thread of the
+//	current CPU; note that those of the others should be time sliced
+//	too, when their CPU next runs.
+//----------------------------------------------------------------------
+
+void
+Scheduler::TimeOut()
+{
+    for (int i = 0; i < numCPUs; i++) {
+        if (i != current && running[i] != NULL)
+            timeOut[i] = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StopCPUs
+// 	The machine is halting.  Run every CPU's clock up to that of the
+//	one furthest ahead (as idle time), and leave in kernel->stats the
+//	total time and the tick counts summed over the CPUs, for Print.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StopCPUs()
+{
+    Statistics *stats = kernel->stats;
+    int end = 0;
+
+    if (numCPUs == 1)
+        return;
+    SaveCPU(current);
+    for (int i = 0; i < numCPUs; i++) {
+        if (stats->cpuTotalTicks[i] > end)
+            end = stats->cpuTotalTicks[i];
+    }
+    stats->totalTicks = end;
+    stats->idleTicks = stats->systemTicks = stats->userTicks = 0;
+    for (int i = 0; i < numCPUs; i++) {
+        stats->cpuIdleTicks[i] += end - stats->cpuTotalTicks[i];
+        stats->cpuTotalTicks[i] = end;
+        stats->idleTicks += stats->cpuIdleTicks[i];
+        stats->systemTicks += stats->cpuSystemTicks[i];
+        stats->userTicks += stats->cpuUserTicks[i];
+    }
+}
@@ -12,18 +12,28 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "stats.h"
 
 // 23-0303[j]:  MP3 SortedList 用的 Compare 函數
 int CompareForSFJ(Thread * newThread, Thread * currentThread);
 int CompareForPriority(Thread * newThread, Thread * currentThread);
 
+const int CPUSliceTicks = 10 * SystemTick;
+				// default time each CPU runs before the
+				// next one is simulated (see "-cslice");
+				// must be more than one tick
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// The machine may have several CPUs ("nachos -cpus N"), each with its
+// own ready lists; see scheduler.cc for how they are simulated.
 
 class Scheduler {
   public:
-    Scheduler();		// Initialize list of ready threads 
+    Scheduler(int cpus = 1, int sliceTicks = CPUSliceTicks);
+				// Initialize list of ready threads 
     ~Scheduler();		// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	
@@ -46,12 +56,43 @@ class Scheduler {
     bool CheckPreempt();
     void SetPreempt(bool flag) {preempFlag = flag;}
 
+    // Multiprocessor support; all of these do nothing with one CPU
+    int CurrentCPU() { return current; }
+				// CPU now being simulated
+    bool NextCPU();		// Let the CPU furthest behind in time run;
+				// TRUE if this CPU's time slice ran out
+				// while it was switched out
+    bool IdleCPU(bool finishing);
+				// The current thread is blocked and there is
+				// nothing to run: let another CPU run.
+				// TRUE once the thread runs again
+    void TimeOut();		// The timer expired: time slice the
+				// threads on the other CPUs, too
+    void StopCPUs();		// Total up the CPUs' statistics, at Halt
+
   private:
-    // 23-0303[j]:  MP3 修改成 3條 RQ
-    List<Thread *> *readyList_L3;         //  Round-Robin
+    // 23-0303[j]:  MP3 修改成 3條 RQ (one set per CPU)
+    List<Thread *> *readyList_L3[MaxCPUs];         //  Round-Robin
+
+    SortedList<Thread *> *readyList_L2[MaxCPUs];   //  Non-preemptive Priority
+    SortedList<Thread *> *readyList_L1[MaxCPUs];   //  Approximated SFJ
+
+    int numCPUs;
+    int current;		// CPU now being simulated
+    int sliceTicks;		// how long a CPU runs before the next
+    Thread *running[MaxCPUs];	// thread of each CPU, NULL if it is idle
+    bool timeOut[MaxCPUs];	// the timer expired while it was
+				// switched out
 
-    SortedList<Thread *> *readyList_L2;   //  Non-preemptive Priority
-    SortedList<Thread *> *readyList_L1;   //  Approximated SFJ
+    void AgeCPU(int cpu);	// Aging, for one CPU's ready lists
+    Thread *TakeFrom(int cpu);	// Dequeue the next thread of a CPU
+    int NumReady(int cpu);	// # of threads on a CPU's ready lists
+    void Dispatch(int cpu, Thread *thread);
+				// Give an idle CPU "thread" to run
+    void SaveCPU(int cpu);	// Swap a CPU's clock and tick counts
+    void LoadCPU(int cpu);	// out of, or into, kernel->stats
+    void SwitchTo(Thread *nextThread);
+				// Switch to the thread of another CPU
 
     Thread *toBeDestroyed;	// finishing thread to be destroyed
     				// by the next thread that runs
@@ -54,7 +54,7 @@
 				-	功能：設定初始 Semaphore value (一般 = 0)、建立 Wait Queue for P()
 */
 
-Semaphore::Semaphore(char* debugName, int initialValue)
+Semaphore::Semaphore(const char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
@@ -215,7 +215,7 @@ Semaphore::SelfTest()
 //	"debugName" is an arbitrary name, useful for debugging.
 //----------------------------------------------------------------------
 
-Lock::Lock(char* debugName)
+Lock::Lock(const char* debugName)
 {
     name = debugName;
     semaphore = new Semaphore("lock", 1);  // initially, unlocked
@@ -279,7 +279,7 @@ void Lock::Release()
 //
 //	"debugName" is an arbitrary name, useful for debugging.
 //----------------------------------------------------------------------
-Condition::Condition(char* debugName)
+Condition::Condition(const char* debugName)
 {
     name = debugName;
     waitQueue = new List<Semaphore *>;
@@ -21,6 +21,7 @@
 #include "switch.h"
 #include "synch.h"
 #include "sysdep.h"
+#include "tracer.h"
 
 // this is put at the top of the execution stack, for detecting stack overflows
 // 23-0127[j]: 又來一個 Magic Num 用來識別 Stack是不是滿了
@@ -31,13 +32,18 @@ const int STACK_FENCEPOST = 0xdedbeef;
 // 	Initialize a thread control block, so that we can then call
 //	Thread::Fork.
 //
-//	"threadName" is an arbitrary string, useful for debugging.
+//	"threadName" is an arbitrary string, useful for debugging.  It is
+//	copied, since for a user program it is also the file to run.
 //----------------------------------------------------------------------
 
-Thread::Thread(char* threadName, int threadID)
+Thread::Thread(const char* threadName, int threadID)
 {
 	ID = threadID;
-    name = threadName;
+    name = new char[strlen(threadName) + 1];
+    strcpy(name, threadName);
+    cpu = -1;
+    if (kernel->tracer != NULL)
+        kernel->tracer->NameThread(ID, name);
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
@@ -71,6 +77,9 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	    DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    if (space != NULL)
+        delete space;       // returns its frames and closes its open files
+    delete [] name;
 
     // delete busrt;
 }
@@ -120,7 +129,7 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
     Scheduler *scheduler = kernel->scheduler;
     IntStatus oldLevel;
     
-    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (int) func << " " << arg);
+    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (void *) func << " " << arg);
     StackAllocate(func, arg);
 
     oldLevel = interrupt->SetLevel(IntOff);
@@ -337,6 +346,8 @@ Thread::Sleep (bool finishing)
     status = BLOCKED;
 
     while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
+        if (kernel->scheduler->IdleCPU(finishing))
+            return;			// another CPU ran until we were woken
 		kernel->interrupt->Idle();	// no one to run, wait for an interrupt
 	}    
     
@@ -459,6 +470,15 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     *(--stackTop) = (int) ThreadRoot;   
     *stack = STACK_FENCEPOST;   // 23-0127[j]: 將 stack 存入 Magic Num 用來識別 Stack 是否 Overflow
 #endif
+
+#ifdef x86_64
+    // as on the x86, SWITCH() returns to ThreadRoot; but the return
+    // address takes two of the stack's (int) words
+    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop -= 2;
+    *((void **) stackTop) = (void *) ThreadRoot;
+    *stack = STACK_FENCEPOST;
+#endif
     
 #ifdef PARISC
     machineState[PCState] = PLabelToAddr(ThreadRoot);
@@ -136,7 +136,7 @@ class Thread {
     void *machineState[MachineStateSize];  // all registers except for stackTop
 
   public:
-    Thread(char* debugName, int threadID);		// initialize a Thread 
+    Thread(const char* debugName, int threadID);	// initialize a Thread 
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
@@ -162,6 +162,9 @@ class Thread {
     int getPriority() { return (priority); }
     void setPriority(int p) { priority = p; }
 
+    int getCPU() { return (cpu); }	// CPU it last ran on, -1 if none
+    void setCPU(int c) { cpu = c; }
+
     void Print() { cout << name; }
     void SelfTest();		// test whether thread impl is working
 
@@ -176,6 +179,7 @@ class Thread {
     ThreadStatus status;	// ready, running or blocked
     char* name;
 	  int   ID;
+    int cpu;			// CPU it last ran on
     void StackAllocate(VoidFunctionPtr func, void *arg);
     				// Allocate a stack for thread.
 				// Used internally by Fork()
@@ -56,6 +56,77 @@ SwapHeader (NoffHeader *noffH)
 #endif
 }
 
+//----------------------------------------------------------------------
+// SegmentsEnd
+// 	Return the virtual address just past the last segment of a
+//	program.  Empty segments do not count: their addresses are junk.
+//----------------------------------------------------------------------
+
+static int
+SegmentsEnd(NoffHeader *noffH)
+{
+    Segment *segments[] = { &noffH->code, &noffH->initData,
+#ifdef RDATA
+                            &noffH->readonlyData,
+#endif
+                            &noffH->uninitData };
+    int end = 0;
+
+    for (unsigned int i = 0; i < sizeof(segments) / sizeof(Segment *); i++) {
+        if (segments[i]->size > 0
+                && segments[i]->virtualAddr + segments[i]->size > end)
+            end = segments[i]->virtualAddr + segments[i]->size;
+    }
+    return end;
+}
+
+//----------------------------------------------------------------------
+// Overlaps
+// 	Return TRUE if "segment" has any bytes in the virtual addresses
+//	from "start" up to (not including) "end".
+//----------------------------------------------------------------------
+
+static bool
+Overlaps(Segment *segment, int start, int end)
+{
+    return segment->size > 0 && segment->virtualAddr < end
+           && segment->virtualAddr + segment->size > start;
+}
+
+//----------------------------------------------------------------------
+// LoadSegment
+// 	Copy a segment from the object code file to its virtual address,
+//	a page at a time, since the pages' frames are not contiguous.
+//
+//	"executable" -- the object code file
+//	"segment" -- where the segment is, in the file and in memory
+//	"pageTable" -- the address space's, with every page valid
+//	"name" -- the segment, for debugging
+//----------------------------------------------------------------------
+
+static void
+LoadSegment(OpenFile *executable, Segment *segment,
+            TranslationEntry *pageTable, const char *name)
+{
+    int vaddr, count;
+
+    if (segment->size <= 0)
+        return;
+    DEBUG(dbgAddr, "Initializing " << name << " segment.");
+    DEBUG(dbgAddr, segment->virtualAddr << ", " << segment->size);
+
+    for (int done = 0; done < segment->size; done += count) {
+        vaddr = segment->virtualAddr + done;
+        count = PageSize - vaddr % PageSize;	// to the end of the page
+        if (count > segment->size - done)
+            count = segment->size - done;
+        executable->ReadAt(&(kernel->machine->mainMemory[
+                   pageTable[vaddr / PageSize].physicalPage * PageSize
+                   + vaddr % PageSize]),
+               count, segment->inFileAddr + done);
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -77,19 +148,13 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace()
 {
-    pageTable = new TranslationEntry[NumPhysPages]; 
-    // 23-0127[j]: Page Table 最多 128個Entry (定義在 machine.h)
-    for (int i = 0; i < NumPhysPages; i++) {
-        pageTable[i].virtualPage = i;	
-        pageTable[i].physicalPage = -1;
-        pageTable[i].valid = FALSE;
-        pageTable[i].use = FALSE;
-        pageTable[i].dirty = FALSE;
-        pageTable[i].readOnly = FALSE;  
-    }
-    
-    // zero out the entire address space
-    bzero(kernel->machine->mainMemory, MemorySize);
+    numPages = 0;           // nothing to give back until Load succeeds
+    pageTable = NULL;       // Load makes one of numPages entries, and
+                            // zeroes each page's frame
+
+#ifndef FILESYS_STUB
+    fdTable = new FileDescriptorTable(kernel->fileSystem->GetOpenFileTable());
+#endif
 }
 
 //----------------------------------------------------------------------
@@ -107,7 +172,18 @@ AddrSpace::~AddrSpace()
             pageTable[i].valid = FALSE;
         }
     }
-   delete pageTable;
+   kernel->machine->FlushSoftTLB();	// the frames are no longer ours
+   if (kernel->machine->icacheStats == &icacheStats) {
+       kernel->machine->icacheStats = NULL;
+       kernel->machine->dcacheStats = NULL;
+   }
+   if (kernel->tlbManager != NULL && pageTable != NULL)
+       kernel->tlbManager->Forget(pageTable);
+   delete [] pageTable;
+
+#ifndef FILESYS_STUB
+    delete fdTable;         // closes anything the program left open
+#endif
 }
 
 
@@ -146,35 +222,29 @@ AddrSpace::Load(char *fileName)
     	SwapHeader(&noffH);
     ASSERT(noffH.noffMagic == NOFFMAGIC);
 
-#ifdef RDATA
-// how big is address space?
-    size = noffH.code.size + noffH.readonlyData.size + noffH.initData.size +
-           noffH.uninitData.size + UserStackSize;	
-                                                // we need to increase the size
-						// to leave room for the stack
-#else
 // how big is address space?
 
 // 23-0131[j]: 根據 Program 所需的 size = Code + Data + BSS + UserStackSize 來決定 Pages 的數量
 //             (UserStackSize 定義在 addrspace.h)
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
-			+ UserStackSize;	// we need to increase the size to leave room for the stack
-#endif
+    size = SegmentsEnd(&noffH) + UserStackSize;	// we need to increase the size
+						// to leave room for the stack
 
     numPages = divRoundUp(size, PageSize);  // 23-0127[j]: 設定 Page數量，總Page大小 ≥ Process 所需大小
     size = numPages * PageSize;
 
 // 23-0127[j]: 在「實作 Virtual Memory 之前」Process空間 必須小於 實體空間
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
-						// to run anything too big --
-						// at least until we have
-						// virtual memory
+    if (numPages > (unsigned int) kernel->NumFreeFrames()) {
+        // too big to run, at least until we have virtual memory
+        cerr << fileName << " needs " << numPages << " pages of "
+             << PageSize << " bytes; only " << kernel->NumFreeFrames()
+             << " of " << NumPhysPages << " are free (see -mem)\n";
+        numPages = 0;
+        delete executable;
+        return FALSE;
+    }
 
     DEBUG(dbgAddr, "Initializing address space: " << numPages << ", " << size);
 
-// then, copy in the code and data segments into memory
-// Note: this code assumes that virtual address = physical address
-
 // 23-0127[j]: 將 檔案(executable)中「noffH.code.inFileAddr位置 noffH.code.size大小」的資料
 //             存入 主記憶體 kernel->machine->mainMemory[noffH.code.virtualAddr]
 
@@ -194,111 +264,43 @@ AddrSpace::Load(char *fileName)
 //             		(2)	透過 設定 Page Table Entry 的 Valid Bit、ReadOnly Bit 等
 //             			-	防止 Thread 自己讀寫到 Code Seg 區域的 Page
 
-    int numFrame = 0;
-    int p=0;    // 23-0131[j]: Page Number
-    int f=0;    // 23-0131[j]: Frame Number
-
-    if (noffH.code.size > 0) {
-        DEBUG(dbgAddr, "Initializing code segment.");
-	    DEBUG(dbgAddr, noffH.code.virtualAddr << ", " << noffH.code.size);
-
-        // 23-0131[j]: 這裡是實作 Addr 轉換的地方之一
-
-        numFrame = divRoundUp(noffH.code.size, PageSize);
-        // cout << "numFrame for Code=" << numFrame <<endl;
-        for(int i=0;i<numFrame;i++,p++){
-            f = kernel->PopFreeFrame();
-            ASSERT(f>=0);   // 23-0131[j]: Frame Number >=0
-            if(i >= numFrame-1){
-                executable->ReadAt(
-		            &(kernel->machine->mainMemory[f*PageSize]), 
-			        (noffH.code.size-i*PageSize), (noffH.code.inFileAddr+i*PageSize));
-            }
-            else{
-                executable->ReadAt(
-		        &(kernel->machine->mainMemory[f*PageSize]), 
-			    PageSize, (noffH.code.inFileAddr+i*PageSize));
-            }
-
-            // 23-0131[j]: 每分配一個 Free Frame 給 Page，就 update Page Table
-            pageTable[p].virtualPage = p;
-            pageTable[p].physicalPage = f;
-            pageTable[p].valid = TRUE;
-            pageTable[p].use = FALSE;
-            pageTable[p].dirty = FALSE;
-            pageTable[p].readOnly = TRUE;   // 23-0131[j]: Code Seg 屬於ReadOnly的
-        } 
-
-        // executable->ReadAt(
-		//     &(kernel->machine->mainMemory[noffH.code.virtualAddr]), 
-		// 	noffH.code.size, noffH.code.inFileAddr);
-    }
-    if (noffH.initData.size > 0) {
-        DEBUG(dbgAddr, "Initializing data segment.");
-	    DEBUG(dbgAddr, noffH.initData.virtualAddr << ", " << noffH.initData.size);
-
-        // 23-0131[j]: 這裡是實作 Addr 轉換的地方之一
-
-        numFrame = divRoundUp(noffH.initData.size, PageSize);
-        // cout << "numFrame for Data=" << numFrame <<endl;
-
-        for(int i=0;i<numFrame;i++,p++){
-            f = kernel->PopFreeFrame();
-            ASSERT(f>=0);   // 23-0131[j]: Frame Number >=0
-            if(i >= numFrame-1){
-                executable->ReadAt(
-		            &(kernel->machine->mainMemory[f*PageSize]), 
-			        (noffH.initData.size-i*PageSize), (noffH.initData.inFileAddr+i*PageSize));
-            }
-            else{
-                executable->ReadAt(
-		        &(kernel->machine->mainMemory[f*PageSize]), 
-			    PageSize, (noffH.initData.inFileAddr+i*PageSize));
-            }
-
-            // 23-0131[j]: 每分配一個 Free Frame 給 Page，就 update Page Table
-            pageTable[p].virtualPage = p;
-            pageTable[p].physicalPage = f;
-            pageTable[p].valid = TRUE;
-            pageTable[p].use = FALSE;
-            pageTable[p].dirty = FALSE;
-            pageTable[p].readOnly = FALSE;  // 23-0131[j]: Data Seg 不屬於ReadOnly的
-        } 
-
-        // executable->ReadAt(
-		//     &(kernel->machine->mainMemory[noffH.initData.virtualAddr]),
-		// 	noffH.initData.size, noffH.initData.inFileAddr);
+    int p;	// 23-0131[j]: Page Number
+    int f;	// 23-0131[j]: Frame Number
+    int start, end;
+
+    pageTable = new TranslationEntry[numPages];
+    for (p = 0; p < (int) numPages; p++) {
+        f = kernel->PopFreeFrame();
+        ASSERT(f>=0);   // 23-0131[j]: Frame Number >=0
+        bzero(&kernel->machine->mainMemory[f * PageSize], PageSize);
+
+        // 23-0131[j]: 每分配一個 Free Frame 給 Page，就 update Page Table
+        // only a page holding code (or read-only data) and nothing
+        // that is written -- data, bss or stack -- is read-only
+        start = p * PageSize;
+        end = start + PageSize;
+        pageTable[p].virtualPage = p;
+        pageTable[p].physicalPage = f;
+        pageTable[p].valid = TRUE;
+        pageTable[p].use = FALSE;
+        pageTable[p].dirty = FALSE;
+        pageTable[p].readOnly = (Overlaps(&noffH.code, start, end)
+#ifdef RDATA
+                                 || Overlaps(&noffH.readonlyData, start, end)
+#endif
+                                )
+                                && !Overlaps(&noffH.initData, start, end)
+                                && !Overlaps(&noffH.uninitData, start, end)
+                                && end <= (int) size - UserStackSize;
     }
 
-        // 23-0131[j]: 除了 Code Seg & Data Seg 剩下應該是 Heap & Stack 的空間，目前暫且全部配置
-
-        for(p;p<numPages;p++){
-            f = kernel->PopFreeFrame();
-            ASSERT(f>=0);   // 23-0131[j]: Frame Number >=0
-            pageTable[p].virtualPage = p;
-            pageTable[p].physicalPage = f;
-            pageTable[p].valid = TRUE;
-            pageTable[p].use = FALSE;
-            pageTable[p].dirty = FALSE;
-            pageTable[p].readOnly = FALSE;  // 23-0131[j]: Stack Seg 不屬於ReadOnly的
-        }
-
-        // cout << "Name=" << kernel->currentThread->getName() << endl;
-        // for(int i=0;i<numPages;i++){
-        //     cout << "p=" << pageTable[i].virtualPage << ", f=" << pageTable[i].physicalPage;
-        //     cout << ", v=" << pageTable[i].valid << ", r=" << pageTable[i].readOnly << endl;
-        // }
-
-    
+    // then, copy in the code and data segments, each at its own
+    // virtual address
+    LoadSegment(executable, &noffH.code, pageTable, "code");
 #ifdef RDATA
-    if (noffH.readonlyData.size > 0) {
-        DEBUG(dbgAddr, "Initializing read only data segment.");
-	DEBUG(dbgAddr, noffH.readonlyData.virtualAddr << ", " << noffH.readonlyData.size);
-        executable->ReadAt(
-		&(kernel->machine->mainMemory[noffH.readonlyData.virtualAddr]),
-			noffH.readonlyData.size, noffH.readonlyData.inFileAddr);
-    }
+    LoadSegment(executable, &noffH.readonlyData, pageTable, "read only data");
 #endif
+    LoadSegment(executable, &noffH.initData, pageTable, "data");
 
     delete executable;			// close file
     return TRUE;			    // success
@@ -397,15 +399,121 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table --
+//	or, if it translates with a TLB, flush the TLB, so it is
+//	refilled from this page table.
 //----------------------------------------------------------------------
 // 23-0127[j]: 在Context switch時，回復 Thread 的 Page Table的位址/資訊
 //             (我的感覺 是告訴 模擬MMU Thread 的 Page Table的位址/資訊)
 
 void AddrSpace::RestoreState() 
 {
+    kernel->machine->icacheStats = &icacheStats;
+    kernel->machine->dcacheStats = &dcacheStats;
+    if (kernel->tlbManager != NULL) {	// the machine translates with its
+        kernel->tlbManager->Flush();	// TLB, which holds the last
+        return;				// program's translations
+    }
     kernel->machine->pageTable = pageTable;
     kernel->machine->pageTableSize = numPages;
+    kernel->machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReportCaches
+// 	Print how this program used the instruction and data caches,
+//	when it exits.  Nothing is printed if the machine has no caches.
+//
+//	"name" -- the program, to label the lines with
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReportCaches(char *name)
+{
+    char label[80];
+
+    if (kernel->machine->icache != NULL) {
+        snprintf(label, sizeof(label), "%s I-cache", name);
+        icacheStats.Print(label);
+    }
+    if (kernel->machine->dcache != NULL) {
+        snprintf(label, sizeof(label), "%s D-cache", name);
+        dcacheStats.Print(label);
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SaveImage
+// 	Write this address space to a checkpoint (see checkpoint.h):
+//	the number of pages, then each page table entry, followed by the
+//	contents of the page if it is valid.
+//
+//	"file" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SaveImage(int file)
+{
+    WriteFile(file, (char *) &numPages, sizeof(numPages));
+    for (unsigned int i = 0; i < numPages; i++) {
+        WriteFile(file, (char *) &pageTable[i], sizeof(TranslationEntry));
+        if (pageTable[i].valid)
+            WriteFile(file, &kernel->machine->mainMemory[
+                                pageTable[i].physicalPage * PageSize], PageSize);
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadImage
+// 	Fill this (empty) address space from a checkpoint written by
+//	SaveImage, giving each valid page a free frame.  Like Load,
+//	return FALSE if it does not fit in memory -- or if the
+//	checkpoint ends too soon.
+//
+//	"file" -- the UNIX file holding the checkpoint
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::LoadImage(int file)
+{
+    unsigned int pages;
+    TranslationEntry entry;
+
+    if (ReadPartial(file, (char *) &pages, sizeof(pages)) != sizeof(pages)
+            || pages > (unsigned int) kernel->NumFreeFrames())
+        return FALSE;
+
+    pageTable = new TranslationEntry[pages];
+    for (unsigned int i = 0; i < pages; i++)	// until read
+        pageTable[i].valid = FALSE;
+    numPages = pages;			// so that ~AddrSpace frees them
+    for (unsigned int i = 0; i < numPages; i++) {
+        if (ReadPartial(file, (char *) &entry, sizeof(entry)) != sizeof(entry))
+            return FALSE;
+        if (entry.valid) {
+            entry.physicalPage = kernel->PopFreeFrame();
+            ASSERT(entry.physicalPage >= 0);
+        }
+        pageTable[i] = entry;
+        if (entry.valid && ReadPartial(file, &kernel->machine->mainMemory[
+                    entry.physicalPage * PageSize], PageSize) != PageSize)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RefillTLB
+// 	Handle a TLB miss in this address space: load the translation
+//	for "badVAddr" from the page table.  Return FALSE if the page
+//	table has none either.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::RefillTLB(int badVAddr)
+{
+    ASSERT(kernel->tlbManager != NULL);
+    return kernel->tlbManager->Refill(badVAddr, pageTable, numPages);
 }
 
 //----------------------------------------------------------------------
@@ -455,7 +563,7 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     // 23-0127[j]: 翻譯位址，實體位址(*paddr) = f(pfn) * PageSize + offset
     *paddr = pfn*PageSize + offset;
 
-    ASSERT((*paddr < MemorySize));
+    ASSERT((*paddr < (unsigned) MemorySize));
 
     //cerr << " -- AddrSpace::Translate(): vaddr: " << vaddr <<
     //  ", paddr: " << *paddr << "\n";
@@ -12,6 +12,7 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "stats.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
@@ -35,11 +36,32 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    bool RefillTLB(int badVAddr);	// Load the machine's TLB with the
+					// translation for "badVAddr"; FALSE
+					// if there is none
+
+    void ReportCaches(char *name);	// Print this program's cache hits
+					// and misses, if the machine has caches
+
+    void SaveImage(int file);		// Write the page table and pages to
+    bool LoadImage(int file);		// a checkpoint, or read them back
+					// (see checkpoint.h)
+
+#ifndef FILESYS_STUB
+    FileDescriptorTable *GetFileTable() { return fdTable; }
+					// Files opened by this program
+#endif
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					                        // for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					                    // address space
+#ifndef FILESYS_STUB
+    FileDescriptorTable *fdTable;	// Per-process open file descriptors
+#endif
+    CacheStats icacheStats;		// This program's cache accesses
+    CacheStats dcacheStats;
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					                  // before jumping to user code
@@ -0,0 +1,243 @@
+// checkpoint.cc
+//	Routines to save a running user program to a file and to restore
+//	it.  See checkpoint.h for what is (and is not) saved.
+//
+//	A checkpoint file holds, in order:
+//		a CheckpointHeader
+//		the user registers (NumTotalRegs words)
+//		the Statistics
+//		the address space (see AddrSpace::SaveImage)
+//	It is only meant to be read back by the same Nachos binary.
+
+#include "copyright.h"
+#include "checkpoint.h"
+#include "main.h"
+#include "addrspace.h"
+#include "machine.h"
+#include "sysdep.h"
+
+const int CheckpointMagic = 0x4e434b50;	// "NCKP"
+const int CheckpointVersion = 1;
+const int MaxProgramName = 64;
+
+typedef struct {
+    int magic;				// CheckpointMagic
+    int version;			// CheckpointVersion
+    int pageSize;			// Memory geometry when it was taken
+    int numPhysPages;
+    int numRegs;			// NumTotalRegs
+    int statsSize;			// sizeof(Statistics)
+    int hostName;			// The disk is DISK_<hostName>
+    int priority;			// Of the program's thread
+    char name[MaxProgramName];		// And its name
+} CheckpointHeader;
+
+//----------------------------------------------------------------------
+// ResumeProgram
+// 	Start running a restored program, in its own thread.  Like
+//	AddrSpace::Execute, except that the registers come from the
+//	checkpoint.
+//----------------------------------------------------------------------
+
+static void
+ResumeProgram(Thread *thread)
+{
+    thread->RestoreUserState();
+    thread->space->RestoreState();
+    kernel->machine->Run();		// never returns
+    ASSERTNOTREACHED();
+}
+
+//----------------------------------------------------------------------
+// Checkpointer::Checkpointer
+// 	Arrange to save checkpoints of user programs.
+//
+//	"fileName" -- the UNIX file to save them to
+//	"atTick" -- when to save one, or -1 to wait for the program to
+//		ask (with the Checkpoint system call)
+//----------------------------------------------------------------------
+
+Checkpointer::Checkpointer(char *fileName, int atTick)
+{
+    this->fileName = fileName;
+    if (atTick >= 0) {
+        int fromNow = atTick - kernel->stats->totalTicks;
+
+        kernel->interrupt->Schedule(this, fromNow > 0 ? fromNow : 1,
+                                    TimerInt);
+    }
+}
+
+//----------------------------------------------------------------------
+// Checkpointer::CallBack
+// 	It is time to save a checkpoint.  It is only taken between two
+//	user instructions, when the registers are all in the machine; if
+//	the kernel is running, try again on the next tick.
+//----------------------------------------------------------------------
+
+void
+Checkpointer::CallBack()
+{
+    switch (kernel->interrupt->getStatus()) {
+      case UserMode:
+        if (Save())
+            cout << "Checkpoint of " << kernel->currentThread->getName()
+                 << " saved in " << fileName << " at tick "
+                 << kernel->stats->totalTicks << "\n";
+        break;
+      case SystemMode:
+        kernel->interrupt->Schedule(this, 1, TimerInt);
+        break;
+      case IdleMode:
+        // nothing is running, and nothing may ever run again: waiting
+        // for a program could keep Nachos from halting
+        cout << "No program running at tick " << kernel->stats->totalTicks
+             << "; no checkpoint taken\n";
+        break;
+    }
+}
+
+//----------------------------------------------------------------------
+// Checkpointer::Save
+// 	Save the user program now running.  The registers must be those
+//	of the program, either because we are between two of its
+//	instructions, or because it is making a system call (whose
+//	result the caller has already stored in the registers).
+//
+//	Return FALSE, with a message, if the program cannot be saved.
+//----------------------------------------------------------------------
+
+bool
+Checkpointer::Save()
+{
+    Thread *thread = kernel->currentThread;
+    CheckpointHeader header;
+    int registers[NumTotalRegs];
+    int file;
+
+    if (thread->space == NULL) {
+        cerr << "Checkpoint: no user program is running\n";
+        return FALSE;
+    }
+#ifndef FILESYS_STUB
+    if (thread->space->GetFileTable()->NumOpen() > 0) {
+        cerr << "Checkpoint: " << thread->getName() << " has files open\n";
+        return FALSE;
+    }
+#endif
+
+    bzero((char *) &header, sizeof(header));
+    header.magic = CheckpointMagic;
+    header.version = CheckpointVersion;
+    header.pageSize = PageSize;
+    header.numPhysPages = NumPhysPages;
+    header.numRegs = NumTotalRegs;
+    header.statsSize = sizeof(Statistics);
+    header.hostName = kernel->hostName;
+    header.priority = thread->getPriority();
+    strncpy(header.name, thread->getName(), MaxProgramName - 1);
+    for (int i = 0; i < NumTotalRegs; i++)
+        registers[i] = kernel->machine->ReadRegister(i);
+
+    file = OpenForWrite(fileName);
+    WriteFile(file, (char *) &header, sizeof(header));
+    WriteFile(file, (char *) registers, sizeof(registers));
+    WriteFile(file, (char *) kernel->stats, sizeof(Statistics));
+    thread->space->SaveImage(file);
+    Close(file);
+    DEBUG(dbgAddr, "Checkpoint of " << thread->getName() << " saved in "
+                   << fileName);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Checkpointer::Restore
+// 	Re-create the program saved in a checkpoint, as a new thread
+//	that is ready to run, and carry the Statistics on from the
+//	checkpoint.  Called before any other program is started.
+//
+//	Return NULL, with a message, if the checkpoint cannot be used.
+//
+//	"fileName" -- the checkpoint
+//	"threadID" -- ID for the new thread
+//----------------------------------------------------------------------
+
+Thread *
+Checkpointer::Restore(char *fileName, int threadID)
+{
+    Statistics *stats = kernel->stats;
+    CheckpointHeader header;
+    Statistics saved;
+    Thread *thread;
+    char *name;
+    int file;
+
+    file = OpenForReadWrite(fileName, FALSE);
+    if (file < 0) {
+        cerr << "Unable to open checkpoint " << fileName << "\n";
+        return NULL;
+    }
+    if (ReadPartial(file, (char *) &header, sizeof(header)) != sizeof(header)
+            || header.magic != CheckpointMagic
+            || header.version != CheckpointVersion
+            || header.numRegs != NumTotalRegs
+            || header.statsSize != sizeof(Statistics)) {
+        cerr << fileName << " is not a checkpoint of this Nachos\n";
+        Close(file);
+        return NULL;
+    }
+    if (header.pageSize != PageSize || header.numPhysPages != NumPhysPages) {
+        cerr << fileName << " was taken with " << header.numPhysPages
+             << " pages of " << header.pageSize << " bytes (see -mem, -pgsz)\n";
+        Close(file);
+        return NULL;
+    }
+    if (header.hostName != kernel->hostName)
+        cerr << "Warning: " << fileName << " was taken with DISK_"
+             << header.hostName << ", not DISK_" << kernel->hostName << "\n";
+
+    name = new char[MaxProgramName];	// threads keep their name
+    strncpy(name, header.name, MaxProgramName);
+    name[MaxProgramName - 1] = '\0';
+    thread = new Thread(name, threadID);
+    thread->setPriority(header.priority);
+    thread->space = new AddrSpace();
+
+    // the registers go to the thread through the machine, which no
+    // user program is using yet
+    for (int i = 0; i < NumTotalRegs; i++) {
+        int value;
+
+        if (ReadPartial(file, (char *) &value, sizeof(int)) != sizeof(int))
+            break;
+        kernel->machine->WriteRegister(i, value);
+    }
+    thread->SaveUserState();
+
+    if (ReadPartial(file, (char *) &saved, sizeof(Statistics))
+                != sizeof(Statistics)
+            || !thread->space->LoadImage(file)) {
+        cerr << "Checkpoint " << fileName << " is truncated\n";
+        Close(file);
+        delete thread->space;
+        thread->space = NULL;
+        delete thread;
+        return NULL;
+    }
+    Close(file);
+
+    // time carries on from the checkpoint; with several CPUs, they all
+    // start at the checkpoint's time, with the counts going to CPU 0
+    saved.numCPUs = stats->numCPUs;
+    *stats = saved;
+    for (int i = 1; i < stats->numCPUs; i++) {
+        stats->cpuTotalTicks[i] = stats->totalTicks;
+        stats->cpuIdleTicks[i] = stats->cpuSystemTicks[i] = 0;
+        stats->cpuUserTicks[i] = stats->cpuSteals[i] = 0;
+    }
+
+    cout << "Restored " << name << " from " << fileName << " at tick "
+         << stats->totalTicks << "\n";
+    thread->Fork((VoidFunctionPtr) ResumeProgram, (void *) thread);
+    return thread;
+}
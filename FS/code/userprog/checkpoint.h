@@ -0,0 +1,54 @@
+// checkpoint.h
+//	Data structures to save a running user program to a file, and to
+//	start it again from there in a later run of Nachos.
+//
+//	Long workloads spend a lot of time getting to the interesting
+//	part.  With "nachos -ckpt file", the program running at tick T
+//	("-ckat T"), or the one calling the Checkpoint system call, is
+//	saved; "nachos -restore file" then skips straight to that point.
+//
+//	A checkpoint holds the program's registers, its page table and
+//	the contents of its pages, its name and priority, and the
+//	Statistics, so that the times reported carry on from where the
+//	checkpoint was taken.  It does not hold:
+//		the disk -- it is a UNIX file (DISK_n) that is always up to
+//			date; the checkpoint only records which one, and
+//			it must not be re-formatted before restoring
+//		open files -- a program with files open cannot be saved
+//		other programs -- only the one running is saved; the
+//			others can be started again with "-e"
+//		pending interrupts -- the devices are re-created at
+//			restore, and schedule their own interrupts
+//
+//	Restoring needs the same memory and page size as the run that
+//	saved the checkpoint.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "callback.h"
+#include "thread.h"
+
+class Checkpointer : public CallBackObj {
+  public:
+    Checkpointer(char *fileName, int atTick);
+					// Save checkpoints to "fileName";
+					// the first at tick "atTick", if
+					// it is not negative
+
+    bool Save();			// Save the program now running;
+					// FALSE if it cannot be saved
+    static Thread *Restore(char *fileName, int threadID);
+					// Re-create the program saved in
+					// "fileName", ready to run; NULL
+					// if it cannot be
+
+    void CallBack();			// The tick for a checkpoint has come
+
+  private:
+    char *fileName;			// Where checkpoints go
+};
+
+#endif // CHECKPOINT_H
@@ -78,6 +78,7 @@ ExceptionHandler(ExceptionType which)
         case SC_Halt:
         {
           DEBUG(dbgSys, "Shutdown, initiated by user program.\n");
+          kernel->currentThread->space->ReportCaches(kernel->currentThread->getName());
           SysHalt();
           cout<<"in exception\n";
           ASSERTNOTREACHED();	// 22-1224[j]: 印出 檔案 & 行數
@@ -98,6 +99,21 @@ ExceptionHandler(ExceptionType which)
           ASSERTNOTREACHED();
           break;
         }
+        case SC_Checkpoint:
+        {
+          DEBUG(dbgSys, "Checkpoint\n");
+          // Set Program Counter first, and the result a restored
+          // program sees: the checkpoint resumes after the call
+          kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+          kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+          kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+          kernel->machine->WriteRegister(2, 1);
+          status = SysCheckpoint();
+          kernel->machine->WriteRegister(2, (int) status);
+          return;
+          ASSERTNOTREACHED();
+          break;
+        }
         case SC_MSG:
         {
           DEBUG(dbgSys, "Message received.\n");
@@ -240,6 +256,39 @@ ExceptionHandler(ExceptionType which)
           ASSERTNOTREACHED();
           break;
         }
+#ifndef FILESYS_STUB
+        case SC_Seek:
+        {
+          DEBUG(dbgSys, "Seek\n");
+          val = kernel->machine->ReadRegister(4);
+          fileID = kernel->machine->ReadRegister(5);
+          status = SysSeek(val,fileID);
+
+          kernel->machine->WriteRegister(2, (int) status);
+          kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+          kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+          kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+          return;
+          ASSERTNOTREACHED();
+          break;
+        }
+
+        case SC_Remove:
+        {
+          DEBUG(dbgSys, "Remove\n");
+          val = kernel->machine->ReadRegister(4);
+          char *filename = &(kernel->machine->mainMemory[val]);
+          status = SysRemove(filename);
+
+          kernel->machine->WriteRegister(2, (int) status);
+          kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+          kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+          kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+          return;
+          ASSERTNOTREACHED();
+          break;
+        }
+#endif // FILESYS
       // ---------------------------------------------------------------
             
         case SC_Exit:
@@ -247,6 +296,7 @@ ExceptionHandler(ExceptionType which)
           DEBUG(dbgAddr, "Program exit\n");
           val=kernel->machine->ReadRegister(4);
           cout << "return value:" << val << endl;
+          kernel->currentThread->space->ReportCaches(kernel->currentThread->getName());
           kernel->currentThread->Finish();
           break;
         }
@@ -259,18 +309,16 @@ ExceptionHandler(ExceptionType which)
 
 	  break;
     
-    // case PageFaultException:
-    //   // 23-0131[j]: 判斷 是 invalid-ref 或 Not-in-memory
-
-    //   // PC-4 = Restart Last inst. 
-    //   // int PrevPC = kernel->machine->ReadRegister(PrevPCReg);
-    //   // int PC = kernel->machine->ReadRegister(PCReg);
-    //   // int NextPC = kernel->machine->ReadRegister(NextPCReg);
-
-    //   // kernel->machine->WriteRegister(PCReg,PrevPC);
-    //   // kernel->machine->WriteRegister(NextPCReg,PC);
- 
-    // break;
+    case PageFaultException:
+      // 23-0131[j]: 判斷 是 invalid-ref 或 Not-in-memory
+      // With a TLB, this is usually just a TLB miss: load the
+      // translation and return without touching the PC, so the
+      // instruction is retried.
+      val = kernel->machine->ReadRegister(BadVAddrReg);
+      if (kernel->tlbManager != NULL && kernel->currentThread->space->RefillTLB(val))
+          return;
+      cerr << "Page fault at virtual address " << val << "\n";
+      break;
 
 	  default:
 		  cerr << "Unexpected user mode exception " << (int)which << "\n";
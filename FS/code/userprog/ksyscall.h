@@ -13,6 +13,7 @@
 
 #include "kernel.h"
 #include "synchconsole.h"
+#include "checkpoint.h"
 
 
 void SysHalt()
@@ -32,6 +33,15 @@ int SysAdd(int op1, int op2)
   return op1 + op2;
 }
 
+int SysCheckpoint()
+{
+  if (kernel->checkpointer == NULL) {
+    cerr << "Checkpoint: no checkpoint file (see -ckpt)\n";
+    return -1;
+  }
+  return kernel->checkpointer->Save() ? 0 : -1;
+}
+
 #ifdef FILESYS_STUB
 int SysCreate(char *filename)
 {
@@ -57,6 +67,7 @@ int SysCreate(char *filename, int size){
 // 23-0104[j]: 修改順序 exception.cc -> ksyscall.h -> filesys.h
 // ------------------------------------------------------------------------
 
+#ifdef FILESYS_STUB
 OpenFileId SysOpen(char *filename){
   return kernel->fileSystem->OpenReturnId(filename);
 }
@@ -72,6 +83,40 @@ int SysWrite(OpenFileId fd,char *buffer, int nBytes){
 int SysRead(OpenFileId fd,char *buffer, int nBytes){
   return kernel->fileSystem->Read(fd,buffer,nBytes);
 }
+#else // FILESYS
+
+// Descriptors are per process: they index the calling thread's
+// address space, not a table shared by every user program.
+
+OpenFileId SysOpen(char *filename){
+  return kernel->fileSystem->OpenReturnId(filename,
+                kernel->currentThread->space->GetFileTable());
+}
+
+int SysClose(OpenFileId fileId){
+  return kernel->fileSystem->Close(fileId,
+                kernel->currentThread->space->GetFileTable());
+}
+
+int SysWrite(OpenFileId fd,char *buffer, int nBytes){
+  return kernel->fileSystem->Write(fd,buffer,nBytes,
+                kernel->currentThread->space->GetFileTable());
+}
+
+int SysRead(OpenFileId fd,char *buffer, int nBytes){
+  return kernel->fileSystem->Read(fd,buffer,nBytes,
+                kernel->currentThread->space->GetFileTable());
+}
+
+int SysSeek(int position, OpenFileId fd){
+  return kernel->fileSystem->Seek(position,fd,
+                kernel->currentThread->space->GetFileTable());
+}
+
+int SysRemove(char *filename){
+  return (kernel->fileSystem->Remove(filename) == TRUE)?1:-1;
+}
+#endif // FILESYS
 
 // ------------------------------------------------------------------------
 
@@ -18,6 +18,8 @@ SynchConsoleInput::SynchConsoleInput(char *inputFile)
     consoleInput = new ConsoleInput(inputFile, this);
     lock = new Lock("console in");
     waitFor = new Semaphore("console in", 0);
+    lineLength = linePos = 0;
+    atEOF = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -32,23 +34,78 @@ SynchConsoleInput::~SynchConsoleInput()
     delete waitFor;
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleInput::FillLine
+//      Make sure "line" holds a whole line from "linePos" on, waiting
+//	for more input if need be.  It may instead hold a partial line,
+//	if the line is too long to fit, or if the input has ended.
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchConsoleInput::FillLine()
+{
+    int count;
+
+    if (linePos > 0) {		// move what is left to the front
+	lineLength -= linePos;
+	bcopy(&line[linePos], line, lineLength);
+	linePos = 0;
+    }
+    while (!atEOF && lineLength < ConsoleLineSize
+	   && memchr(line, '\n', lineLength) == NULL) {
+	waitFor->P();	// wait for EOF or chars to be available.
+	count = consoleInput->GetBuffer(&line[lineLength],
+					ConsoleLineSize - lineLength);
+	if (count == 0)
+	    atEOF = TRUE;
+	lineLength += count;
+    }
+}
+
 //----------------------------------------------------------------------
 // SynchConsoleInput::GetChar
-//      Read a character typed at the keyboard, waiting if necessary.
+//      Read a character typed at the keyboard, waiting if necessary
+//	for the rest of its line.  Return EOF at the end of the input.
 //----------------------------------------------------------------------
 
 char
 SynchConsoleInput::GetChar()
 {
-    char ch;
+    char ch = EOF;
 
     lock->Acquire();
-    waitFor->P();	// wait for EOF or a char to be available.
-    ch = consoleInput->GetChar();
+    if (linePos == lineLength)
+	FillLine();
+    if (linePos < lineLength)
+	ch = line[linePos++];
     lock->Release();
     return ch;
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleInput::GetLine
+//      Read the rest of the current line, newline included, waiting
+//	if necessary.  Return the number of characters read: no more
+//	than "length", and 0 at the end of the input.
+//----------------------------------------------------------------------
+
+int
+SynchConsoleInput::GetLine(char *into, int length)
+{
+    int count = 0;
+
+    lock->Acquire();
+    FillLine();
+    while (count < length && linePos < lineLength) {
+	into[count++] = line[linePos++];
+	if (into[count - 1] == '\n')
+	    break;
+    }
+    lock->Release();
+    return count;
+}
+
 //----------------------------------------------------------------------
 // SynchConsoleInput::CallBack
 //      Interrupt handler called when keystroke is hit; wake up
@@ -102,36 +159,40 @@ SynchConsoleOutput::PutChar(char ch)
     lock->Release();
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PutString
+//      Write "length" characters of "str" to the console display, as
+//	one request to the device, waiting until they have gone out.
+//----------------------------------------------------------------------
+
+void
+SynchConsoleOutput::PutString(char *str, int length)
+{
+    if (length <= 0)
+	return;
+    lock->Acquire();
+    DEBUG(dbgTraCode, "In SynchConsoleOutput::PutString, into consoleOutput->PutBuffer, " << kernel->stats->totalTicks);
+    consoleOutput->PutBuffer(str, length);
+
+    // 23-0302[j]: 等待 硬體完成工作，引發中斷、呼叫 ISR = CallBack()，呼叫 waitFor->V() = 解鎖
+    waitFor->P();
+    DEBUG(dbgTraCode, "In SynchConsoleOutput::PutString, return from waitFor->P(), " << kernel->stats->totalTicks);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PutInt
+//      Write "value", in decimal and followed by a newline, to the
+//	console display.
+//----------------------------------------------------------------------
+
 void
 SynchConsoleOutput::PutInt(int value)
 {
     char str[15];
-    int idx=0;
-    //sprintf(str, "%d\n\0", value);  the true one
-    sprintf(str, "%d\n\0", value); //simply for trace code
-
-    // 23-0104[j]: 利用lock->Acquire()鎖定物件，開始執行同步化
-    // 23-0104[j]: 只有取得鎖定的執行緒才可以進入同步區，未取得鎖定的執行緒則必須等待，直到有機會取得鎖定
-
-    lock->Acquire();    // 22-1230[j]: 只有自己在能使用 I/O Device 時 才往下執行
-    do{
-	    DEBUG(dbgTraCode, "In SynchConsoleOutput::PutChar, into consoleOutput->PutChar, " << kernel->stats->totalTicks);
-        consoleOutput->PutChar(str[idx]);   // 23-0103[j]: 只有當 putBusy = FALSE 才會印出 str[idx]
-	    DEBUG(dbgTraCode, "In SynchConsoleOutput::PutChar, return from consoleOutput->PutChar, " << kernel->stats->totalTicks);
-	    idx++;
-		
-	    DEBUG(dbgTraCode, "In SynchConsoleOutput::PutChar, into waitFor->P(), " << kernel->stats->totalTicks);
-
-        // 23-0302[j]: 等待 硬體完成工作，引發中斷、呼叫 ISR = CallBack()，設定putBusy = FALSE、呼叫 waitFor->V() = 解鎖  
-        //             切回此處後，再次上鎖硬體，並取用
-        waitFor->P();  
-	    DEBUG(dbgTraCode, "In SynchConsoleOutput::PutChar, return form  waitFor->P(), " << kernel->stats->totalTicks);
-    } while (str[idx] != '\0');
-
-    // 23-0104[j]: 釋放 I/O 的使用權
-    // 23-0302[j]: 執行完同步化後，用lock->Release()解除鎖定，讓其他 Thread 有機會取得鎖定
-    lock->Release();
-    
+
+    sprintf(str, "%d\n", value);
+    PutString(str, strlen(str));
 }
 
 //----------------------------------------------------------------------
@@ -2,6 +2,12 @@
 //	Data structures for synchronized access to the keyboard
 //	and console display devices.
 //
+//	Input is line buffered: characters are handed out only once a
+//	whole line (or ConsoleLineSize of them, or the end of the input)
+//	has arrived, so a reader waits once per line rather than once
+//	per character.  Likewise PutString sends a whole string to the
+//	display and waits once.
+//
 //	NOTE: this abstraction is not completely implemented.
 
 #ifndef SYNCHCONSOLE_H
@@ -13,6 +19,8 @@
 #include "console.h"
 #include "synch.h"
 
+const int ConsoleLineSize = 256;	// longest line SynchConsoleInput keeps
+
 // The following two classes define synchronized input and output to
 // a console device
 
@@ -22,12 +30,20 @@ class SynchConsoleInput : public CallBackObj {
     ~SynchConsoleInput();		// Deallocate console device
 
     char GetChar();		// Read a character, waiting if necessary
+    int GetLine(char *into, int length);
+				// Read up to the end of a line, at most
+				// "length" chars; 0 at end of file
     
   private:
     ConsoleInput *consoleInput;	// the hardware keyboard
     Lock *lock;			// only one reader at a time
     Semaphore *waitFor;		// wait for callBack
+    char line[ConsoleLineSize];	// chars read from the keyboard
+    int lineLength;		// # of them
+    int linePos;		// next one to hand out
+    bool atEOF;			// has the input ended?
 
+    void FillLine();		// wait for a whole line to be in "line"
     void CallBack();		// called when a keystroke is available
 };
 
@@ -37,6 +53,8 @@ class SynchConsoleOutput : public CallBackObj {
     ~SynchConsoleOutput();
 
     void PutChar(char ch);	// Write a character, waiting if necessary
+    void PutString(char *str, int length);
+				// Write "length" chars, waiting once
     
     void PutInt(int n);
    
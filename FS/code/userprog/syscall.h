@@ -39,6 +39,7 @@
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
 #define SC_PrintInt     16
+#define SC_Checkpoint   17
 #define SC_Add		    42
 #define SC_MSG		    100
 #ifndef IN_ASM
@@ -70,6 +71,12 @@ int Add(int op1, int op2);
  */
 void MSG(char *msg);
 
+/* Save this program in the checkpoint file given with "nachos -ckpt".
+ * Return 0 once it is saved, -1 if it could not be, and 1 when the
+ * program is started again from the checkpoint ("nachos -restore").
+ */
+int Checkpoint();
+
 
 /* Address space control operations: Exit, Exec, Execv, and Join */
 
@@ -0,0 +1,205 @@
+// tlbmanager.cc
+//	Routines to load and flush the machine's TLB.  See tlbmanager.h
+//	for the overall design.
+
+#include "copyright.h"
+#include "tlbmanager.h"
+#include "machine.h"
+#include "sysdep.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// TLBManager::TLBManager
+// 	Start managing the machine's (empty) TLB.
+//
+//	"policy" -- how to choose the entry to replace on a miss
+//----------------------------------------------------------------------
+
+TLBManager::TLBManager(TLBPolicy policy)
+{
+    Machine *machine = kernel->machine;
+    int numSets = machine->tlbSize / machine->tlbWays;
+
+    ASSERT(machine->tlb != NULL);
+    this->policy = policy;
+    hand = new int[numSets];
+    for (int i = 0; i < numSets; i++)
+        hand[i] = 0;
+    owner = NULL;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::~TLBManager
+//----------------------------------------------------------------------
+
+TLBManager::~TLBManager()
+{
+    delete [] hand;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::ParsePolicy
+// 	Translate the name of a replacement policy, as given on the
+//	command line.  Return FALSE if the name is not known.
+//----------------------------------------------------------------------
+
+bool
+TLBManager::ParsePolicy(char *name, TLBPolicy *policy)
+{
+    if (strcmp(name, "random") == 0)
+        *policy = TLBRandom;
+    else if (strcmp(name, "fifo") == 0)
+        *policy = TLBFIFO;
+    else if (strcmp(name, "clock") == 0)
+        *policy = TLBClock;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::WriteBack
+// 	Copy the use and dirty bits the hardware set in a TLB entry
+//	back into the page table it came from.
+//----------------------------------------------------------------------
+
+void
+TLBManager::WriteBack(TranslationEntry *entry)
+{
+    TranslationEntry *pte;
+
+    if (owner == NULL || !entry->valid)
+        return;
+    pte = &owner[entry->virtualPage];
+    if (entry->use)
+        pte->use = TRUE;
+    if (entry->dirty)
+        pte->dirty = TRUE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Victim
+// 	Return the TLB entry to replace, in the set starting at entry
+//	"first".  An empty entry is always used first.
+//----------------------------------------------------------------------
+
+int
+TLBManager::Victim(int first)
+{
+    Machine *machine = kernel->machine;
+    int ways = machine->tlbWays;
+    int *next = &hand[first / ways];
+    TranslationEntry *entry;
+    int victim = first;
+
+    for (int i = first; i < first + ways; i++) {
+        if (!machine->tlb[i].valid)
+            return i;
+    }
+
+    switch (policy) {
+      case TLBRandom:
+        victim = first + RandomNumber() % ways;
+        break;
+      case TLBFIFO:
+        victim = first + *next;
+        *next = (*next + 1) % ways;
+        break;
+      case TLBClock:
+        // give every recently used entry a second chance; this ends
+        // within two turns, since we clear use bits as we go
+        for (;;) {
+            entry = &machine->tlb[first + *next];
+            if (!entry->use)
+                break;
+            WriteBack(entry);
+            entry->use = FALSE;
+            *next = (*next + 1) % ways;
+        }
+        victim = first + *next;
+        *next = (*next + 1) % ways;
+        break;
+      default:
+        ASSERTNOTREACHED();
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Refill
+// 	Handle a TLB miss: load the translation for "badVAddr" from the
+//	page table into the TLB, replacing an entry of its set.  The
+//	faulting instruction can then be retried.
+//
+//	Return FALSE if the page table has no translation either -- a
+//	real page fault.
+//
+//	"badVAddr" -- the address that missed
+//	"pageTable", "numPages" -- the running address space's page table
+//----------------------------------------------------------------------
+
+bool
+TLBManager::Refill(int badVAddr, TranslationEntry *pageTable,
+                   unsigned int numPages)
+{
+    Machine *machine = kernel->machine;
+    unsigned int vpn = (unsigned) badVAddr / PageSize;
+    TranslationEntry *entry;
+
+    if (vpn >= numPages || !pageTable[vpn].valid)
+        return FALSE;
+
+    if (owner != pageTable) {		// left over from another program
+        if (owner != NULL)
+            Flush();
+        owner = pageTable;
+    }
+
+    entry = &machine->tlb[Victim(machine->TLBSet(vpn))];
+    WriteBack(entry);
+    *entry = pageTable[vpn];
+    entry->virtualPage = vpn;
+    entry->use = FALSE;			// set again by the retried access
+    DEBUG(dbgAddr, "TLB refill: virtual page " << vpn << " -> frame "
+                   << entry->physicalPage);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Flush
+// 	Invalidate every TLB entry, copying use and dirty bits back to
+//	the page table first.  Called on every context switch, since
+//	the TLB cannot tell address spaces apart.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Flush()
+{
+    Machine *machine = kernel->machine;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+        WriteBack(&machine->tlb[i]);
+        machine->tlb[i].valid = FALSE;
+    }
+    owner = NULL;
+    kernel->stats->numTLBFlushes++;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Forget
+// 	The address space owning "pageTable" is being deleted.  If the
+//	TLB holds its translations, drop them; there is nothing left to
+//	copy the use and dirty bits back to.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Forget(TranslationEntry *pageTable)
+{
+    Machine *machine = kernel->machine;
+
+    if (owner != pageTable)
+        return;
+    for (int i = 0; i < machine->tlbSize; i++)
+        machine->tlb[i].valid = FALSE;
+    owner = NULL;
+}
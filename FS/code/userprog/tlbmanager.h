@@ -0,0 +1,61 @@
+// tlbmanager.h
+//	Data structures for managing the machine's software-loaded TLB.
+//
+//	When the machine has a TLB ("nachos -tlb N"), it no longer looks
+//	at page tables: a reference to a page that is not in the TLB
+//	raises a PageFaultException, and it is up to the kernel to find
+//	the translation in the address space's page table, load it into
+//	the TLB, and retry the instruction.
+//
+//	The TLB may be set associative ("-tlbw W"): a page can only go in
+//	the W entries of its set.  Which of them is replaced on a miss is
+//	up to the replacement policy ("-tlbp"):
+//		random -- any of them
+//		fifo   -- the one loaded longest ago
+//		clock  -- approximate LRU: the first one, going round the
+//			  set, whose use bit is clear (clearing use bits on
+//			  the way)
+//
+//	There are no address space identifiers, so the TLB is flushed on
+//	every context switch.  Use and dirty bits are copied back into the
+//	page table when an entry is replaced or flushed.
+
+#ifndef TLBMANAGER_H
+#define TLBMANAGER_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "translate.h"
+
+enum TLBPolicy { TLBRandom, TLBFIFO, TLBClock };
+
+class TLBManager {
+  public:
+    TLBManager(TLBPolicy policy);	// Manage the machine's TLB
+    ~TLBManager();
+
+    bool Refill(int badVAddr, TranslationEntry *pageTable,
+                unsigned int numPages);
+					// Load the translation for "badVAddr";
+					// FALSE if the page table has none
+    void Flush();			// Empty the TLB, on a context switch
+    void Forget(TranslationEntry *pageTable);
+					// "pageTable" is going away: drop
+					// its entries without copying back
+
+    static bool ParsePolicy(char *name, TLBPolicy *policy);
+					// Policy from its command line name
+
+  private:
+    TLBPolicy policy;			// Which entry to replace
+    int *hand;				// Next entry to look at, in each set
+    TranslationEntry *owner;		// Page table the TLB entries came
+					// from, NULL if none
+
+    int Victim(int first);		// Entry to replace, in the set
+					// starting at "first"
+    void WriteBack(TranslationEntry *entry);
+					// Copy its use and dirty bits back
+};
+
+#endif // TLBMANAGER_H